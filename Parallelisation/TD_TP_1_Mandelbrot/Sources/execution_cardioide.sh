@@ -0,0 +1,21 @@
+#!/bin/bash
+# Comparaison des temps avec et sans le test de la cardioide / disque de
+# periode 2, sur les domaines de Tests_params.txt, prof de 200 a 200000.
+
+gcc -O2 -o mandel mandel.c -lm
+
+echo mandel_cardioide >> ../Tests_cardioide.txt
+
+list_prof="200 2000 20000 200000"
+list_domaines="-2,-2,2,2 0,0,0.5,0.5 -0.5,0,0.5,0.5 0,-0.5,0.5,0.5 -1.5,-0.1,-1.3,0.1"
+
+for d in $list_domaines;
+do
+	dom=`echo $d | tr ',' ' '`
+	for p in $list_prof;
+	do
+		echo $dom $p >> ../Tests_cardioide.txt
+		./mandel 800 800 $dom $p -nocardio 2>/dev/null >> ../Tests_cardioide.txt
+		./mandel 800 800 $dom $p 2>/dev/null >> ../Tests_cardioide.txt
+	done
+done
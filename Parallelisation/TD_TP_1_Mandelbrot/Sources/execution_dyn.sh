@@ -0,0 +1,27 @@
+#!/bin/bash
+# Comparaison des decoupages de mandel_dynamique (-decoupage) avec les
+# blocs fixes de Tests_dyn.txt : image par defaut (800x800, -2 -2 2 2,
+# prof 10000), nlin 1, 8 et 32, de 2 a 32 processus.
+# Temps du maitre (Rang 0) et tailles des blocs choisies.
+
+mpicc -O2 -o mandel_dyn mandel_dynamique.c -lm
+
+echo "mandel_dynamique -decoupage (temps du maitre, tailles des blocs)" >> ../Tests_dyn.txt
+
+list_np="2 4 8 16 32"
+list_nlin="1 8 32"
+list_modes="fixe guide factoring adaptatif"
+
+for np in $list_np;
+do
+	echo $np >> ../Tests_dyn.txt
+	for nlin in $list_nlin;
+	do
+		for m in $list_modes;
+		do
+			echo "nlin $nlin -decoupage $m" >> ../Tests_dyn.txt
+			mpirun -np $np ./mandel_dyn 800 800 -2 -2 2 2 10000 $nlin -decoupage $m 2>&1 >/dev/null \
+				| grep -E "^Rang 0 |^Decoupage [a-z]+:" >> ../Tests_dyn.txt
+		done
+	done
+done
@@ -11,19 +11,49 @@
 #include <string.h>     /* pour memset */
 #include <math.h>
 #include <sys/time.h>
+#include <limits.h>
 
 #include "rasterfile.h"
+#include "mandel_noyau.h"
+#include "mandel_options.h"
+#include "mandel_mariani.h"
+#include "mandel_iter.h"
+#include "mandel_reprise.h"
+#include "mandel_cache.h"
+#include "mandel_symetrie.h"
+#include "mandel_formule.h"
+#include "mandel_bandes.h"
 
 
 
 char info[] = "\
 Usage:\n\
-      mandel dimx dimy xmin ymin xmax ymax prof\n\
+      mandel dimx dimy xmin ymin xmax ymax prof [options]\n\
 \n\
       dimx,dimy : dimensions de l'image a generer\n\
       xmin,ymin,xmax,ymax : domaine a calculer dans le plan complexe\n\
       prof : nombre maximale d'iteration\n\
 \n\
+Options\n\
+      -nocardio : pas de test de la cardioide et du disque de periode 2\n\
+      -periode : detection de periodicite des orbites (methode de Brent)\n\
+      -eps_periode eps : tolerance de la detection de periodicite\n\
+      -mariani : subdivision recursive de Mariani-Silver\n\
+      -taille_min n : cote en dessous duquel Mariani-Silver calcule tout\n\
+      -precision p : float, double, dd (double-double) ou auto (defaut)\n\
+      -iter fichier : sauve aussi les nombres d'iterations (voir recolorier)\n\
+      -reprise fichier : reprend le calcul sauve dans fichier jusqu'au\n\
+                         nouveau prof (le fichier est cree ou mis a jour)\n\
+      -cache fichier : reprend les points de la vue precedente qui tombent\n\
+                       sur la nouvelle grille, puis y sauve la nouvelle vue\n\
+      -degre d : formule z^d + c, 2 <= d <= 8 (defaut 2)\n\
+      -julia a,b : ensemble de Julia de z^d + k, k = a + i.b\n\
+      -formule \"expr\" : iteration z -> expr (z, c, i, + - * / ^n, conj),\n\
+                        compilee a l'execution (ex. \"z^3 + c*z + 0.2\")\n\
+      -nosymetrie : calcule aussi les lignes miroir par rapport a l'axe reel\n\
+      -bandes n : calcule l'image par bandes de n lignes, ecrites au fur\n\
+                  et a mesure (images plus grandes que la memoire)\n\
+\n\
 Quelques exemples d'execution\n\
       mandel 800 800 0.35 0.355 0.353 0.358 200\n\
       mandel 800 800 -0.736 -0.184 -0.735 -0.183 500\n\
@@ -111,6 +141,39 @@ unsigned char cos_composante(int i, double freq) {
 #endif /* #ifdef COS_COLOR */
 
 
+/**
+ * Entete de mandel.ras (ENTETE_RASTERFILE octets) : l'entete rasterfile
+ * d'une image 8 bits et sa palette, ecrits avant les pixels.
+ * Au dela de 2 Go, la taille de l'image ne tient pas dans ras_length,
+ * qui vaut alors 0 : le lecteur la deduit de la largeur et de la hauteur
+ * (voir rasterfile.h).
+ */
+#define ENTETE_RASTERFILE ((int)sizeof(struct rasterfile) + 3*256)
+
+void entete_rasterfile( unsigned char *e, int largeur, int hauteur) {
+  struct rasterfile file;
+  long taille = (long)largeur*hauteur;
+  int i;
+
+  file.ras_magic  = swap(RAS_MAGIC);
+  file.ras_width  = swap(largeur);
+  file.ras_height = swap(hauteur);
+  file.ras_depth  = swap(8);
+  file.ras_length = swap(taille > INT_MAX ? 0 : (int)taille);
+  file.ras_type    = swap(RT_STANDARD);
+  file.ras_maptype = swap(RMT_EQUAL_RGB);
+  file.ras_maplength = swap(256*3);
+  memcpy( e, &file, sizeof(struct rasterfile));
+
+  /* Palette de couleurs : rouge, vert puis bleu, de 255 a 0 */
+  e += sizeof(struct rasterfile);
+  for( i = 0; i < 256; i++) {
+    e[i]       = COMPOSANTE_ROUGE(255 - i);
+    e[256 + i] = COMPOSANTE_VERT(255 - i);
+    e[512 + i] = COMPOSANTE_BLEU(255 - i);
+  }
+}
+
 /**
  *  Sauvegarde le tableau de donn�es au format rasterfile
  *  8 bits avec une palette de 256 niveaux de gris du blanc (valeur 0)
@@ -123,46 +186,15 @@ unsigned char cos_composante(int i, double freq) {
 
 void sauver_rasterfile( char *nom, int largeur, int hauteur, unsigned char *p) {
   FILE *fd;
-  struct rasterfile file;
-  int i;
-  unsigned char o;
+  unsigned char e[ENTETE_RASTERFILE];
 
   if ( (fd=fopen(nom, "w")) == NULL ) {
 	printf("erreur dans la creation du fichier %s \n",nom);
 	exit(1);
   }
 
-  file.ras_magic  = swap(RAS_MAGIC);
-  file.ras_width  = swap(largeur);	  /* largeur en pixels de l'image */
-  file.ras_height = swap(hauteur);         /* hauteur en pixels de l'image */
-  file.ras_depth  = swap(8);	          /* profondeur de chaque pixel (1, 8 ou 24 )   */
-  file.ras_length = swap(largeur*hauteur); /* taille de l'image en nb de bytes		*/
-  file.ras_type    = swap(RT_STANDARD);	  /* type de fichier */
-  file.ras_maptype = swap(RMT_EQUAL_RGB);
-  file.ras_maplength = swap(256*3);
-
-  fwrite(&file, sizeof(struct rasterfile), 1, fd);
-
-  /* Palette de couleurs : composante rouge */
-  i = 256;
-  while( i--) {
-    o = COMPOSANTE_ROUGE(i);
-    fwrite( &o, sizeof(unsigned char), 1, fd);
-  }
-
-  /* Palette de couleurs : composante verte */
-  i = 256;
-  while( i--) {
-    o = COMPOSANTE_VERT(i);
-    fwrite( &o, sizeof(unsigned char), 1, fd);
-  }
-
-  /* Palette de couleurs : composante bleu */
-  i = 256;
-  while( i--) {
-    o = COMPOSANTE_BLEU(i);
-    fwrite( &o, sizeof(unsigned char), 1, fd);
-  }
+  entete_rasterfile( e, largeur, hauteur);
+  fwrite( e, ENTETE_RASTERFILE, 1, fd);
 
   // pour verifier l'ordre des lignes dans l'image :
   //fwrite( p, largeur*hauteur/3, sizeof(unsigned char), fd);
@@ -170,45 +202,10 @@ void sauver_rasterfile( char *nom, int largeur, int hauteur, unsigned char *p) {
   // pour voir la couleur du '0' :
   // memset (p, 0, largeur*hauteur);
 
-  fwrite( p, largeur*hauteur, sizeof(unsigned char), fd);
+  fwrite( p, (size_t)largeur*hauteur, sizeof(unsigned char), fd);
   fclose( fd);
 }
 
-/**
- * �tant donn�e les coordonn�es d'un point \f$c=a+ib\f$ dans le plan
- * complexe, la fonction retourne la couleur correspondante estimant
- * � quelle distance de l'ensemble de mandelbrot le point est.
- * Soit la suite complexe d�fini par:
- * \f[
- * \left\{\begin{array}{l}
- * z_0 = 0 \\
- * z_{n+1} = z_n^2 - c
- * \end{array}\right.
- * \f]
- * le nombre d'it�rations que la suite met pour diverger est le
- * nombre \f$ n \f$ pour lequel \f$ |z_n| > 2 \f$.
- * Ce nombre est ramen� � une valeur entre 0 et 255 correspond ainsi a
- * une couleur dans la palette des couleurs.
- */
-
-unsigned char xy2color(double a, double b, int prof) {
-  double x, y, temp, x2, y2;
-  int i;
-
-  x = y = 0.;
-  for( i=0; i<prof; i++) {
-    /* garder la valeur pr�c�dente de x qui va etre ecrase */
-    temp = x;
-    /* nouvelles valeurs de x et y */
-    x2 = x*x;
-    y2 = y*y;
-    x = x2 - y2 + a;
-    y = 2*temp*y + b;
-    if( x2 + y2 >= 4.0) break;
-  }
-  return (i==prof)?255:(int)((i%255));
-}
-
 /*
  * Partie principale: en chaque point de la grille, appliquer xy2color
  */
@@ -226,15 +223,58 @@ int main(int argc, char *argv[]) {
   /* Image resultat */
   unsigned char	*ima, *pima;
   /* Variables intermediaires */
-  int  i, j;
-  double x, y;
+  int  i;
+  double y;
   /* Chronometrage */
   double debut, fin;
+  /* Valeur d'option */
+  char *opt;
+  /* Subdivision de Mariani-Silver */
+  int mode_mariani = 0, taille_min = MARIANI_TAILLE_MIN;
+  mariani ms;
+  /* Grille et precision du calcul */
+  grille g;
+  int precision = PRECISION_AUTO;
+  /* Nombres d'iterations bruts (option -iter) */
+  char *fichier_iter;
+  int *iter = NULL, *piter = NULL;
+  /* Calcul reprenable (option -reprise) */
+  char *fichier_reprise;
+  reprise rep;
+  /* Vue precedente (option -cache) */
+  char *fichier_cache;
+  cache ca;
+  int cache_ok = 0;
+  /* Symetrie par rapport a l'axe reel : la ligne axe - i est recopiee */
+  int symetrie = 1, axe, a, b;
+  /* Rendu par bandes (option -bandes n, 0 : image entiere) */
+  int bande = 0, nb, i0, n;
+  FILE *fd_ima = NULL, *fd_iter = NULL;
+  bandes bi = { 0 }, bt = { 0 };
+  iter_entete ie;
 
   /* debut du chronometrage */
   debut = my_gettimeofday();
 
 
+  /* Options facultatives */
+  if( option_presente(&argc, argv, "-nocardio")) noyau_cardioide = 0;
+  if( option_presente(&argc, argv, "-cardio")) noyau_cardioide = 1;
+  if( option_presente(&argc, argv, "-periode")) noyau_periode = 1;
+  if( (opt = option_valeur(&argc, argv, "-eps_periode"))) noyau_periode_eps = atof(opt);
+  if( option_presente(&argc, argv, "-mariani")) mode_mariani = 1;
+  if( (opt = option_valeur(&argc, argv, "-taille_min"))) taille_min = atoi(opt);
+  if( (opt = option_valeur(&argc, argv, "-precision"))) precision = precision_depuis_nom(opt);
+  if( formule_options(&argc, argv) != 0) {
+    fprintf( stderr, "%s\n", info);
+    return 1;
+  }
+  fichier_iter = option_valeur(&argc, argv, "-iter");
+  fichier_reprise = option_valeur(&argc, argv, "-reprise");
+  fichier_cache = option_valeur(&argc, argv, "-cache");
+  if( option_presente(&argc, argv, "-nosymetrie")) symetrie = 0;
+  if( (opt = option_valeur(&argc, argv, "-bandes"))) bande = atoi(opt);
+
   if( argc == 1) fprintf( stderr, "%s\n", info);
 
   /* Valeurs par defaut de la fractale */
@@ -255,32 +295,150 @@ int main(int argc, char *argv[]) {
   /* Calcul des pas d'incrementation */
   xinc = (xmax - xmin) / (w-1);
   yinc = (ymax - ymin) / (h-1);
+  g = (grille){ xmin, xinc, ymin, yinc };
+  precision_choisir( precision, xmin, ymin, xmax, ymax, xinc, yinc, prof);
 
   /* affichage parametres pour verificatrion */
   fprintf( stderr, "Domaine: {[%lg,%lg]x[%lg,%lg]}\n", xmin, ymin, xmax, ymax);
   fprintf( stderr, "Increment : %lg %lg\n", xinc, yinc);
   fprintf( stderr, "Prof: %d\n",  prof);
   fprintf( stderr, "Dim image: %dx%d\n", w, h);
+  fprintf( stderr, "Noyau: %s\n", noyau_nom());
+  precision_afficher();
+  formule_afficher();
+  fprintf( stderr, "Cardioide: %s\n", noyau_cardioide ? "oui" : "non");
+  if( noyau_periode) fprintf( stderr, "Periodicite: eps %lg\n", noyau_periode_eps);
+  if( mode_mariani) fprintf( stderr, "Mariani-Silver: taille min %d\n", taille_min);
+  if( fichier_reprise && (mode_mariani || noyau_precision == PRECISION_DD)) {
+    fprintf( stderr, "Reprise: impossible avec -mariani ou en double-double\n");
+    fichier_reprise = NULL;
+  }
+  if( fichier_cache && (mode_mariani || fichier_reprise)) {
+    fprintf( stderr, "Cache: impossible avec -mariani ou -reprise\n");
+    fichier_cache = NULL;
+  }
+  if( bande > 0 && (fichier_reprise || fichier_cache)) {
+    fprintf( stderr, "Bandes: impossible avec -reprise ou -cache\n");
+    bande = 0;
+  }
+  if( bande >= h) bande = 0;
+  if( bande > 0) fprintf( stderr, "Bandes: %d lignes, %ld octets en memoire\n", bande,
+                          (long)(fichier_iter ? 1 + sizeof(int) : 1)*w*bande);
+  axe = symetrie && formule_symetrique() && !fichier_reprise ? symetrie_axe( ymin, yinc, h) : -1;
+  if( axe >= 0) fprintf( stderr, "Symetrie: %d lignes recopiees\n", symetrie_recopiees( axe, h));
 
-  /* Allocation memoire du tableau resultat */
-  pima = ima = (unsigned char *)malloc( w*h*sizeof(unsigned char));
+  /* Allocation memoire du tableau resultat (une bande avec -bandes) */
+  nb = bande > 0 ? bande : h;
+  pima = ima = (unsigned char *)malloc( (long)w*nb*sizeof(unsigned char));
 
   if( ima == NULL) {
     fprintf( stderr, "Erreur allocation m�moire du tableau \n");
     return 0;
   }
+  if( fichier_cache)
+    cache_ok = cache_charger( fichier_cache, &ca, &g, w, h, prof) == 0;
+  if( (fichier_iter || fichier_cache) && !fichier_reprise) {
+    piter = iter = (int *)malloc( (long)w*nb*sizeof(int));
+    if( iter == NULL) {
+      fprintf( stderr, "Erreur allocation memoire des iterations \n");
+      return 0;
+    }
+  }
+  if( bande > 0) {
+    /* Les bandes sont ajoutees au fur et a mesure, apres les entetes */
+    unsigned char e[ENTETE_RASTERFILE];
+    ie = iter_entete_creer( w, h, prof, xmin, ymin, xmax, ymax);
+    if( (fd_ima = fopen( "mandel.ras", "w+")) == NULL
+        || (fichier_iter && (fd_iter = fopen( fichier_iter, "w+")) == NULL)) {
+      fprintf( stderr, "erreur dans la creation du fichier %s\n",
+               fd_ima ? fichier_iter : "mandel.ras");
+      exit(1);
+    }
+    entete_rasterfile( e, w, h);
+    fwrite( e, ENTETE_RASTERFILE, 1, fd_ima);
+    bandes_init( &bi, fd_ima, ftello( fd_ima), w, axe);
+    if( fd_iter) {
+      fwrite( &ie, sizeof(ie), 1, fd_iter);
+      bandes_init( &bt, fd_iter, sizeof(ie), (size_t)w*ie.octets, axe);
+    }
+  }
 
-  /* Traitement de la grille point par point */
-  y = ymin;
-  for (i = 0; i < h; i++) {
-    x = xmin;
-    for (j = 0; j < w; j++) {
-      // printf("%d\n", xy2color( x, y, prof));
-      // printf("(x,y)=(%g;%g)\t (i,j)=(%d,%d)\n", x, y, i, j);
-      *pima++ = xy2color( x, y, prof);
-      x += xinc;
+  if( fichier_reprise && reprise_charger( fichier_reprise, &rep, w, h, prof,
+                                          xmin, ymin, xmax, ymax) == 0) {
+    /* Seuls les points encore actifs au prof precedent sont poursuivis */
+    fprintf( stderr, "Reprise: %ld points poursuivis de %d a %d iterations\n",
+             rep.n, rep.e.prof, prof);
+    reprise_poursuivre( &rep, prof, ima);
+  } else if( fichier_reprise) {
+    /* Calcul neuf qui garde les orbites des points actifs */
+    if( reprise_creer( &rep, w, h, prof, xmin, ymin, xmax, ymax) != 0) {
+      fprintf( stderr, "Erreur allocation memoire des iterations \n");
+      return 0;
+    }
+    y = ymin;
+    for (i = 0; i < h; i++) {
+      reprise_ligne( &rep, xmin, xinc, y, i, pima);
+      pima += w;
+      y += yinc;
+    }
+  } else {
+    /* Par bandes de nb lignes (une seule sans -bandes) */
+    ms = (mariani){ .ima = ima, .w = w, .g = g,
+                    .prof = prof, .taille_min = taille_min, .iter = iter };
+    y = ymin;
+    for (i0 = 0; i0 < h; i0 += nb) {
+      n = h - i0 < nb ? h - i0 : nb;
+      pima = ima;
+      piter = iter;
+      if( mode_mariani) {
+        /* Subdivision recursive : seuls les bords des rectangles sont calcules */
+        for (a = i0; a < i0 + n; a = b) {
+          /* par suites de lignes calculees */
+          b = symetrie_suite( a, axe, i0 + n);
+          if( !symetrie_calculee( a, axe)) continue;
+          ms.ima = ima + (long)(a - i0)*w;
+          ms.iter = iter ? iter + (long)(a - i0)*w : NULL;
+          ms.i0 = a;
+          mariani_silver( &ms, b - a);
+        }
+      } else {
+        /* Traitement de la grille ligne par ligne (noyau vectoriel) */
+        for (i = i0; i < i0 + n; i++) {
+          if( !symetrie_calculee( i, axe)) {
+            /* ligne miroir, recopiee a la fin */
+            if( iter) piter += w;
+          } else if( cache_ok) {
+            cache_ligne( &ca, &g, i, y, w, prof, piter);
+            iter2color( piter, w, prof, pima);
+            piter += w;
+          } else if( iter) {
+            xy2iter_grille( &g, i, y, 0, w, prof, piter);
+            iter2color( piter, w, prof, pima);
+            piter += w;
+          } else {
+            xy2color_grille( &g, i, y, 0, w, prof, pima);
+          }
+          pima += w;
+          y += yinc;
+        }
+      }
+      if( bande > 0) {
+        /* la bande (lignes miroir comprises) part dans les fichiers */
+        if( fd_iter && ie.octets == 2) bandes_iter_court( iter, (long)w*n);
+        if( bandes_ecrire( &bi, ima, i0, n) != 0
+            || (fd_iter && bandes_ecrire( &bt, iter, i0, n) != 0)) {
+          fprintf( stderr, "erreur dans l'ecriture de la bande %d\n", i0);
+          exit(1);
+        }
+      }
     }
-    y += yinc;
+  }
+  if( bande > 0) {
+    fclose( fd_ima);
+    if( fd_iter) fclose( fd_iter);
+  } else {
+    symetrie_recopier( ima, w, h, axe);
+    if( iter) symetrie_recopier( iter, w*sizeof(int), h, axe);
   }
 
   /* fin du chronometrage */
@@ -288,9 +446,22 @@ int main(int argc, char *argv[]) {
   fprintf( stderr, "Temps total de calcul : %g sec\n",
 	   fin - debut);
   fprintf( stdout, "%g\n", fin - debut);
+  if( noyau_periode) periode_afficher( &noyau_stats, (long long)w*h);
+  if( mode_mariani) mariani_afficher( ms.calcules, (long long)w*h);
+  if( cache_ok) cache_afficher( &ca, (long long)w*h);
 
   /* Sauvegarde de la grille dans le fichier resultat "mandel.ras" */
+  if( bande > 0) return 0;
   sauver_rasterfile( "mandel.ras", w, h, ima);
+  if( fichier_reprise) {
+    reprise_sauver( fichier_reprise, &rep);
+    if( fichier_iter) iter_sauver( fichier_iter, &rep.e, rep.iter);
+  }
+  if( iter) {
+    iter_entete e = iter_entete_creer( w, h, prof, xmin, ymin, xmax, ymax);
+    if( fichier_iter) iter_sauver( fichier_iter, &e, iter);
+    if( fichier_cache) cache_sauver( fichier_cache, &e, iter);
+  }
 
   return 0;
 }
@@ -0,0 +1,706 @@
+/*
+ * Programmation Parallèle - Avril 2012
+ * Polytech'Paris
+ * Université Pierre et Marie Curie
+ * Calcul de l'ensemble de Mandelbrot, animation de zoom
+ */
+
+#define MAITRE 0 // Définition rank = 0 => master
+#define TAG_UNITE 50
+#define TAG_IM 51
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>	/* chronometrage */
+#include <string.h>     /* pour memset */
+#include <math.h>
+#include <mpi.h>
+#include <sys/time.h>
+
+#include "rasterfile.h"
+#include "mandel_noyau.h"
+#include "mandel_options.h"
+#include "mandel_perturbation.h"
+
+
+
+char info[] = "\
+Usage:\n\
+      mandel_anim dimx dimy chemin [nlin] [options]\n\
+\n\
+      dimx,dimy : dimensions des images a generer\n\
+      chemin : fichier des images cles, une par ligne : cx cy rayon prof\n\
+               (centre en decimaux de longueur quelconque, demi-hauteur\n\
+               du domaine, nombre maximal d'iterations ; # : commentaire)\n\
+      nlin : nombre de lignes par bloc (defaut 16)\n\
+\n\
+Options\n\
+      -images n : n images par intervalle entre deux cles (defaut 1) :\n\
+                  rayon geometrique, centre se rapprochant de la cle\n\
+                  suivante comme le rayon, prof lineaire\n\
+      -fenetre n : au plus n images en cours de calcul (defaut 4)\n\
+      -sortie nom : images nom_0000.ras, nom_0001.ras... (defaut anim)\n\
+      -noserie : pas d'approximation en serie (zoom profond)\n\
+      -eps_serie eps : ecart relatif tolere entre la serie et les sondes\n\
+\n\
+Quelques exemples d'execution (fichier zoom.txt de deux lignes :\n\
+      -0.75 0 1.5 500\n\
+      -0.743643887037158704752191506114774 0.131825904205311970493132056385139 1e-20 20000)\n\
+      mpirun -np 4 mandel_anim 320 240 zoom.txt -images 100\n\
+      mpirun -np 4 mandel_anim 800 800 zoom.txt 8 -images 25 -fenetre 8\n\
+";
+
+
+
+double my_gettimeofday(){
+  struct timeval tmp_time;
+  gettimeofday(&tmp_time, NULL);
+  return tmp_time.tv_sec + (tmp_time.tv_usec * 1.0e-6L);
+}
+
+
+
+
+/**
+ * Convertion entier (4 octets) LINUX en un entier SUN
+ * @param i entier � convertir
+ * @return entier converti
+ */
+
+int swap(int i) {
+  int init = i;
+  int conv;
+  unsigned char *o, *d;
+
+  o = ( (unsigned char *) &init) + 3;
+  d = (unsigned char *) &conv;
+
+  *d++ = *o--;
+  *d++ = *o--;
+  *d++ = *o--;
+  *d++ = *o--;
+
+  return conv;
+}
+
+
+/***
+ * Par Francois-Xavier MOREL (M2 SAR, oct2009):
+ */
+
+unsigned char power_composante(int i, int p) {
+  unsigned char o;
+  double iD=(double) i;
+
+  iD/=255.0;
+  iD=pow(iD,p);
+  iD*=255;
+  o=(unsigned char) iD;
+  return o;
+}
+
+unsigned char cos_composante(int i, double freq) {
+  unsigned char o;
+  double iD=(double) i;
+  iD=cos(iD/255.0*2*M_PI*freq);
+  iD+=1;
+  iD*=128;
+
+  o=(unsigned char) iD;
+  return o;
+}
+
+/***
+ * Choix du coloriage : definir une (et une seule) des constantes
+ * ci-dessous :
+ */
+//#define ORIGINAL_COLOR
+#define COS_COLOR
+
+#ifdef ORIGINAL_COLOR
+#define COMPOSANTE_ROUGE(i)    ((i)/2)
+#define COMPOSANTE_VERT(i)     ((i)%190)
+#define COMPOSANTE_BLEU(i)     (((i)%120) * 2)
+#endif /* #ifdef ORIGINAL_COLOR */
+#ifdef COS_COLOR
+#define COMPOSANTE_ROUGE(i)    cos_composante(i,13.0)
+#define COMPOSANTE_VERT(i)     cos_composante(i,5.0)
+#define COMPOSANTE_BLEU(i)     cos_composante(i+10,7.0)
+#endif /* #ifdef COS_COLOR */
+
+
+/**
+ *  Sauvegarde le tableau de donn�es au format rasterfile
+ *  8 bits avec une palette de 256 niveaux de gris du blanc (valeur 0)
+ *  vers le noir (255)
+ *    @param nom Nom de l'image
+ *    @param largeur largeur de l'image
+ *    @param hauteur hauteur de l'image
+ *    @param p pointeur vers tampon contenant l'image
+ */
+
+void sauver_rasterfile( char *nom, int largeur, int hauteur, unsigned char *p) {
+  FILE *fd;
+  struct rasterfile file;
+  int i;
+  unsigned char o;
+
+  if ( (fd=fopen(nom, "w")) == NULL ) {
+	printf("erreur dans la creation du fichier %s \n",nom);
+	exit(1);
+  }
+
+  file.ras_magic  = swap(RAS_MAGIC);
+  file.ras_width  = swap(largeur);	  /* largeur en pixels de l'image */
+  file.ras_height = swap(hauteur);         /* hauteur en pixels de l'image */
+  file.ras_depth  = swap(8);	          /* profondeur de chaque pixel (1, 8 ou 24 )   */
+  file.ras_length = swap(largeur*hauteur); /* taille de l'image en nb de bytes		*/
+  file.ras_type    = swap(RT_STANDARD);	  /* type de fichier */
+  file.ras_maptype = swap(RMT_EQUAL_RGB);
+  file.ras_maplength = swap(256*3);
+
+  fwrite(&file, sizeof(struct rasterfile), 1, fd);
+
+  /* Palette de couleurs : composante rouge */
+  i = 256;
+  while( i--) {
+    o = COMPOSANTE_ROUGE(i);
+    fwrite( &o, sizeof(unsigned char), 1, fd);
+  }
+
+  /* Palette de couleurs : composante verte */
+  i = 256;
+  while( i--) {
+    o = COMPOSANTE_VERT(i);
+    fwrite( &o, sizeof(unsigned char), 1, fd);
+  }
+
+  /* Palette de couleurs : composante bleu */
+  i = 256;
+  while( i--) {
+    o = COMPOSANTE_BLEU(i);
+    fwrite( &o, sizeof(unsigned char), 1, fd);
+  }
+
+  // pour verifier l'ordre des lignes dans l'image :
+  //fwrite( p, largeur*hauteur/3, sizeof(unsigned char), fd);
+
+  // pour voir la couleur du '0' :
+  // memset (p, 0, largeur*hauteur);
+
+  fwrite( p, largeur*hauteur, sizeof(unsigned char), fd);
+  fclose( fd);
+}
+
+
+/* Image cle du fichier chemin */
+typedef struct {
+  char *cx, *cy;    /* centre, decimaux en texte */
+  double rayon;     /* demi-hauteur du domaine */
+  int prof;
+} cle;
+
+/* Image de l'animation */
+typedef struct {
+  grand cr, ci;     /* centre */
+  double rayon, pas;
+  int prof;
+  int profond;      /* pas trop petit pour le double : calcul par perturbations */
+  int ref;          /* image au centre de laquelle est prise l'orbite de reference */
+  int prof_ref;     /* profondeur de cette orbite (sur l'image ref), 0 sinon */
+} image_anim;
+
+/* Derniere orbite de reference calculee par un processus */
+typedef struct {
+  reference ref;
+  int image;        /* image portant l'orbite, -1 si aucune */
+  int serie;        /* image pour laquelle la serie a ete calculee */
+  int orbites;      /* orbites calculees */
+  long long rebase; /* rebasements (glitchs) */
+} calcul_ref;
+
+/**
+ * Contenu du fichier nom, termine par un '\0'.
+ * @return texte (a liberer), NULL si le fichier est illisible
+ */
+char *lire_fichier( char *nom) {
+  FILE *fd;
+  char *texte;
+  long taille;
+
+  if ( (fd=fopen(nom, "r")) == NULL ) return NULL;
+  fseek( fd, 0, SEEK_END);
+  taille = ftell( fd);
+  fseek( fd, 0, SEEK_SET);
+  texte = (char *)malloc( taille + 1);
+  if( texte != NULL) texte[fread( texte, 1, taille, fd)] = '\0';
+  fclose( fd);
+  return texte;
+}
+
+/**
+ * Images cles du texte du fichier chemin : une par ligne, cx cy rayon prof
+ * (lignes vides et commentaires # ignores). Le texte est modifie.
+ * @return tableau de *n cles (a liberer), NULL en cas d'erreur
+ */
+cle *lire_chemin( char *texte, int *n) {
+  char *ligne, *suite, cx[2048], cy[2048];
+  cle *cles = NULL, *c;
+  double rayon;
+  int prof, taille = 0;
+
+  *n = 0;
+  for (ligne = texte; ligne != NULL && *ligne; ligne = suite) {
+    if( (suite = strchr( ligne, '\n')) != NULL) *suite++ = '\0';
+    if( sscanf( ligne, " %2047s", cx) != 1 || cx[0] == '#') continue;
+    if( sscanf( ligne, "%2047s %2047s %lf %d", cx, cy, &rayon, &prof) != 4
+        || !(rayon > 0) || prof < 1) {
+      fprintf( stderr, "Chemin : ligne incorrecte : %s\n", ligne);
+      free( cles);
+      return NULL;
+    }
+    if( *n == taille) {
+      taille = taille ? 2*taille : 16;
+      if( (c = (cle *)realloc( cles, taille*sizeof(cle))) == NULL) {
+        free( cles);
+        return NULL;
+      }
+      cles = c;
+    }
+    cles[*n] = (cle){ strdup( cx), strdup( cy), rayon, prof };
+    (*n)++;
+  }
+  if( *n == 0) {
+    fprintf( stderr, "Chemin : aucune image cle\n");
+    free( cles);
+    return NULL;
+  }
+  return cles;
+}
+
+/**
+ * Images de l'animation : n par intervalle entre deux cles, plus la
+ * derniere cle. De la cle a a la cle b, le rayon suit une progression
+ * geometrique et l'ecart au centre de b reste proportionnel a r - r_b :
+ * le centre de b ne bouge pas a l'ecran, comme pour un zoom vers ce point.
+ * Seul l'ecart a - b, petit, passe par un double.
+ * @return nombre d'images, 0 si un centre est incorrect
+ */
+int preparer_images( const cle *cles, int ncles, int n, int h, image_anim *im) {
+  grand ar, ai, br, bi, e;
+  double t, u, ra, rb;
+  int k, f, q = 0;
+
+  for (k = 0; k < ncles; k++) {
+    if( k > 0) {
+      ar = br;
+      ai = bi;
+    }
+    if( !grand_depuis_chaine( &br, cles[k].cx) || !grand_depuis_chaine( &bi, cles[k].cy)) {
+      fprintf( stderr, "Centre incorrect : %s %s\n", cles[k].cx, cles[k].cy);
+      return 0;
+    }
+    if( k == 0) continue;
+    ra = cles[k-1].rayon;
+    rb = cles[k].rayon;
+    for (f = 0; f < n; f++, q++) {
+      t = (double)f / n;
+      im[q].rayon = ra * pow( rb / ra, t);
+      im[q].prof = (int)lround( cles[k-1].prof + t*(cles[k].prof - cles[k-1].prof));
+      if( f == 0) {
+        im[q].cr = ar;
+        im[q].ci = ai;
+      } else {
+        u = ra != rb ? (im[q].rayon - rb) / (ra - rb) : 1. - t;
+        grand_depuis_double( &e, u*grand_ecart( &ar, &br));
+        grand_add( &im[q].cr, &br, &e);
+        grand_depuis_double( &e, u*grand_ecart( &ai, &bi));
+        grand_add( &im[q].ci, &bi, &e);
+      }
+    }
+  }
+  im[q].cr = br;
+  im[q].ci = bi;
+  im[q].rayon = cles[ncles-1].rayon;
+  im[q].prof = cles[ncles-1].prof;
+  q++;
+
+  for (f = 0; f < q; f++) {
+    im[f].pas = 2*im[f].rayon / (h-1);
+    im[f].profond = 0;
+    im[f].ref = -1;
+    im[f].prof_ref = 0;
+  }
+  return q;
+}
+
+/**
+ * Grille de l'image a (centre arrondi au double) ; fixe aussi
+ * noyau_precision d'apres son pas et sa profondeur.
+ */
+grille image_grille( const image_anim *a, int w) {
+  double cx = grand_vers_double( &a->cr), cy = grand_vers_double( &a->ci);
+  grille g = { cx - (w-1)/2.*a->pas, a->pas, cy - a->rayon, a->pas };
+  precision_choisir( PRECISION_AUTO, g.xmin, g.ymin, g.xmin + (w-1)*a->pas,
+                     cy + a->rayon, a->pas, a->pas, a->prof);
+  return g;
+}
+
+/* Le centre de l'image r est-il dans l'image f ? */
+int dans_image( const image_anim *im, int r, int f, int w) {
+  return fabs( grand_ecart( &im[r].cr, &im[f].cr)) <= (w-1)/2.*im[f].pas
+      && fabs( grand_ecart( &im[r].ci, &im[f].ci)) <= im[f].rayon;
+}
+
+/**
+ * Orbites de reference des images profondes. La perturbation vaut pour
+ * tout point de reference de l'image : on prend le centre de la cle vers
+ * laquelle on zoome tant qu'il est dans l'image (il ne bouge pas a
+ * l'ecran), sinon l'orbite de l'image precedente tant que son centre y
+ * reste, sinon une nouvelle orbite au centre de l'image. Une orbite est
+ * calculee a la plus grande profondeur des images qui la reprennent.
+ * @return nombre d'orbites
+ */
+int grouper_references( image_anim *im, int nimages, int n, int w) {
+  int f, c, r = -1, norbites = 0;
+
+  for (f = 0; f < nimages; f++) {
+    if( !im[f].profond) continue;
+    c = (f + n - 1) / n * n;
+    if( dans_image( im, c, f, w)) r = c;
+    else if( r < 0 || !dans_image( im, r, f, w)) r = f;
+    im[f].ref = r;
+    if( im[r].prof_ref == 0) norbites++;
+    if( im[f].prof > im[r].prof_ref) im[r].prof_ref = im[f].prof;
+  }
+  return norbites;
+}
+
+/**
+ * Couleurs des lignes i0..i0+nl-1 de l'image f dans ima, les lignes en
+ * parallele (OpenMP). Une image profonde reprend l'orbite de reference
+ * de c si c'est la sienne, et sa serie si c'est la meme image.
+ */
+void calculer_bloc( const image_anim *im, int f, int w, int h, int i0, int nl,
+                    int serie, double eps_serie, calcul_ref *c, unsigned char *ima) {
+  const image_anim *a = im + f, *r;
+  double ox, oy;
+  long long rebase = 0;
+  grille g;
+  int i;
+
+  if( !a->profond) {
+    g = image_grille( a, w);
+#pragma omp parallel for schedule(dynamic)
+    for (i = i0; i < i0 + nl; i++)
+      xy2color_grille( &g, i, g.ymin + i*g.yinc, 0, w, a->prof, ima + (size_t)(i-i0)*w);
+    return;
+  }
+
+  /* Orbite de reference, puis serie pour cette image (sondes autour de la reference) */
+  r = im + a->ref;
+  ox = grand_ecart( &a->cr, &r->cr);
+  oy = grand_ecart( &a->ci, &r->ci);
+  if( c->image != a->ref) {
+    if( c->image >= 0) reference_liberer( &c->ref);
+    reference_orbite( &c->ref, &r->cr, &r->ci, r->prof_ref);
+    c->image = a->ref;
+    c->serie = -1;
+    c->orbites++;
+  }
+  if( c->serie != f) {
+    c->ref.n0 = 0;
+    c->ref.ax = c->ref.ay = c->ref.bx = c->ref.by = c->ref.cx = c->ref.cy = 0.;
+    if( serie)
+      reference_serie( &c->ref, fabs(ox) + (w-1)/2.*a->pas, fabs(oy) + a->rayon, eps_serie);
+    c->serie = f;
+  }
+
+#pragma omp parallel for schedule(dynamic) reduction(+:rebase)
+  for (i = i0; i < i0 + nl; i++) {
+    int j, n;
+    for (j = 0; j < w; j++) {
+      n = perturbation_iter( &c->ref, ox + (j - (w-1)/2.)*a->pas,
+                             oy + (i - (h-1)/2.)*a->pas, a->prof, &rebase);
+      ima[(size_t)(i-i0)*w + j] = ITER2COLOR(n, a->prof);
+    }
+  }
+  c->rebase += rebase;
+}
+
+/* Sauve l'image f sous le nom sortie_f.ras */
+void ecrire_image( char *sortie, int f, int w, int h, unsigned char *ima, double debut) {
+  char nom[4096];
+  snprintf( nom, sizeof(nom), "%s_%04d.ras", sortie, f);
+  sauver_rasterfile( nom, w, h, ima);
+  fprintf( stderr, "Image %d ecrite (%s) a %g sec\n", f, nom, my_gettimeofday() - debut);
+}
+
+/**
+ * Envoie au processus rang l'unite de travail suivante si elle est avant
+ * limite (fenetre d'images), ou l'arret s'il n'y en a plus.
+ * @return 0 si le processus doit attendre que la fenetre avance
+ */
+int distribuer( int rang, int *unite, int nUnites, int limite) {
+  int stop = -1;
+  if( *unite >= nUnites) {
+    MPI_Send(&stop, 1, MPI_INT, rang, TAG_UNITE, MPI_COMM_WORLD);
+  } else if( *unite < limite) {
+    MPI_Send(unite, 1, MPI_INT, rang, TAG_UNITE, MPI_COMM_WORLD);
+    (*unite)++;
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
+/*
+ * Partie principale : les unites de travail (image, bloc de lignes) sont
+ * distribuees dans l'ordre des images par le maitre aux ouvriers, qui
+ * calculent les lignes d'un bloc en parallele (OpenMP). Le maitre ecrit
+ * chaque image des qu'elle est complete, les ouvriers continuant sur les
+ * suivantes ; au plus fenetre images sont en cours a la fois.
+ */
+
+int main(int argc, char *argv[]) {
+  /* Images cles et images de l'animation */
+  char *chemin, *texte = NULL;
+  cle *cles;
+  image_anim *im;
+  int ncles, nimages, nparcle = 1;
+  /* Dimension des images */
+  int w,h;
+  /* Nombre ligne par bloc */
+  int nlin;
+  /* Images en cours de calcul, et leur tampon sur le maitre */
+  int fenetre = 4;
+  unsigned char *tampon, *ima_loc;
+  /* Prefixe des images produites */
+  char *sortie = "anim";
+  /* Zoom profond : precision, orbite de reference et serie */
+  double rmin, pas_min;
+  int nprofonds = 0, norbites = 0, serie = 1;
+  double eps_serie = SERIE_EPS;
+  calcul_ref cref;
+  long long rebase;
+  int orbites;
+  /* Variables intermediaires */
+  int f, u, i0, nl;
+  long taille;
+  /* Chronometrage */
+  double debut, fin;
+  /* Valeur d'option */
+  char *opt;
+
+  /* debut du chronometrage */
+  debut = my_gettimeofday();
+
+  /* Options facultatives */
+  if( (opt = option_valeur(&argc, argv, "-images"))) nparcle = atoi(opt);
+  if( (opt = option_valeur(&argc, argv, "-fenetre"))) fenetre = atoi(opt);
+  if( (opt = option_valeur(&argc, argv, "-sortie"))) sortie = opt;
+  if( option_presente(&argc, argv, "-noserie")) serie = 0;
+  if( (opt = option_valeur(&argc, argv, "-eps_serie"))) eps_serie = atof(opt);
+
+  if( argc < 4) {
+    fprintf( stderr, "%s\n", info);
+    return 1;
+  }
+
+  /* Recuperation des parametres */
+  w = atoi(argv[1]);
+  h = atoi(argv[2]);
+  chemin = argv[3];
+  nlin = argc > 4 ? atoi(argv[4]) : 16;
+  if( nparcle < 1) nparcle = 1;
+  if( fenetre < 1) fenetre = 1;
+  if( nlin < 1) nlin = 1;
+
+  /**
+  *** Début parallelisation
+  **/
+  int rank; // rang du processeur
+  int p; // nombre processeur
+
+  MPI_Init(&argc, &argv); /* starts MPI */
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank); /* get current process id */
+  MPI_Comm_size(MPI_COMM_WORLD, &p);
+
+  MPI_Status status;
+
+  /* Le maitre lit le chemin et le diffuse : seul lui a besoin du fichier */
+  taille = 0;
+  if( rank == MAITRE) {
+    if( (texte = lire_fichier( chemin)) == NULL)
+      fprintf( stderr, "Chemin %s illisible\n", chemin);
+    else
+      taille = strlen( texte) + 1;
+  }
+  MPI_Bcast(&taille, 1, MPI_LONG, MAITRE, MPI_COMM_WORLD);
+  if( taille == 0) {
+    MPI_Finalize();
+    return 1;
+  }
+  if( rank != MAITRE) texte = (char *)malloc( taille);
+  MPI_Bcast(texte, taille, MPI_CHAR, MAITRE, MPI_COMM_WORLD);
+
+  /* Chaque processus en deduit les memes images */
+  cles = lire_chemin( texte, &ncles);
+  if( cles == NULL) {
+    MPI_Finalize();
+    return 1;
+  }
+  nimages = (ncles - 1)*nparcle + 1;
+
+  /* Precision des centres : 64 bits de mieux que le plus petit pas */
+  rmin = cles[0].rayon;
+  for (f = 1; f < ncles; f++) rmin = fmin( rmin, cles[f].rayon);
+  pas_min = 2*rmin / (h-1);
+  if( !(pas_min > 1e-290)) {
+    if( rank == MAITRE) fprintf( stderr, "Rayon %lg hors de portee du double\n", rmin);
+    MPI_Finalize();
+    return 1;
+  }
+  grand_mots = 2 + (int)((64 - log2(pas_min)) / 32);
+  if( grand_mots > GRAND_MOTS_MAX) grand_mots = GRAND_MOTS_MAX;
+
+  im = (image_anim *)malloc( nimages*sizeof(image_anim));
+  if( im == NULL || preparer_images( cles, ncles, nparcle, h, im) != nimages) {
+    MPI_Finalize();
+    return 1;
+  }
+
+  /* Zoom profond des que la precision double ne suffit plus */
+  for (f = 0; f < nimages; f++) {
+    image_grille( im + f, w);
+    im[f].profond = noyau_precision == PRECISION_DD;
+    nprofonds += im[f].profond;
+  }
+  norbites = grouper_references( im, nimages, nparcle, w);
+
+  int nBloc = (h + nlin - 1) / nlin; // Nombre de blocs par image
+  int nUnites = nimages*nBloc; // Nombre d'unites de travail
+  int unite = 0; // Prochaine unite a distribuer
+  int ecrites = 0, pretes = 0; // Images ecrites, images completes
+  int *recu = NULL; // Blocs recus par image
+  int *attente = NULL, nattente = 0; // Ouvriers en attente de la fenetre
+
+  memset( &cref, 0, sizeof(cref));
+  cref.image = cref.serie = -1;
+
+  const char *noyau = noyau_choisir();
+
+  if(rank == MAITRE){
+
+    /* Affichage parametres pour verification */
+    fprintf( stderr, "Chemin: %s (%d cles, %d images)\n", chemin, ncles, nimages);
+    fprintf( stderr, "Dim image: %dx%d\n", w, h);
+    fprintf( stderr, "Nombre lignes par bloc: %d\n", nlin);
+    fprintf( stderr, "Fenetre: %d images\n", fenetre);
+    fprintf( stderr, "Noyau: %s\n", noyau);
+    if( nprofonds)
+      fprintf( stderr, "Zoom profond: %d images, %d orbites de reference, precision %d bits%s\n",
+               nprofonds, norbites, 32*grand_mots, serie ? "" : ", sans serie");
+
+    if( p == 1) {
+      /* Sans ouvrier : le maitre calcule tout, image par image */
+      tampon = (unsigned char *)malloc( (size_t)w*h);
+      if( tampon == NULL) {
+        fprintf( stderr, "Erreur allocation mémoire du tableau \n");
+        return 0;
+      }
+      for (u = 0; u < nUnites; u++) {
+        f = u / nBloc;
+        i0 = (u % nBloc)*nlin;
+        nl = h - i0 < nlin ? h - i0 : nlin;
+        calculer_bloc( im, f, w, h, i0, nl, serie, eps_serie, &cref, tampon + (size_t)i0*w);
+        if( u % nBloc == nBloc - 1) ecrire_image( sortie, f, w, h, tampon, debut);
+      }
+    } else {
+      /* Allocation memoire des images de la fenetre */
+      tampon = (unsigned char *)malloc( (size_t)fenetre*w*h);
+      recu = (int *)calloc( nimages, sizeof(int));
+      attente = (int *)malloc( p*sizeof(int));
+      if( tampon == NULL || recu == NULL || attente == NULL) {
+        fprintf( stderr, "Erreur allocation mémoire du tableau \n");
+        return 0;
+      }
+
+      for (f = 0; f < p; f++)
+        if( f != MAITRE && !distribuer( f, &unite, nUnites, fenetre*nBloc))
+          attente[nattente++] = f;
+
+      while( ecrites < nimages) {
+        /* Reception d'un bloc, dans le tampon de son image */
+        MPI_Probe(MPI_ANY_SOURCE, TAG_UNITE, MPI_COMM_WORLD, &status);
+        int rank_src = status.MPI_SOURCE; // rank de la source
+        MPI_Recv(&u, 1, MPI_INT, rank_src, TAG_UNITE, MPI_COMM_WORLD, &status);
+        f = u / nBloc;
+        i0 = (u % nBloc)*nlin;
+        nl = h - i0 < nlin ? h - i0 : nlin;
+        MPI_Recv(tampon + ((size_t)(f % fenetre)*h + i0)*w, nl*w, MPI_UNSIGNED_CHAR,
+                 rank_src, TAG_IM, MPI_COMM_WORLD, &status);
+        recu[f]++;
+
+        /* La fenetre avance avec les images completes : l'ouvrier, et ceux
+           qui attendaient, repartent avant l'ecriture (le tampon d'une image
+           n'est reutilise qu'a la prochaine reception) */
+        while( pretes < nimages && recu[pretes] == nBloc) pretes++;
+        if( !distribuer( rank_src, &unite, nUnites, (pretes + fenetre)*nBloc))
+          attente[nattente++] = rank_src;
+        while( nattente > 0
+               && distribuer( attente[nattente-1], &unite, nUnites, (pretes + fenetre)*nBloc))
+          nattente--;
+
+        for ( ; ecrites < pretes; ecrites++)
+          ecrire_image( sortie, ecrites, w, h, tampon + (size_t)(ecrites % fenetre)*w*h, debut);
+      }
+      free( recu);
+      free( attente);
+    }
+    free( tampon);
+
+    /* fin du chronometrage */
+    fin = my_gettimeofday();
+    fprintf( stderr, "Temps total de calcul : %g sec\n", fin - debut);
+    fprintf( stdout, "%g\n", fin - debut);
+
+  } else {
+    /* Ouvrier : calcule les unites recues jusqu'a l'arret */
+    ima_loc = (unsigned char *)malloc( (size_t)nlin*w);
+    if( ima_loc == NULL) {
+      fprintf( stderr, "Erreur allocation mémoire du tableau \n");
+      return 0;
+    }
+    while( 1) {
+      MPI_Recv(&u, 1, MPI_INT, MAITRE, TAG_UNITE, MPI_COMM_WORLD, &status);
+      if( u < 0) break;
+      f = u / nBloc;
+      i0 = (u % nBloc)*nlin;
+      nl = h - i0 < nlin ? h - i0 : nlin;
+      calculer_bloc( im, f, w, h, i0, nl, serie, eps_serie, &cref, ima_loc);
+      MPI_Send(&u, 1, MPI_INT, MAITRE, TAG_UNITE, MPI_COMM_WORLD);
+      MPI_Send(ima_loc, nl*w, MPI_UNSIGNED_CHAR, MAITRE, TAG_IM, MPI_COMM_WORLD);
+    }
+    free( ima_loc);
+
+    /* fin du chronometrage */
+    fin = my_gettimeofday();
+    fprintf( stderr, "Rang %d | Temps total de calcul : %g sec\n", rank,
+       fin - debut);
+  }
+
+  /* Orbites calculees et rebasements, cumules sur le maitre */
+  if( nprofonds) {
+    MPI_Reduce(&cref.orbites, &orbites, 1, MPI_INT, MPI_SUM, MAITRE, MPI_COMM_WORLD);
+    MPI_Reduce(&cref.rebase, &rebase, 1, MPI_LONG_LONG, MPI_SUM, MAITRE, MPI_COMM_WORLD);
+    if( rank == MAITRE)
+      fprintf( stderr, "Orbites de reference calculees: %d (%d distinctes), rebasements: %lld\n",
+               orbites, norbites, rebase);
+  }
+  if( cref.image >= 0) reference_liberer( &cref.ref);
+
+  MPI_Finalize();
+
+  return 0;
+}
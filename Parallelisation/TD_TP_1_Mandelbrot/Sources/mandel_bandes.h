@@ -0,0 +1,83 @@
+/*
+ * Rendu par bandes (option -bandes n) : l'image est calculee par bandes
+ * horizontales de n lignes, ecrites a la suite dans le fichier resultat
+ * des qu'elles sont finies. Seule une bande est en memoire (et sa bande
+ * d'iterations avec -iter) : la memoire ne depend plus de h, et une image
+ * plus grande que la memoire (100000 x 100000, 10 Go) peut etre calculee.
+ *
+ * Les positions dans les fichiers sont sur 64 bits (off_t, fseeko).
+ *
+ * Avec la symetrie, la ligne source d'une ligne miroir est toujours
+ * avant elle : dans la meme bande, elle est recopiee depuis la memoire,
+ * sinon elle est relue dans le fichier deja ecrit.
+ */
+
+#ifndef _mandel_bandes_h
+#define _mandel_bandes_h
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "mandel_symetrie.h"
+
+typedef struct {
+  FILE *fd;
+  off_t debut;                    /* taille de l'entete */
+  size_t taille;                  /* octets par ligne dans le fichier */
+  int axe;                        /* -1 sans symetrie */
+} bandes;
+
+/**
+ * Prepare l'ecriture par bandes dans fd, ouvert en "w+" et place apres
+ * l'entete (debut octets), de lignes de taille octets.
+ */
+static inline void bandes_init(bandes *b, FILE *fd, off_t debut, size_t taille, int axe) {
+  b->fd = fd;
+  b->debut = debut;
+  b->taille = taille;
+  b->axe = axe;
+}
+
+/**
+ * Remplit les lignes miroir de la bande t (lignes i0..i0+n-1, au format
+ * du fichier) puis l'ajoute a la fin du fichier.
+ * @return 0, -1 en cas d'erreur de lecture ou d'ecriture
+ */
+static inline int bandes_ecrire(bandes *b, void *t, int i0, int n) {
+  char *l = (char *)t;
+  int i, s;
+
+  for (i = i0; i < i0 + n; i++) {
+    if (symetrie_calculee(i, b->axe)) continue;
+    s = b->axe - i;
+    if (s >= i0) {
+      memcpy(l + (size_t)(i - i0)*b->taille, l + (size_t)(s - i0)*b->taille, b->taille);
+      continue;
+    }
+    if (fseeko(b->fd, b->debut + (off_t)s*b->taille, SEEK_SET) != 0
+        || fread(l + (size_t)(i - i0)*b->taille, b->taille, 1, b->fd) != 1)
+      return -1;
+  }
+  /* retour a la fin (obligatoire entre une lecture et une ecriture) */
+  if (fseeko(b->fd, b->debut + (off_t)i0*b->taille, SEEK_SET) != 0
+      || fwrite(t, b->taille, n, b->fd) != (size_t)n)
+    return -1;
+  return 0;
+}
+
+/*
+ * Ramene en place n nombres d'iterations sur 16 bits (format du fichier
+ * d'iterations quand prof < 65536) : le court k prend la place du debut
+ * de l'entier k/2, deja lu (memcpy : pas d'alias entre int et short).
+ */
+static inline void bandes_iter_court(int *iter, long n) {
+  unsigned short c;
+  long k;
+  for (k = 0; k < n; k++) {
+    c = (unsigned short)iter[k];
+    memcpy((char *)iter + k*sizeof(c), &c, sizeof(c));
+  }
+}
+
+#endif /*!_mandel_bandes_h*/
@@ -0,0 +1,291 @@
+/*
+ * Programmation Parallèle - Avril 2012
+ * Polytech'Paris
+ * Université Pierre et Marie Curie
+ * Buddhabrot : densite des orbites de l'ensemble de Mandelbrot
+ */
+
+#define MAITRE 0 // Définition rank = 0 => master
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>	/* chronometrage */
+#include <string.h>     /* pour memset */
+#include <math.h>
+#include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <sys/time.h>
+
+#include "rasterfile.h"
+#include "mandel_noyau.h"
+#include "mandel_options.h"
+#include "mandel_buddha.h"
+
+
+
+char info[] = "\
+Usage:\n\
+      mandel_buddha dimx dimy xmin ymin xmax ymax prof echantillons [options]\n\
+\n\
+      dimx,dimy : dimensions de l'image a generer\n\
+      xmin,ymin,xmax,ymax : domaine de l'image dans le plan complexe\n\
+      prof : nombre maximale d'iteration\n\
+      echantillons : nombre de points c tires dans [-2,2]^2\n\
+\n\
+Options\n\
+      -pre n : grille n x n de la pre-passe qui oriente le tirage\n\
+               (defaut 1 : tirage uniforme ; 256 ou plus a grand prof\n\
+               et sur les vues zoomees)\n\
+      -graine g : autre suite de tirages (images independantes)\n\
+      -nocardio : pas de test de la cardioide et du disque de periode 2\n\
+      -periode : detection de periodicite des orbites (methode de Brent)\n\
+\n\
+Quelques exemples d'execution\n\
+      mandel_buddha 800 800 -2 -1.5 1 1.5 1000 1e7\n\
+      mpirun -np 4 mandel_buddha 1000 1000 -2 -1.5 1 1.5 5000 1e8 -pre 512\n\
+";
+
+
+
+double my_gettimeofday(){
+  struct timeval tmp_time;
+  gettimeofday(&tmp_time, NULL);
+  return tmp_time.tv_sec + (tmp_time.tv_usec * 1.0e-6L);
+}
+
+
+
+
+/**
+ * Convertion entier (4 octets) LINUX en un entier SUN
+ * @param i entier � convertir
+ * @return entier converti
+ */
+
+int swap(int i) {
+  int init = i;
+  int conv;
+  unsigned char *o, *d;
+
+  o = ( (unsigned char *) &init) + 3;
+  d = (unsigned char *) &conv;
+
+  *d++ = *o--;
+  *d++ = *o--;
+  *d++ = *o--;
+  *d++ = *o--;
+
+  return conv;
+}
+
+
+/**
+ *  Sauvegarde le tableau de donn�es au format rasterfile
+ *  8 bits avec une palette de 256 niveaux de gris du noir (valeur 0)
+ *  vers le blanc (255)
+ *    @param nom Nom de l'image
+ *    @param largeur largeur de l'image
+ *    @param hauteur hauteur de l'image
+ *    @param p pointeur vers tampon contenant l'image
+ */
+
+void sauver_rasterfile( char *nom, int largeur, int hauteur, unsigned char *p) {
+  FILE *fd;
+  struct rasterfile file;
+  int i, c;
+  unsigned char o;
+
+  if ( (fd=fopen(nom, "w")) == NULL ) {
+	printf("erreur dans la creation du fichier %s \n",nom);
+	exit(1);
+  }
+
+  file.ras_magic  = swap(RAS_MAGIC);
+  file.ras_width  = swap(largeur);	  /* largeur en pixels de l'image */
+  file.ras_height = swap(hauteur);         /* hauteur en pixels de l'image */
+  file.ras_depth  = swap(8);	          /* profondeur de chaque pixel (1, 8 ou 24 )   */
+  file.ras_length = swap(largeur*hauteur); /* taille de l'image en nb de bytes		*/
+  file.ras_type    = swap(RT_STANDARD);	  /* type de fichier */
+  file.ras_maptype = swap(RMT_EQUAL_RGB);
+  file.ras_maplength = swap(256*3);
+
+  fwrite(&file, sizeof(struct rasterfile), 1, fd);
+
+  /* Palette de couleurs : rouge, vert et bleu egaux */
+  for (c = 0; c < 3; c++)
+    for (i = 0; i < 256; i++) {
+      o = i;
+      fwrite( &o, sizeof(unsigned char), 1, fd);
+    }
+
+  fwrite( p, largeur*hauteur, sizeof(unsigned char), fd);
+  fclose( fd);
+}
+
+/*
+ * Partie principale : les paquets d'echantillons sont repartis entre les
+ * processus (paquet q au processus q mod P), puis entre les threads ;
+ * chaque thread trace dans son histogramme. Les histogrammes d'un
+ * processus sont sommes, puis ceux des processus par MPI_Reduce.
+ */
+
+int main(int argc, char *argv[]) {
+  /* Domaine de l'image dans le plan complexe */
+  double xmin, ymin;
+  double xmax, ymax;
+  /* Dimension de l'image */
+  int w,h;
+  /* Profondeur d'iteration */
+  int prof;
+  /* Echantillons, en paquets de BUDDHA_PAQUET */
+  double echantillons;
+  long npaquets, q, tracees = 0, total;
+  /* Image, loi de tirage et histogrammes (un par thread) */
+  buddha_image bi;
+  buddha_loi loi;
+  int pre = 1, nthreads, t, erreur = 0;
+  unsigned long long graine = 0;
+  float **hist, *densite;
+  /* Image resultat */
+  unsigned char	*ima;
+  /* Chronometrage */
+  double debut, t_loi, t_pre, t_trace, fin;
+  /* Valeur d'option */
+  char *opt;
+
+  /* debut du chronometrage */
+  debut = my_gettimeofday();
+
+  /* Options facultatives */
+  if( (opt = option_valeur(&argc, argv, "-pre"))) pre = atoi(opt);
+  if( (opt = option_valeur(&argc, argv, "-graine"))) graine = strtoull(opt, NULL, 10);
+  if( option_presente(&argc, argv, "-nocardio")) noyau_cardioide = 0;
+  if( option_presente(&argc, argv, "-periode")) noyau_periode = 1;
+
+  if( argc == 1) fprintf( stderr, "%s\n", info);
+
+  /* Valeurs par defaut */
+  xmin = -2; ymin = -1.5;
+  xmax =  1; ymax =  1.5;
+  w = h = 800;
+  prof = 1000;
+  echantillons = 1e7;
+
+  /* Recuperation des parametres */
+  if( argc > 1) w    = atoi(argv[1]);
+  if( argc > 2) h    = atoi(argv[2]);
+  if( argc > 3) xmin = atof(argv[3]);
+  if( argc > 4) ymin = atof(argv[4]);
+  if( argc > 5) xmax = atof(argv[5]);
+  if( argc > 6) ymax = atof(argv[6]);
+  if( argc > 7) prof = atoi(argv[7]);
+  if( argc > 8) echantillons = atof(argv[8]);
+  if( pre < 1) pre = 1;
+  npaquets = (long)ceil( echantillons / BUDDHA_PAQUET);
+
+  /**
+  *** Début parallelisation
+  **/
+  int rank; // rang du processeur
+  int p; // nombre processeur
+
+  MPI_Init(&argc, &argv); /* starts MPI */
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank); /* get current process id */
+  MPI_Comm_size(MPI_COMM_WORLD, &p);
+
+  buddha_image_init( &bi, w, h, xmin, ymin, xmax, ymax);
+#ifdef _OPENMP
+  nthreads = omp_get_max_threads();
+#else
+  nthreads = 1;
+#endif
+  const char *noyau = noyau_choisir();
+
+  if( rank == MAITRE) {
+    /* Affichage parametres pour verification */
+    fprintf( stderr, "Domaine: {[%lg,%lg]x[%lg,%lg]}\n", xmin, ymin, xmax, ymax);
+    fprintf( stderr, "Prof: %d\n",  prof);
+    fprintf( stderr, "Dim image: %dx%d\n", w, h);
+    fprintf( stderr, "Echantillons: %ld paquets de %d\n", npaquets, BUDDHA_PAQUET);
+    fprintf( stderr, "Noyau: %s\n", noyau);
+    fprintf( stderr, "Histogrammes: %d processus x %d threads, tuiles %dx%d\n",
+             p, nthreads, BUDDHA_TUILE, BUDDHA_TUILE);
+    if( pre > 1) fprintf( stderr, "Pre-passe: grille %dx%d\n", pre, pre);
+    else fprintf( stderr, "Tirage uniforme\n");
+  }
+
+  /* Loi de tirage : chaque processus fait la meme pre-passe, petite */
+  t_loi = my_gettimeofday();
+  if( buddha_loi_init( &loi, pre, prof, &bi) != 0) {
+    fprintf( stderr, "Erreur allocation mémoire de la loi de tirage \n");
+    return 0;
+  }
+  t_pre = my_gettimeofday();
+
+  /* Trace des orbites, chaque thread dans son histogramme */
+  hist = (float **)calloc( nthreads, sizeof(float *));
+  if( hist == NULL) {
+    fprintf( stderr, "Erreur allocation mémoire des histogrammes \n");
+    return 0;
+  }
+#pragma omp parallel private(t, q) reduction(+:tracees, erreur)
+  {
+#ifdef _OPENMP
+    t = omp_get_thread_num();
+#else
+    t = 0;
+#endif
+    /* alloue par le thread qui s'en sert (premier contact) */
+    hist[t] = (float *)calloc( bi.taille, sizeof(float));
+    if( hist[t] == NULL) erreur++;
+#pragma omp barrier
+#pragma omp for schedule(dynamic)
+    for (q = rank; q < npaquets; q += p)
+      if( hist[t] != NULL) tracees += buddha_paquet( &bi, &loi, (graine << 32) + q, prof, hist[t]);
+  }
+  if( erreur) {
+    fprintf( stderr, "Erreur allocation mémoire des histogrammes \n");
+    return 0;
+  }
+  t_trace = my_gettimeofday();
+
+  /* Somme des histogrammes des threads, puis des processus */
+  densite = (float *)malloc( (size_t)w*h*sizeof(float));
+  ima = (unsigned char *)malloc( (size_t)w*h*sizeof(unsigned char));
+  if( densite == NULL || ima == NULL) {
+    fprintf( stderr, "Erreur allocation mémoire du tableau \n");
+    return 0;
+  }
+  buddha_fusionner( &bi, hist, nthreads, densite);
+  for (t = 0; t < nthreads; t++) free( hist[t]);
+  free( hist);
+  MPI_Reduce( rank == MAITRE ? MPI_IN_PLACE : densite, densite, w*h, MPI_FLOAT,
+              MPI_SUM, MAITRE, MPI_COMM_WORLD);
+  MPI_Reduce(&tracees, &total, 1, MPI_LONG, MPI_SUM, MAITRE, MPI_COMM_WORLD);
+
+  if( rank == MAITRE) {
+    buddha_niveaux( densite, (long)w*h, ima);
+
+    /* fin du chronometrage */
+    fin = my_gettimeofday();
+    fprintf( stderr, "Pre-passe: %g sec, trace: %g sec, fusion: %g sec\n",
+             t_pre - t_loi, t_trace - t_pre, fin - t_trace);
+    fprintf( stderr, "Temps total de calcul : %g sec\n", fin - debut);
+    fprintf( stdout, "%g\n", fin - debut);
+    fprintf( stderr, "Orbites tracees: %ld sur %ld (%.1f%%)\n", total,
+             npaquets*BUDDHA_PAQUET, 100. * total / (npaquets*BUDDHA_PAQUET));
+
+    /* Sauvegarde de la grille dans le fichier resultat "mandel.ras" */
+    sauver_rasterfile( "mandel.ras", w, h, ima);
+  }
+
+  buddha_loi_liberer( &loi);
+  free( densite);
+  free( ima);
+
+  MPI_Finalize();
+
+  return 0;
+}
@@ -0,0 +1,303 @@
+/*
+ * Buddhabrot : densite des orbites qui divergent. On tire des points c,
+ * on ecarte avec le noyau vectoriel (xy2iter_points) ceux dont l'orbite
+ * ne diverge pas avant prof iterations, puis on refait l'orbite des
+ * autres en comptant chaque z_k qui tombe dans l'image.
+ *
+ * Histogrammes : chaque thread a le sien, donc aucun atomique. Il est
+ * range par tuiles de BUDDHA_TUILE x BUDDHA_TUILE pixels, si bien que les
+ * points voisins d'une orbite tombent dans la meme zone memoire. Les
+ * histogrammes sont sommes a la fin, tuile par tuile (buddha_fusionner).
+ *
+ * Echantillonnage preferentiel : un point dont l'orbite ne diverge pas
+ * coute prof iterations sans rien apporter, un point dont l'orbite ne
+ * passe pas dans l'image n'apporte rien non plus. Une pre-passe en temps
+ * d'evasion sur une grille n x n de [-2,2]^2, 2 x 2 sondes par case,
+ * estime pour chaque case le nombre moyen f de points d'orbite dans
+ * l'image et le cout moyen c d'un echantillon. La variance de l'image
+ * (sommee sur les pixels) pour un temps donne est minimale pour
+ * p_k ~ racine(f / c), melangee a la loi uniforme (BUDDHA_MELANGE) pour
+ * garder toutes les cases possibles et borner les poids. Chaque
+ * echantillon compte pour (1/n^2) / p_k : l'esperance de l'image est
+ * celle d'un tirage uniforme.
+ *
+ * Les echantillons sont groupes par paquets de BUDDHA_PAQUET, dont les
+ * tirages ne dependent que du numero : l'image ne depend pas de la
+ * repartition des paquets (aux arrondis des sommes pres).
+ */
+
+#ifndef _mandel_buddha_h
+#define _mandel_buddha_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "mandel_noyau.h"
+
+#define BUDDHA_TUILE 32
+#define BUDDHA_PAQUET 4096
+
+#ifndef BUDDHA_MELANGE
+#define BUDDHA_MELANGE 0.5
+#endif
+
+/* Densite affichee en blanc (fraction des pixels plus sombres) */
+#ifndef BUDDHA_CENTILE
+#define BUDDHA_CENTILE 0.999
+#endif
+
+/* Cout d'un echantillon hors iterations (tirage, appel au noyau), en iterations */
+#ifndef BUDDHA_SURCOUT
+#define BUDDHA_SURCOUT 20
+#endif
+
+/* Image de densite et disposition de ses histogrammes */
+typedef struct {
+  int w, h;
+  double xmin, ymin, xinc, yinc;
+  int ntx, nty;        /* tuiles par ligne, par colonne */
+  long taille;         /* flottants par histogramme (tuiles completes) */
+} buddha_image;
+
+/* Loi de tirage des points c : cases d'une grille n x n de [-2,2]^2 */
+typedef struct {
+  int n;
+  double *cumul;       /* probabilites cumulees des n*n cases */
+  float *poids;        /* (1/n^2) / p_k : poids d'un echantillon de la case k */
+} buddha_loi;
+
+static inline void buddha_image_init(buddha_image *im, int w, int h, double xmin,
+                                     double ymin, double xmax, double ymax) {
+  im->w = w;
+  im->h = h;
+  im->xmin = xmin;
+  im->ymin = ymin;
+  im->xinc = (xmax - xmin) / (w - 1);
+  im->yinc = (ymax - ymin) / (h - 1);
+  im->ntx = (w + BUDDHA_TUILE - 1) / BUDDHA_TUILE;
+  im->nty = (h + BUDDHA_TUILE - 1) / BUDDHA_TUILE;
+  im->taille = (long)im->ntx * im->nty * BUDDHA_TUILE * BUDDHA_TUILE;
+}
+
+/* Indice du pixel (i,j) dans un histogramme range par tuiles */
+static inline long buddha_indice(const buddha_image *im, int i, int j) {
+  return ((long)(i / BUDDHA_TUILE) * im->ntx + j / BUDDHA_TUILE)
+           * (BUDDHA_TUILE * BUDDHA_TUILE)
+         + (i % BUDDHA_TUILE) * BUDDHA_TUILE + j % BUDDHA_TUILE;
+}
+
+/* Tirage dans [0,1) ne dependant que de k (splitmix64) */
+static inline double buddha_alea(unsigned long long k) {
+  unsigned long long x = k * 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return (x >> 11) * (1. / 9007199254740992.);
+}
+
+/* Nombre de points de l'orbite de c, qui diverge, qui tombent dans l'image */
+static inline int buddha_points_image(const buddha_image *im, double a, double b, int prof) {
+  double x = 0., y = 0., temp, u, v;
+  int n = 0, m = 0;
+  do {
+    temp = x;
+    x = x*x - y*y + a;
+    y = 2*temp*y + b;
+    u = (x - im->xmin) / im->xinc + 0.5;
+    v = (y - im->ymin) / im->yinc + 0.5;
+    m += u >= 0. && u < im->w && v >= 0. && v < im->h;
+  } while (x*x + y*y < 4. && ++n < prof);
+  return m;
+}
+
+/**
+ * Loi de tirage sur une grille n x n : uniforme si n = 1, sinon
+ * d'apres la pre-passe en temps d'evasion (prof iterations) pour
+ * l'image im.
+ * @return 0, -1 si l'allocation echoue
+ */
+static inline int buddha_loi_init(buddha_loi *loi, int n, int prof,
+                                  const buddha_image *im) {
+  int *iter, k, nc = n*n;
+  double *p, somme = 0., cumul = 0.;
+
+  loi->n = n;
+  loi->cumul = (double *)malloc(nc*sizeof(double));
+  loi->poids = (float *)malloc(nc*sizeof(float));
+  iter = (int *)malloc(4L*nc*sizeof(int));
+  p = (double *)malloc(nc*sizeof(double));
+  if (loi->cumul == NULL || loi->poids == NULL || iter == NULL || p == NULL) {
+    free(iter);
+    free(p);
+    return -1;
+  }
+
+  if (n == 1) {
+    p[0] = 1.;
+  } else {
+    /* temps d'evasion de 2 x 2 sondes par case (grille 2n x 2n) */
+    int i;
+#pragma omp parallel for schedule(dynamic)
+    for (i = 0; i < 2*n; i++)
+      xy2iter_ligne(-2. + 1./n, 2./n, -2. + (2*i + 1)*1./n, 2*n, prof,
+                    iter + (long)i*2*n);
+
+    /* p_k ~ racine de E[f] / E[cout], f : points de l'orbite dans l'image */
+#pragma omp parallel for schedule(dynamic) reduction(+:somme)
+    for (i = 0; i < n; i++) {
+      int j, s, it;
+      double f, cout;
+      for (j = 0; j < n; j++) {
+        f = cout = 0.;
+        for (s = 0; s < 4; s++) {
+          it = iter[(long)(2*i + s/2)*2*n + 2*j + s%2];
+          cout += it + BUDDHA_SURCOUT;
+          if (it >= prof) continue;
+          f += buddha_points_image(im, -2. + (4*j + 2*(s%2) + 1)*1./n,
+                                   -2. + (4*i + 2*(s/2) + 1)*1./n, prof);
+        }
+        p[i*n + j] = sqrt(f / cout);
+        somme += p[i*n + j];
+      }
+    }
+    for (k = 0; k < nc; k++)
+      p[k] = somme > 0. ? (1. - BUDDHA_MELANGE) * p[k] / somme + BUDDHA_MELANGE / nc
+                        : 1. / nc;
+  }
+
+  for (k = 0; k < nc; k++) {
+    cumul += p[k];
+    loi->cumul[k] = cumul;
+    loi->poids[k] = (float)(1. / (nc * p[k]));
+  }
+  loi->cumul[nc - 1] = 1.;
+  free(iter);
+  free(p);
+  return 0;
+}
+
+static inline void buddha_loi_liberer(buddha_loi *loi) {
+  free(loi->cumul);
+  free(loi->poids);
+}
+
+/* Case de la loi de probabilite cumulee au moins u */
+static inline int buddha_case(const buddha_loi *loi, double u) {
+  int a = 0, b = loi->n * loi->n - 1, m;
+  while (a < b) {
+    m = (a + b) / 2;
+    if (loi->cumul[m] < u) a = m + 1;
+    else b = m;
+  }
+  return a;
+}
+
+/**
+ * Trace les orbites des echantillons du paquet q (ceux qui divergent
+ * avant prof iterations) dans l'histogramme hist, range par tuiles.
+ * @return nombre d'orbites tracees
+ */
+static inline long buddha_paquet(const buddha_image *im, const buddha_loi *loi,
+                                 unsigned long long q, int prof, float *hist) {
+  double pa[NOYAU_BLOC], pb[NOYAU_BLOC], u, v, x, y, temp, x2, y2;
+  float pp[NOYAU_BLOC];
+  int it[NOYAU_BLOC], e, m, k, c, n;
+  unsigned long long graine = q * BUDDHA_PAQUET * 3;
+  double taille = 4. / loi->n;
+  long tracees = 0;
+
+  for (e = 0; e < BUDDHA_PAQUET; e += m) {
+    m = BUDDHA_PAQUET - e < NOYAU_BLOC ? BUDDHA_PAQUET - e : NOYAU_BLOC;
+    /* tirage de la case, puis du point dans la case */
+    for (k = 0; k < m; k++, graine += 3) {
+      c = buddha_case(loi, buddha_alea(graine));
+      pa[k] = -2. + (c % loi->n + buddha_alea(graine + 1)) * taille;
+      pb[k] = -2. + (c / loi->n + buddha_alea(graine + 2)) * taille;
+      pp[k] = loi->poids[c];
+    }
+    xy2iter_points(pa, pb, m, prof, it);
+
+    /* orbites qui divergent, refaites en comptant les points de l'image */
+    for (k = 0; k < m; k++) {
+      if (it[k] >= prof) continue;
+      tracees++;
+      x = y = 0.;
+      n = 0;
+      do {
+        temp = x;
+        x2 = x*x;
+        y2 = y*y;
+        x = x2 - y2 + pa[k];
+        y = 2*temp*y + pb[k];
+        u = (x - im->xmin) / im->xinc + 0.5;
+        v = (y - im->ymin) / im->yinc + 0.5;
+        if (u >= 0. && u < im->w && v >= 0. && v < im->h)
+          hist[buddha_indice(im, (int)v, (int)u)] += pp[k];
+      } while (x*x + y*y < 4. && ++n < prof);
+    }
+  }
+  return tracees;
+}
+
+/**
+ * Somme les nh histogrammes hist[] (ranges par tuiles) dans densite,
+ * image w x h rangee ligne par ligne, en parallele sur les tuiles.
+ */
+static inline void buddha_fusionner(const buddha_image *im, float **hist, int nh,
+                                    float *densite) {
+  int t;
+#pragma omp parallel for schedule(dynamic)
+  for (t = 0; t < im->ntx * im->nty; t++) {
+    int i0 = t / im->ntx * BUDDHA_TUILE, j0 = t % im->ntx * BUDDHA_TUILE;
+    int i, j, r;
+    long k0 = (long)t * BUDDHA_TUILE * BUDDHA_TUILE, k;
+    for (i = i0; i < i0 + BUDDHA_TUILE && i < im->h; i++)
+      for (j = j0; j < j0 + BUDDHA_TUILE && j < im->w; j++) {
+        float s = 0.f;
+        k = k0 + (i - i0) * BUDDHA_TUILE + j - j0;
+        for (r = 0; r < nh; r++) s += hist[r][k];
+        densite[(long)i*im->w + j] = s;
+      }
+  }
+}
+
+/* k-ieme plus petite valeur de t[0..n-1] (t est permute) */
+static inline float buddha_selection(float *t, long n, long k) {
+  long a = 0, b = n - 1, i, j;
+  float pivot, x;
+  while (a < b) {
+    pivot = t[(a + b) / 2];
+    for (i = a, j = b; i <= j; ) {
+      while (t[i] < pivot) i++;
+      while (t[j] > pivot) j--;
+      if (i <= j) { x = t[i]; t[i++] = t[j]; t[j--] = x; }
+    }
+    if (k <= j) b = j;
+    else if (k >= i) a = i;
+    else break;
+  }
+  return t[k];
+}
+
+/**
+ * Niveaux de gris 0..255 de la densite (npix pixels) : racine de la
+ * densite rapportee a son centile BUDDHA_CENTILE, plus stable que le
+ * maximum (quelques pixels isoles).
+ */
+static inline void buddha_niveaux(const float *densite, long npix, unsigned char *ima) {
+  float *t = (float *)malloc(npix*sizeof(float)), ref = 0.f;
+  long k;
+  if (t != NULL) {
+    memcpy(t, densite, npix*sizeof(float));
+    ref = buddha_selection(t, npix, (long)(BUDDHA_CENTILE * (npix - 1)));
+    free(t);
+  }
+#pragma omp parallel for
+  for (k = 0; k < npix; k++)
+    ima[k] = ref <= 0.f ? 0 : densite[k] >= ref ? 255
+           : (unsigned char)(255. * sqrt(densite[k] / ref) + 0.5);
+}
+
+#endif /*!_mandel_buddha_h*/
@@ -0,0 +1,175 @@
+/*
+ * Taille des blocs distribues par le maitre (option -decoupage mode) :
+ *
+ *  - fixe       : nlin lignes (comportement historique)
+ *  - guide      : R / P lignes, R lignes restant a distribuer, P processus
+ *                 qui calculent (guided self-scheduling)
+ *  - factoring  : par lots de P blocs egaux ; chaque lot prend la moitie
+ *                 des lignes restantes, soit R / (2P) lignes par bloc
+ *  - adaptatif  : factoring dont la part du lot, 1/x, est tiree des temps
+ *                 mesures : x = 1 + b^2 + b.sqrt(b^2 + 2), avec
+ *                 b = P.sigma / (2.mu.sqrt(R)), mu et sigma moyenne et
+ *                 ecart type du temps d'une ligne (Hummel et al.). Plus
+ *                 les lignes sont inegales, plus les blocs sont petits.
+ *
+ * Hors mode fixe, nlin est la taille minimale d'un bloc. Les blocs ne
+ * contiennent que des lignes calculees (symetrie : les lignes miroir sont
+ * sautees) et les lignes consecutives d'une meme suite. La derniere ligne
+ * de l'image est toujours distribuee, meme si h n'est pas multiple de nlin.
+ *
+ * Les tailles choisies sont gardees pour l'affichage (decoupage_afficher).
+ * Les temps sont des temps processeur du processus, tous ses threads
+ * compris : un processus interrompu par un autre sur le meme coeur ne
+ * fausse pas sigma.
+ */
+
+#ifndef _mandel_decoupage_h
+#define _mandel_decoupage_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "mandel_symetrie.h"
+
+#define DECOUPAGE_FIXE       0
+#define DECOUPAGE_GUIDE      1
+#define DECOUPAGE_FACTORING  2
+#define DECOUPAGE_ADAPTATIF  3
+
+static const char *decoupage_noms[] = { "fixe", "guide", "factoring", "adaptatif" };
+
+typedef struct {
+  int mode, nlin, P, h, axe;
+  /* Prochaine ligne, fin de sa suite, lignes calculees restantes */
+  int suivante, fin_suite, restantes;
+  /* Lot en cours (factoring) : taille de ses blocs, blocs restants, x */
+  int lot, dans_lot;
+  double x;
+  /* Temps mesures : sommes de n, de t et de t^2/n, nombre de blocs */
+  double somme_n, somme_t, somme_t2n;
+  int mesures;
+  /* Tailles choisies */
+  int *tailles, nblocs;
+} decoupage;
+
+/* Mode depuis son nom, -1 si inconnu */
+static inline int decoupage_depuis_nom(const char *nom) {
+  int m;
+  for (m = 0; m < 4; m++)
+    if (strcmp(nom, decoupage_noms[m]) == 0) return m;
+  return -1;
+}
+
+/**
+ * Prepare la distribution des h lignes (axe de symetrie, -1 sans) entre
+ * P processus, par blocs de nlin lignes (au moins nlin hors mode fixe).
+ * @return 0, -1 si l'allocation echoue
+ */
+static inline int decoupage_init(decoupage *d, int mode, int nlin, int P, int h, int axe) {
+  memset(d, 0, sizeof(*d));
+  d->mode = mode;
+  d->nlin = nlin > 0 ? nlin : 1;
+  d->P = P > 0 ? P : 1;
+  d->h = h;
+  d->axe = axe;
+  d->restantes = h - symetrie_recopiees(axe, h);
+  d->x = 2.;
+  d->tailles = (int *)malloc((h + 1) * sizeof(int));
+  return d->tailles == NULL ? -1 : 0;
+}
+
+/* Temps t (secondes) du calcul d'un bloc de n lignes */
+static inline void decoupage_mesure(decoupage *d, int n, double t) {
+  if (n <= 0 || t <= 0.) return;
+  d->somme_n += n;
+  d->somme_t += t;
+  d->somme_t2n += t * t / n;
+  d->mesures++;
+}
+
+/*
+ * Part x du lot suivant (adaptatif) : mu = somme_t / somme_n ; le temps
+ * moyen d'un bloc de n lignes a la variance sigma^2 / n, donc sigma^2 est
+ * estime par la moyenne des n.(t/n - mu)^2.
+ */
+static inline double decoupage_x(const decoupage *d) {
+  double mu, s2, b;
+  if (d->mode != DECOUPAGE_ADAPTATIF || d->mesures < 2 || d->somme_t <= 0.)
+    return 2.;
+  mu = d->somme_t / d->somme_n;
+  s2 = (d->somme_t2n - mu * d->somme_t) / d->mesures;
+  if (s2 < 0.) s2 = 0.;
+  b = d->P * sqrt(s2) / (2. * mu * sqrt((double)d->restantes));
+  return 1. + b*b + b * sqrt(b*b + 2.);
+}
+
+/**
+ * Bloc suivant : lignes i0..i0 + *n - 1.
+ * @return i0, -1 s'il ne reste plus de ligne a calculer
+ */
+static inline int decoupage_suivant(decoupage *d, int *n) {
+  int i0, m, R = d->restantes;
+
+  while (d->suivante < d->h && !symetrie_calculee(d->suivante, d->axe)) d->suivante++;
+  if (d->suivante >= d->h) return -1;
+  i0 = d->suivante;
+  if (i0 >= d->fin_suite) d->fin_suite = symetrie_suite(i0, d->axe, d->h);
+
+  switch (d->mode) {
+  case DECOUPAGE_GUIDE:
+    m = (R + d->P - 1) / d->P;
+    break;
+  case DECOUPAGE_FACTORING:
+  case DECOUPAGE_ADAPTATIF:
+    if (d->dans_lot == 0) {
+      d->x = decoupage_x(d);
+      d->lot = (int)ceil(R / (d->x * d->P));
+      d->dans_lot = d->P;
+    }
+    d->dans_lot--;
+    m = d->lot;
+    break;
+  default:
+    m = d->nlin;
+  }
+  if (m < d->nlin) m = d->nlin;
+  if (m > d->fin_suite - i0) m = d->fin_suite - i0;
+
+  d->suivante += m;
+  d->restantes -= m;
+  d->tailles[d->nblocs++] = m;
+  *n = m;
+  return i0;
+}
+
+/*
+ * Nombre de blocs et leurs tailles, dans l'ordre ("taille x repetitions"),
+ * en une seule ecriture (les autres processus ecrivent aussi sur stderr)
+ */
+static inline void decoupage_afficher(const decoupage *d) {
+  int k, r;
+  size_t taille = 64 + 24 * (size_t)d->nblocs, l;
+  char *ligne = (char *)malloc(taille);
+  if (ligne == NULL) return;
+  l = snprintf(ligne, taille, "Decoupage %s: %d blocs, tailles",
+               decoupage_noms[d->mode], d->nblocs);
+  for (k = 0; k < d->nblocs; k += r) {
+    for (r = 1; k + r < d->nblocs && d->tailles[k + r] == d->tailles[k]; r++);
+    if (r > 1) l += snprintf(ligne + l, taille - l, " %dx%d", d->tailles[k], r);
+    else l += snprintf(ligne + l, taille - l, " %d", d->tailles[k]);
+  }
+  fprintf(stderr, "%s\n", ligne);
+  free(ligne);
+  if (d->mode == DECOUPAGE_ADAPTATIF && d->mesures >= 2)
+    fprintf(stderr, "Decoupage adaptatif: %.3g ms par ligne, dernier x = %.2f\n",
+            1e3 * d->somme_t / d->somme_n, d->x);
+}
+
+static inline void decoupage_liberer(decoupage *d) {
+  free(d->tailles);
+  d->tailles = NULL;
+}
+
+#endif /*!_mandel_decoupage_h*/
@@ -7,6 +7,9 @@ Modifié par Hugo Baltz
 #define MAITRE 0 // Définition rank = 0 => master
 #define TAG_IM 42
 #define TAG_NUM_BLOC 24
+#define TAG_ITER 43
+#define TAG_LISSAGE 44
+#define TAG_RGB 45
 
 #ifndef M_PI
     #define M_PI 3.14159265358979323846
@@ -17,21 +20,75 @@ Modifié par Hugo Baltz
 #include <time.h>	/* chronometrage */
 #include <string.h>     /* pour memset */
 #include <math.h>
+#include <limits.h>
 #include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include <sys/time.h>
 
 #include "rasterfile.h"
+#include "mandel_noyau.h"
+#include "mandel_options.h"
+#include "mandel_mariani.h"
+#include "mandel_iter.h"
+#include "mandel_progressif.h"
+#include "mandel_lissage.h"
+#include "mandel_symetrie.h"
+#include "mandel_formule.h"
+#include "mandel_decoupage.h"
+#include "mandel_desequilibre.h"
+#include "mandel_mpiio.h"
 
 
 
 char info[] = "\
 Usage:\n\
-      mandel dimx dimy xmin ymin xmax ymax prof nlin\n\
+      mandel dimx dimy xmin ymin xmax ymax prof nlin [options]\n\
 \n\
       dimx,dimy : dimensions de l'image a generer\n\
       xmin,ymin,xmax,ymax : domaine a calculer dans le plan complexe\n\
       prof : nombre maximale d'iteration\n\
-      nlin : nombre de lignes par bloc \n\
+      nlin : nombre de lignes par bloc (minimum hors -decoupage fixe)\n\
+\n\
+Options\n\
+      -nocardio : pas de test de la cardioide et du disque de periode 2\n\
+      -periode : detection de periodicite des orbites (methode de Brent)\n\
+      -eps_periode eps : tolerance de la detection de periodicite\n\
+      -mariani : subdivision recursive de Mariani-Silver\n\
+      -taille_min n : cote en dessous duquel Mariani-Silver calcule tout\n\
+      -precision p : float, double, dd (double-double) ou auto (defaut)\n\
+      -iter fichier : sauve aussi les nombres d'iterations (voir recolorier)\n\
+      -progressif pas : passes de plus en plus fines (premiere : un pixel\n\
+                        sur pas), mandel.ras est sauve apres chacune\n\
+      -lissage n : anticrenelage, n x n echantillons (n <= 16) sur les\n\
+                   pixels de bord, image en 24 bits\n\
+      -seuil_lissage s : ecart d'iterations d'un pixel de bord (defaut 4)\n\
+      -degre d : formule z^d + c, 2 <= d <= 8 (defaut 2)\n\
+      -julia a,b : ensemble de Julia de z^d + k, k = a + i.b\n\
+      -formule \"expr\" : iteration z -> expr (z, c, i, + - * / ^n, conj),\n\
+                        compilee a l'execution (ex. \"z^3 + c*z + 0.2\")\n\
+      -nosymetrie : calcule aussi les lignes miroir par rapport a l'axe reel\n\
+      -avance n : unites de travail en attente chez chaque ouvrier (defaut 2)\n\
+      -decoupage mode : taille des blocs, fixe (nlin, defaut), guide\n\
+                        (restant / P), factoring (lots de P blocs, moitie\n\
+                        du restant) ou adaptatif (factoring regle sur les\n\
+                        temps mesures)\n\
+      -rma : sans maitre, chaque processus prend le bloc suivant par\n\
+             MPI_Fetch_and_op sur un compteur et ecrit ses lignes dans\n\
+             l'image du rang 0 par MPI_Put (sans -progressif ni -lissage)\n\
+      -hierarchique : deux niveaux, un chef par noeud (memoire partagee)\n\
+             prend des morceaux de la table au rang 0 ; les rangs du\n\
+             noeud s'en partagent les blocs de nlin lignes en memoire\n\
+             partagee, et le chef envoie le morceau fini en une ecriture\n\
+      -coeurs_noeud n : avec -hierarchique, noeuds d'au plus n rangs\n\
+             (essai de plusieurs noeuds sur une seule machine)\n\
+      -threads n : threads OpenMP par processus (compile avec -fopenmp ;\n\
+                   defaut OMP_NUM_THREADS), independant de mpirun -np\n\
+      -mpiio : chaque processus garde ses lignes et les ecrit dans\n\
+               mandel.ras (et le fichier -iter) par MPI-IO, sans tout\n\
+               rassembler au maitre (sans -progressif, -lissage ni\n\
+               -hierarchique)\n\
 \n\
 Quelques exemples d'execution\n\
       mandel 800 800 0.35 0.355 0.353 0.358 200 8\n\
@@ -49,6 +106,13 @@ double my_gettimeofday(){
   return tmp_time.tv_sec + (tmp_time.tv_usec * 1.0e-6L);
 }
 
+/* Temps processeur du processus, tous threads compris, en secondes */
+static double temps_processus(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+  return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
 
 
 
@@ -183,39 +247,213 @@ void sauver_rasterfile( char *nom, int largeur, int hauteur, unsigned char *p) {
   fclose( fd);
 }
 
+
 /**
- * Étant donnée les coordonnées d'un point \f$c=a+ib\f$ dans le plan
- * complexe, la fonction retourne la couleur correspondante estimant
- * à quelle distance de l'ensemble de mandelbrot le point est.
- * Soit la suite complexe défini par:
- * \f[
- * \left\{\begin{array}{l}
- * z_0 = 0 \\
- * z_{n+1} = z_n^2 - c
- * \end{array}\right.
- * \f]
- * le nombre d'itérations que la suite met pour diverger est le
- * nombre \f$ n \f$ pour lequel \f$ |z_n| > 2 \f$.
- * Ce nombre est ramené à une valeur entre 0 et 255 correspond ainsi a
- * une couleur dans la palette des couleurs.
+ * Entete de mandel.ras (ENTETE_RASTERFILE octets) : l'entete et la palette
+ * que sauver_rasterfile ecrit avant les pixels.
+ * Au dela de 2 Go, la taille de l'image ne tient pas dans ras_length,
+ * qui vaut alors 0 : le lecteur la deduit de la largeur et de la hauteur
+ * (voir rasterfile.h).
  */
+#define ENTETE_RASTERFILE ((int)sizeof(struct rasterfile) + 3*256)
 
-unsigned char xy2color(double a, double b, int prof) {
-  double x, y, temp, x2, y2;
+void entete_rasterfile( unsigned char *e, int largeur, int hauteur) {
+  struct rasterfile file;
+  long taille = (long)largeur*hauteur;
   int i;
 
-  x = y = 0.;
-  for( i=0; i<prof; i++) {
-    /* garder la valeur précédente de x qui va etre ecrase */
-    temp = x;
-    /* nouvelles valeurs de x et y */
-    x2 = x*x;
-    y2 = y*y;
-    x = x2 - y2 + a;
-    y = 2*temp*y + b;
-    if( x2 + y2 >= 4.0) break;
+  file.ras_magic  = swap(RAS_MAGIC);
+  file.ras_width  = swap(largeur);
+  file.ras_height = swap(hauteur);
+  file.ras_depth  = swap(8);
+  file.ras_length = swap(taille > INT_MAX ? 0 : (int)taille);
+  file.ras_type    = swap(RT_STANDARD);
+  file.ras_maptype = swap(RMT_EQUAL_RGB);
+  file.ras_maplength = swap(256*3);
+  memcpy( e, &file, sizeof(struct rasterfile));
+
+  /* Palette de couleurs : rouge, vert puis bleu, de 255 a 0 */
+  e += sizeof(struct rasterfile);
+  for( i = 0; i < 256; i++) {
+    e[i]       = COMPOSANTE_ROUGE(255 - i);
+    e[256 + i] = COMPOSANTE_VERT(255 - i);
+    e[512 + i] = COMPOSANTE_BLEU(255 - i);
+  }
+}
+
+/**
+ * Sauvegarde MPI-IO (option -mpiio), collective : chaque processus ecrit
+ * ses n lignes ima_loc (et iter_loc si fichier_iter), de numeros
+ * lignes[], dans mandel.ras (et le fichier d'iterations, entete ie)
+ */
+void sauver_mpiio( int w, int h, int axe, unsigned char *ima_loc, int *iter_loc,
+                   int *lignes, int n, char *fichier_iter, iter_entete *ie) {
+  unsigned char e[ENTETE_RASTERFILE];
+  double debut = my_gettimeofday();
+  int rank;
+
+  MPI_Comm_rank( MPI_COMM_WORLD, &rank);
+  entete_rasterfile( e, w, h);
+  mpiio_ecrire( MPI_COMM_WORLD, "mandel.ras", e, ENTETE_RASTERFILE, ima_loc, w, lignes, n, axe, h);
+  if( fichier_iter) mpiio_ecrire_iter( MPI_COMM_WORLD, fichier_iter, ie, iter_loc, lignes, n, axe);
+  if( rank == MAITRE) fprintf( stderr, "MPI-IO: ecriture en %g sec\n", my_gettimeofday() - debut);
+}
+
+/* Palette de l'image : couleur k -> rouge, vert, bleu (voir ci-dessus) */
+void palette_rgb( lissage_palette pal) {
+  int k;
+  for (k = 0; k < 256; k++) {
+    pal[k][0] = COMPOSANTE_ROUGE(255 - k);
+    pal[k][1] = COMPOSANTE_VERT(255 - k);
+    pal[k][2] = COMPOSANTE_BLEU(255 - k);
+  }
+}
+
+/**
+ *  Sauvegarde une image RGB (3 octets par pixel) au format rasterfile
+ *  24 bits : octets dans l'ordre bleu, vert, rouge, lignes completees a
+ *  un nombre pair d'octets
+ *    @param nom Nom de l'image
+ *    @param largeur largeur de l'image
+ *    @param hauteur hauteur de l'image
+ *    @param p pointeur vers tampon contenant l'image
+ */
+void sauver_rasterfile_rgb( char *nom, int largeur, int hauteur, unsigned char *p) {
+  FILE *fd;
+  struct rasterfile file;
+  int i, j, ligne = (3*largeur + 1) & ~1;
+  unsigned char *tampon;
+
+  if ( (fd=fopen(nom, "w")) == NULL || (tampon = calloc( ligne, 1)) == NULL) {
+    printf("erreur dans la creation du fichier %s \n",nom);
+    exit(1);
+  }
+
+  file.ras_magic  = swap(RAS_MAGIC);
+  file.ras_width  = swap(largeur);
+  file.ras_height = swap(hauteur);
+  file.ras_depth  = swap(24);
+  file.ras_length = swap(ligne*hauteur);
+  file.ras_type    = swap(RT_STANDARD);
+  file.ras_maptype = swap(RMT_NONE);
+  file.ras_maplength = swap(0);
+
+  fwrite(&file, sizeof(struct rasterfile), 1, fd);
+
+  for (i = 0; i < hauteur; i++) {
+    for (j = 0; j < largeur; j++) {
+      tampon[3*j]     = p[3*((long)i*largeur + j) + 2];
+      tampon[3*j + 1] = p[3*((long)i*largeur + j) + 1];
+      tampon[3*j + 2] = p[3*((long)i*largeur + j)];
+    }
+    fwrite( tampon, ligne, sizeof(unsigned char), fd);
+  }
+  free( tampon);
+  fclose( fd);
+}
+
+/* En-tete d'un resultat : unite (num_bloc, n) et temps de son calcul */
+typedef struct {
+  double temps;
+  int num, n;
+} entete;
+
+/* Parametres du calcul d'un bloc, communs au maitre et aux ouvriers */
+typedef struct {
+  grille g;
+  int w, h, prof, nlin, nBloc, pas, axe, mode_mariani;
+  mariani *ms;
+  double *abscisses;
+} travail;
+
+/**
+ * Calcule l'unite de travail (num_bloc, nlin).
+ * Rendu progressif : les pixels de la passe num_bloc / nBloc sont tasses
+ * dans vals (iter_bloc sert de brouillon de nlin lignes).
+ * Sinon : les nlin lignes a partir de la ligne num_bloc dans ima_bloc (et
+ * iter_bloc si non NULL), sauf les lignes miroir, recopiees par le maitre.
+ * L'ordonnee de la ligne i est ymin + i*yinc : l'image ne depend pas du
+ * decoupage. Compile avec -fopenmp, les lignes du bloc (les taches de
+ * Mariani-Silver) sont reparties entre les threads du processus.
+ * @return nombre de valeurs rangees dans vals (0 hors rendu progressif)
+ */
+static int calculer_bloc(travail *t, int num_bloc, int nlin, unsigned char *ima_bloc,
+                         int *iter_bloc, int *vals) {
+  int i, i0, i1, a, b, s, n = 0, w = t->w;
+  double y;
+
+  if( t->pas > 1) {
+    /* Pixels de la passe num_bloc / nBloc dans le bloc num_bloc % nBloc
+       (le dernier bloc peut etre incomplet) */
+    s = t->pas >> (num_bloc / t->nBloc);
+    i0 = (num_bloc % t->nBloc)*nlin;
+    i1 = i0 + nlin < t->h ? i0 + nlin : t->h;
+    /* lignes en parallele, puis tassees dans l'ordre */
+#pragma omp parallel for schedule(dynamic)
+    for (i = i0; i < i1; i++)
+      if( i % s == 0)
+        progressif_ligne( &t->g, t->abscisses, i, t->g.ymin + i*t->g.yinc, w, t->prof,
+                          s, t->pas, iter_bloc + (long)(i - i0)*w);
+    for (i = i0; i < i1; i++)
+      if( i % s == 0)
+        n += progressif_tasser( iter_bloc + (long)(i - i0)*w, i, w, s, t->pas, vals + n);
+    return n;
+  }
+
+  i0 = num_bloc;
+  if( t->mode_mariani) {
+    /* Subdivision de Mariani-Silver a l'interieur du bloc, par suites de lignes calculees ;
+       les sous-rectangles sont des taches */
+#pragma omp parallel
+#pragma omp single
+    for (a = 0; a < nlin; a = b) {
+      b = symetrie_suite( i0 + a, t->axe, i0 + nlin) - i0;
+      if( !symetrie_calculee( i0 + a, t->axe)) continue;
+      t->ms->ima = ima_bloc + (long)a*w;
+      t->ms->iter = iter_bloc ? iter_bloc + (long)a*w : NULL;
+      t->ms->i0 = i0 + a;
+      /* toutes les taches finies avant de changer ms */
+#pragma omp taskgroup
+      mariani_silver( t->ms, b - a);
+    }
+  } else {
+#pragma omp parallel for private(y) schedule(dynamic)
+    for (i = 0; i < nlin; i++) {
+      y = t->g.ymin + (i0 + i)*t->g.yinc;
+      if( !symetrie_calculee( i0 + i, t->axe)) {
+        /* ligne miroir, recopiee par le maitre */
+      } else if( iter_bloc) {
+        xy2iter_grille( &t->g, i0 + i, y, 0, w, t->prof, iter_bloc + (long)i*w);
+        iter2color( iter_bloc + (long)i*w, w, t->prof, ima_bloc + (long)i*w);
+      } else {
+        xy2color_grille( &t->g, i0 + i, y, 0, w, t->prof, ima_bloc + (long)i*w);
+      }
+    }
+  }
+  return 0;
+}
+
+/* Place des n lignes i0..i0+n-1 parmi les lignes gardees (-mpiio) */
+static long garder(mpiio_tampon *mt, int i0, int n) {
+  long k = mpiio_reserver( mt, i0, n);
+  if( k < 0) {
+    fprintf( stderr, "Erreur allocation mémoire du tableau \n");
+    MPI_Abort( MPI_COMM_WORLD, 1);
+  }
+  return k;
+}
+
+/*
+ * Prochaine unite a distribuer, -1 si plus aucune : en rendu progressif,
+ * le bloc suivant de nlin lignes ; sinon le bloc choisi par le decoupage
+ * (premiere ligne, *n lignes).
+ */
+static int unite_suivante(travail *t, decoupage *d, int *num_bloc, int nUnites, int *n) {
+  if( t->pas > 1) {
+    *n = t->nlin;
+    return *num_bloc < nUnites ? (*num_bloc)++ : -1;
   }
-  return (i==prof)?255:(int)((i%255));
+  return decoupage_suivant( d, n);
 }
 
 /*
@@ -233,20 +471,89 @@ int main(int argc, char *argv[]) {
   /* Profondeur d'iteration */
   int prof;
   /* Image resultat */
-  unsigned char	*ima, *pima, *ima_loc, *pima_loc;
+  unsigned char	*ima = NULL;
   /* Variables intermediaires */
-  int  i, j;
-  double x, y;
+  int  i;
   /* Chronometrage */
   double debut, fin;
+  /* Valeur d'option */
+  char *opt;
+  /* Subdivision de Mariani-Silver */
+  int mode_mariani = 0, taille_min = MARIANI_TAILLE_MIN;
+  mariani ms;
+  /* Grille et precision du calcul */
+  grille g;
+  int precision = PRECISION_AUTO;
+  /* Nombres d'iterations bruts (option -iter) */
+  char *fichier_iter;
+  int *iter = NULL, *iter_loc = NULL, iter_avec;
+  /* Rendu progressif (option -progressif) : pas de la premiere passe */
+  int pas = 1, s, npasses, passe, ecrites = 0, i0, *recu = NULL, *vals = NULL, *v = NULL, n;
+  double *abscisses = NULL;
+  /* Anticrenelage (option -lissage) : pixels de bord et image RGB */
+  int lissage = 0, seuil_lissage = LISSAGE_SEUIL, *bords = NULL;
+  long nbords = 0, k, *paquet = NULL;
+  unsigned char *rgb = NULL, *rgb_bords = NULL;
+  lissage_palette pal;
+  /* Symetrie par rapport a l'axe reel : la ligne axe - i est recopiee */
+  int symetrie = 1, axe;
   /* Nombre ligne par bloc */
   int nlin;
-  /* Calcul fini */
-  int finCalc = 0;
+  /* Unites envoyees d'avance a chaque ouvrier (option -avance) */
+  int avance = 2;
+  /* Tampons de resultat (en-tete, puis donnees) et requetes en cours */
+  unsigned char **res = NULL;
+  long taille_res;
+  MPI_Request *req = NULL;
+  int *en_cours = NULL, *arrete = NULL, src, flag, nBloc_maitre = 0, unite[2], nmax;
+  entete *e;
+  double t_bloc;
+  travail t;
+  /* Taille des blocs (option -decoupage) */
+  int mode_decoupage = DECOUPAGE_FIXE;
+  decoupage d;
+  /* File de travail sans maitre (option -rma) */
+  int rma = 0;
+  /* Deux niveaux, un chef par noeud (option -hierarchique) */
+  int hierarchique = 0, coeurs_noeud = 0;
+  /* Threads par processus (option -threads), niveau de threads MPI obtenu */
+  int threads = 0, niveau;
+  /* Options de formule valides (-degre, -julia, -formule) */
+  int formule_ok;
+  /* Ecriture parallele (option -mpiio) : lignes gardees, entete -iter */
+  int mpiio = 0;
+  mpiio_tampon mt;
+  iter_entete ie;
 
   /* debut du chronometrage */
   debut = my_gettimeofday();
 
+  /* Options facultatives */
+  if( option_presente(&argc, argv, "-nocardio")) noyau_cardioide = 0;
+  if( option_presente(&argc, argv, "-cardio")) noyau_cardioide = 1;
+  if( option_presente(&argc, argv, "-periode")) noyau_periode = 1;
+  if( (opt = option_valeur(&argc, argv, "-eps_periode"))) noyau_periode_eps = atof(opt);
+  if( option_presente(&argc, argv, "-mariani")) mode_mariani = 1;
+  if( (opt = option_valeur(&argc, argv, "-taille_min"))) taille_min = atoi(opt);
+  if( (opt = option_valeur(&argc, argv, "-precision"))) precision = precision_depuis_nom(opt);
+  formule_ok = formule_options(&argc, argv) == 0;
+  fichier_iter = option_valeur(&argc, argv, "-iter");
+  if( (opt = option_valeur(&argc, argv, "-progressif"))) pas = progressif_pas_initial(atoi(opt));
+  if( (opt = option_valeur(&argc, argv, "-lissage"))) lissage = atoi(opt);
+  if( (opt = option_valeur(&argc, argv, "-seuil_lissage"))) seuil_lissage = atoi(opt);
+  if( option_presente(&argc, argv, "-nosymetrie")) symetrie = 0;
+  if( (opt = option_valeur(&argc, argv, "-avance"))) avance = atoi(opt);
+  if( avance < 1) avance = 1;
+  if( option_presente(&argc, argv, "-rma")) rma = 1;
+  if( option_presente(&argc, argv, "-hierarchique")) hierarchique = 1;
+  if( (opt = option_valeur(&argc, argv, "-coeurs_noeud"))) coeurs_noeud = atoi(opt);
+  if( (opt = option_valeur(&argc, argv, "-threads"))) threads = atoi(opt);
+  if( option_presente(&argc, argv, "-mpiio")) mpiio = 1;
+  if( (opt = option_valeur(&argc, argv, "-decoupage")) && (mode_decoupage = decoupage_depuis_nom(opt)) < 0) {
+    fprintf( stderr, "-decoupage %s : fixe, guide, factoring ou adaptatif\n", opt);
+    mode_decoupage = DECOUPAGE_FIXE;
+  }
+
   if( argc == 1) fprintf( stderr, "%s\n", info);
 
   /* Valeurs par defaut de la fractale */
@@ -269,6 +576,9 @@ int main(int argc, char *argv[]) {
   /* Calcul des pas d'incrementation */
   xinc = (xmax - xmin) / (w-1);
   yinc = (ymax - ymin) / (h-1);
+  g = (grille){ xmin, xinc, ymin, yinc };
+  precision_choisir( precision, xmin, ymin, xmax, ymax, xinc, yinc, prof);
+  ie = iter_entete_creer( w, h, prof, xmin, ymin, xmax, ymax);
 
   /**
   *** Début parallelisation
@@ -276,74 +586,642 @@ int main(int argc, char *argv[]) {
   int rank; // rang du processeur
   int p; // nombre processeur
 
-  MPI_Init(&argc, &argv); /* starts MPI */
+  /* Seul le thread principal appelle MPI, hors des regions paralleles */
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &niveau); /* starts MPI */
   MPI_Comm_rank(MPI_COMM_WORLD, &rank); /* get current process id */
   MPI_Comm_size(MPI_COMM_WORLD, &p);
+  if( !formule_ok) {
+    /* option de formule invalide : rien n'est calcule */
+    if( rank == MAITRE) fprintf( stderr, "%s\n", info);
+    MPI_Finalize();
+    return 1;
+  }
+#ifdef _OPENMP
+  if( threads > 0) omp_set_num_threads( threads);
+  if( niveau < MPI_THREAD_FUNNELED) omp_set_num_threads( 1);
+  threads = omp_get_max_threads();
+#else
+  threads = 1;
+#endif
 
-  int nBloc = h / nlin; // Nombre de blocs
+  int nBloc = (h + nlin - 1) / nlin; // Nombre de blocs (progressif), le dernier incomplet
   int num_bloc = 0; // Numero bloc
   int num_bloc_rec = 0; // Numero bloc recu
   int nBloc_recu = 0; // nombre bloc recu
+  int nBloc_distribues = 0; // nombre bloc distribues (maitre compris)
 
-  int stop = -1;
+  int stop[2] = { -1, 0 };
+
+  /* Rendu progressif : une unite de travail est un bloc d'une passe */
+  if( pas > 1 && mode_mariani) {
+    if( rank == MAITRE) fprintf( stderr, "Progressif: impossible avec -mariani\n");
+    pas = 1;
+  }
+  npasses = progressif_passes(pas);
+  if( lissage > LISSAGE_MAX) lissage = LISSAGE_MAX;
+  if( lissage > 1 && noyau_precision == PRECISION_DD) {
+    if( rank == MAITRE) fprintf( stderr, "Lissage: impossible en double-double\n");
+    lissage = 0;
+  }
+  if( lissage < 2) lissage = 0;
+  if( pas > 1 && mode_decoupage != DECOUPAGE_FIXE) {
+    if( rank == MAITRE) fprintf( stderr, "Decoupage: blocs de nlin lignes en rendu progressif\n");
+    mode_decoupage = DECOUPAGE_FIXE;
+  }
+  if( hierarchique) rma = 0;
+  if( (rma || hierarchique) && (pas > 1 || lissage)) {
+    if( rank == MAITRE) fprintf( stderr, "%s: impossible avec -progressif ou -lissage, maitre et ouvriers\n",
+                                 rma ? "RMA" : "Hierarchique");
+    rma = hierarchique = 0;
+  }
+  if( mpiio && (pas > 1 || lissage || hierarchique)) {
+    if( rank == MAITRE) fprintf( stderr, "MPI-IO: impossible avec -progressif, -lissage ou -hierarchique\n");
+    mpiio = 0;
+  }
+  if( (rma || hierarchique) && mode_decoupage == DECOUPAGE_ADAPTATIF) {
+    /* la table des blocs est fixee d'avance, sans temps mesures */
+    if( rank == MAITRE) fprintf( stderr, "%s: decoupage factoring au lieu d'adaptatif\n",
+                                 rma ? "RMA" : "Hierarchique");
+    mode_decoupage = DECOUPAGE_FACTORING;
+  }
+  palette_rgb( pal);
+  int nUnites = npasses*nBloc; // Nombre d'unites de travail
+
+  /* Symetrie : les lignes recopiees ne sont pas distribuees */
+  axe = symetrie && formule_symetrique() && pas == 1 ? symetrie_axe( ymin, yinc, h) : -1;
+
+  /* Blocs des lignes calculees, P = p processus (le maitre calcule aussi) ;
+     le plus grand : nlin, ou la part d'un processus au depart */
+  if( decoupage_init( &d, mode_decoupage, nlin, p, h, axe) != 0) {
+    fprintf( stderr, "Erreur allocation mémoire du tableau \n");
+    return 0;
+  }
+  nmax = nlin;
+  if( mode_decoupage != DECOUPAGE_FIXE && (d.restantes + p - 1) / p > nmax) nmax = (d.restantes + p - 1) / p;
+
+  /* Mariani-Silver : seuls ima et i0 changent d'un bloc a l'autre */
+  ms = (mariani){ .ima = NULL, .w = w, .g = g,
+                  .prof = prof, .taille_min = taille_min, .taille_tache = 64*64, .iter = NULL };
+  t = (travail){ g, w, h, prof, nlin, nBloc, pas, axe, mode_mariani, &ms, NULL };
+
+  /* Resultat d'une unite de n lignes : en-tete, puis les valeurs de la passe
+     (progressif), ou les nombres d'iterations (si gardes) et les pixels */
+  iter_avec = fichier_iter || pas > 1 || lissage;
+#define DECALAGE_IMA(n) (sizeof(entete) + (iter_avec ? (long)w*(n)*sizeof(int) : 0))
+  mpiio_tampon_init( &mt, w, iter_avec);
+  taille_res = mpiio ? (long)sizeof(entete) : pas > 1 ? sizeof(entete) + (long)w*nlin*sizeof(int) : DECALAGE_IMA(nmax) + (long)w*nmax;
 
   MPI_Status status;
 
+  /* Affichage parametres pour verification */
   if(rank == MAITRE){
-
-    /* Affichage parametres pour verification */
     fprintf( stderr, "Rang: %d\n", rank);
     fprintf( stderr, "Domaine: {[%lg,%lg]x[%lg,%lg]}\n", xmin, ymin, xmax, ymax);
     fprintf( stderr, "Increment : %lg %lg\n", xinc, yinc);
     fprintf( stderr, "Prof: %d\n",  prof);
     fprintf( stderr, "Dim image: %dx%d\n", w, h);
     fprintf( stderr, "Nombre lignes par bloc: %d\n", nlin);
+    fprintf( stderr, "Processus: %d x %d threads%s\n", p, threads,
+             niveau < MPI_THREAD_FUNNELED ? " (MPI_THREAD_FUNNELED refuse)" : "");
+    fprintf( stderr, "Noyau: %s\n", noyau_nom());
+    precision_afficher();
+    formule_afficher();
+    fprintf( stderr, "Cardioide: %s\n", noyau_cardioide ? "oui" : "non");
+    if( noyau_periode) fprintf( stderr, "Periodicite: eps %lg\n", noyau_periode_eps);
+    if( mode_mariani) fprintf( stderr, "Mariani-Silver: taille min %d\n", taille_min);
+    if( rma) fprintf( stderr, "RMA: file de travail sans maitre\n");
+    else if( hierarchique) fprintf( stderr, "Hierarchique: un chef par noeud\n");
+    else fprintf( stderr, "Unites d'avance par ouvrier: %d\n", avance);
+    if( pas == 1) fprintf( stderr, "Decoupage: %s\n", decoupage_noms[mode_decoupage]);
+    if( pas > 1) fprintf( stderr, "Progressif: %d passes, pas initial %d\n", npasses, pas);
+    if( lissage) fprintf( stderr, "Lissage: %dx%d echantillons, seuil %d\n", lissage, lissage, seuil_lissage);
+    if( axe >= 0) fprintf( stderr, "Symetrie: %d lignes recopiees, non distribuees\n",
+                           symetrie_recopiees( axe, h));
+    if( mpiio) fprintf( stderr, "MPI-IO: chaque processus ecrit ses lignes\n");
+  }
+
+  if( rma) {
+    /* Sans maitre : la table des blocs est la meme sur tous les rangs ; le
+       compteur, dans une fenetre du rang 0, donne le prochain bloc libre.
+       Chaque rang ecrit ses lignes dans l'image du rang 0 (MPI_Rput), depuis
+       deux tampons : l'un part pendant que l'autre se remplit */
+    int *blocs = (int *)malloc( 2*((long)h + 1)*sizeof(int)), nblocs = 0, un = 1, k_bloc;
+    int *compteur, mes_lignes = 0, tour = 0, *lignes_rang = NULL, *bornes_rang = NULL;
+    unsigned char *ima_rma[2] = { NULL, NULL };
+    int *iter_rma[2] = { NULL, NULL };
+    double t_calcul, *mesure = NULL;
+    MPI_Win win_compteur, win_ima, win_iter = MPI_WIN_NULL;
+    MPI_Request envoi[4] = { MPI_REQUEST_NULL, MPI_REQUEST_NULL, MPI_REQUEST_NULL, MPI_REQUEST_NULL };
+
+    if( blocs == NULL) {
+      fprintf( stderr, "Erreur allocation mémoire du tableau \n");
+      return 0;
+    }
+    for( nmax = 0; (blocs[2*nblocs] = decoupage_suivant( &d, &blocs[2*nblocs + 1])) >= 0; nblocs++)
+      if( blocs[2*nblocs + 1] > nmax) nmax = blocs[2*nblocs + 1];
+    for( i = 0; i < 2 && !mpiio; i++) {
+      ima_rma[i] = (unsigned char *)malloc( (long)w*nmax + 1);
+      if( iter_avec) iter_rma[i] = (int *)malloc( ((long)w*nmax + 1)*sizeof(int));
+    }
+    if( !mpiio && (ima_rma[0] == NULL || ima_rma[1] == NULL
+                   || (iter_avec && (iter_rma[0] == NULL || iter_rma[1] == NULL)))) {
+      fprintf( stderr, "Erreur allocation mémoire du tableau \n");
+      return 0;
+    }
 
-    /* Allocation memoire du tableau resultat */
-    pima = ima = (unsigned char *)malloc( w*h*sizeof(unsigned char));
-    if( ima == NULL) {
+    /* L'image (et les nombres d'iterations) du rang 0 sont la memoire des
+       fenetres ; avec -mpiio, chaque rang garde ses lignes */
+    if( !mpiio) {
+      MPI_Win_allocate( rank == MAITRE ? (MPI_Aint)w*h : 0, 1, MPI_INFO_NULL,
+                        MPI_COMM_WORLD, &ima, &win_ima);
+      if( iter_avec)
+        MPI_Win_allocate( rank == MAITRE ? (MPI_Aint)w*h*sizeof(int) : 0, sizeof(int),
+                          MPI_INFO_NULL, MPI_COMM_WORLD, &iter, &win_iter);
+    }
+    MPI_Win_allocate( rank == MAITRE ? sizeof(int) : 0, sizeof(int), MPI_INFO_NULL,
+                      MPI_COMM_WORLD, &compteur, &win_compteur);
+    if( rank == MAITRE) {
+      MPI_Win_lock( MPI_LOCK_EXCLUSIVE, MAITRE, 0, win_compteur);
+      *compteur = 0;
+      MPI_Win_unlock( MAITRE, win_compteur);
+    }
+    MPI_Barrier( MPI_COMM_WORLD);
+
+    MPI_Win_lock_all( 0, win_compteur);
+    if( !mpiio) MPI_Win_lock_all( 0, win_ima);
+    if( !mpiio && iter_avec) MPI_Win_lock_all( 0, win_iter);
+    t_calcul = temps_processus();
+    for(;;){
+      // Prise du bloc suivant : un seul aller-retour atomique vers le rang 0
+      MPI_Fetch_and_op( &un, &k_bloc, MPI_INT, MAITRE, 0, MPI_SUM, win_compteur);
+      MPI_Win_flush( MAITRE, win_compteur);
+      if( k_bloc >= nblocs) break;
+      i0 = blocs[2*k_bloc];
+      n = blocs[2*k_bloc + 1];
+
+      if( mpiio) {
+        k = garder( &mt, i0, n);
+        calculer_bloc( &t, i0, n, mt.ima + k*w, mt.iter ? mt.iter + k*w : NULL, NULL);
+        nBloc_recu++;
+        mes_lignes += n;
+        continue;
+      }
+      MPI_Waitall( 2, envoi + 2*tour, MPI_STATUSES_IGNORE);
+      calculer_bloc( &t, i0, n, ima_rma[tour], iter_avec ? iter_rma[tour] : NULL, NULL);
+      MPI_Rput( ima_rma[tour], n*w, MPI_UNSIGNED_CHAR, MAITRE, (MPI_Aint)i0*w, n*w,
+                MPI_UNSIGNED_CHAR, win_ima, &envoi[2*tour]);
+      if( iter_avec)
+        MPI_Rput( iter_rma[tour], n*w, MPI_INT, MAITRE, (MPI_Aint)i0*w, n*w,
+                  MPI_INT, win_iter, &envoi[2*tour + 1]);
+      tour = 1 - tour;
+      nBloc_recu++;
+      mes_lignes += n;
+    }
+    t_calcul = temps_processus() - t_calcul;
+
+    /* Ecritures terminees chez le rang 0 (flush), puis visibles pour lui (sync) */
+    MPI_Waitall( 4, envoi, MPI_STATUSES_IGNORE);
+    if( !mpiio) {
+      MPI_Win_flush_all( win_ima);
+      if( iter_avec) MPI_Win_flush_all( win_iter);
+      MPI_Barrier( MPI_COMM_WORLD);
+      MPI_Win_sync( win_ima);
+      if( iter_avec) MPI_Win_sync( win_iter);
+    }
+
+    /* Lignes et temps de calcul de chaque rang */
+    if( rank == MAITRE) {
+      lignes_rang = (int *)malloc( p*sizeof(int));
+      bornes_rang = (int *)malloc( (p + 1)*sizeof(int));
+      mesure = (double *)malloc( p*sizeof(double));
+    }
+    MPI_Gather( &mes_lignes, 1, MPI_INT, lignes_rang, 1, MPI_INT, MAITRE, MPI_COMM_WORLD);
+    MPI_Gather( &t_calcul, 1, MPI_DOUBLE, mesure, 1, MPI_DOUBLE, MAITRE, MPI_COMM_WORLD);
+
+    fin = my_gettimeofday();
+    fprintf( stderr, "Rang %d | %d blocs | Temps total de calcul : %g sec\n", rank,
+             nBloc_recu, fin - debut);
+
+    if( rank == MAITRE) {
+      for( bornes_rang[0] = 0, i = 0; i < p; i++) bornes_rang[i + 1] = bornes_rang[i] + lignes_rang[i];
+      decoupage_afficher( &d);
+      desequilibre_afficher( "Rang", p, bornes_rang, NULL, mesure);
+    }
+    if( rank == MAITRE && !mpiio) {
+      symetrie_recopier( ima, w, h, axe);
+      if( iter) symetrie_recopier( iter, w*sizeof(int), h, axe);
+      sauver_rasterfile( "mandel.ras", w, h, ima);
+      if( iter) iter_sauver( fichier_iter, &ie, iter);
+    }
+    MPI_Win_unlock_all( win_compteur);
+    MPI_Win_free( &win_compteur);
+    if( !mpiio) {
+      MPI_Win_unlock_all( win_ima);
+      MPI_Win_free( &win_ima);
+      if( iter_avec) {
+        MPI_Win_unlock_all( win_iter);
+        MPI_Win_free( &win_iter);
+      }
+    }
+    ima = NULL;
+    iter = NULL;
+    for( i = 0; i < 2; i++) {
+      free( ima_rma[i]);
+      free( iter_rma[i]);
+    }
+    free( blocs);
+    free( lignes_rang);
+    free( bornes_rang);
+    free( mesure);
+
+  }else if( hierarchique) {
+    /* Deux niveaux. Les rangs d'un meme noeud (memoire partagee) forment
+       comm_noeud, dont le rang 0 est le chef ; les chefs forment comm_chefs.
+       Les chefs prennent les morceaux d'une table (compteur du rang 0, comme
+       -rma, P = nombre de noeuds) ; dans le noeud, les rangs se partagent
+       les blocs de nlin lignes du morceau par un second compteur, en memoire
+       partagee, et ecrivent directement dans l'image du noeud. Le morceau
+       fini part au rang 0 en une ecriture : seuls les morceaux traversent
+       le reseau, pas les blocs */
+    MPI_Comm comm_machine, comm_noeud, comm_chefs;
+    MPI_Win win_ctrl, win_noeud_ima, win_noeud_iter = MPI_WIN_NULL;
+    MPI_Win win_compteur = MPI_WIN_NULL, win_ima = MPI_WIN_NULL, win_iter = MPI_WIN_NULL;
+    MPI_Aint taille_seg;
+    int rang_noeud, p_noeud, chef, noeud, nnoeuds, p_max, disp, un = 1;
+    int *morceaux, nmorceaux = 0, k_morceau, k_suivant = 0, nb, k_bloc, a, m;
+    int *compteur, *ctrl, mes_lignes = 0, mes_morceaux = 0, *lignes_rang = NULL, *bornes_rang = NULL;
+    /* Messages entre noeuds : hierarchique, et par bloc comme -rma */
+    long long messages[2] = { 0, 0 }, total[2];
+    double t_calcul, *mesure = NULL;
+
+    /* Noeuds : memoire partagee, decoupes en groupes de coeurs_noeud rangs */
+    MPI_Comm_split_type( MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &comm_machine);
+    MPI_Comm_rank( comm_machine, &rang_noeud);
+    MPI_Comm_split( comm_machine, coeurs_noeud > 0 ? rang_noeud / coeurs_noeud : 0, rank, &comm_noeud);
+    MPI_Comm_free( &comm_machine);
+    MPI_Comm_rank( comm_noeud, &rang_noeud);
+    MPI_Comm_size( comm_noeud, &p_noeud);
+    chef = rang_noeud == 0;
+    MPI_Comm_split( MPI_COMM_WORLD, chef ? 0 : MPI_UNDEFINED, rank, &comm_chefs);
+    if( chef) {
+      MPI_Comm_rank( comm_chefs, &noeud);
+      MPI_Comm_size( comm_chefs, &nnoeuds);
+    }
+    MPI_Bcast( &noeud, 1, MPI_INT, 0, comm_noeud);
+    MPI_Bcast( &nnoeuds, 1, MPI_INT, 0, comm_noeud);
+    MPI_Allreduce( &p_noeud, &p_max, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+
+    /* Morceaux : au moins un bloc de nlin lignes par rang du plus gros noeud */
+    decoupage_liberer( &d);
+    morceaux = (int *)malloc( 2*((long)h + 1)*sizeof(int));
+    if( decoupage_init( &d, mode_decoupage, nlin*p_max, nnoeuds, h, axe) != 0 || morceaux == NULL) {
       fprintf( stderr, "Erreur allocation mémoire du tableau \n");
       return 0;
     }
+    while( (morceaux[2*nmorceaux] = decoupage_suivant( &d, &morceaux[2*nmorceaux + 1])) >= 0) nmorceaux++;
+
+    /* Memoire partagee du noeud, chez le chef : morceau en cours (debut,
+       lignes), compteur de ses blocs, image et nombres d'iterations */
+    MPI_Win_allocate_shared( chef ? 3*sizeof(int) : 0, sizeof(int), MPI_INFO_NULL,
+                             comm_noeud, &ctrl, &win_ctrl);
+    MPI_Win_shared_query( win_ctrl, 0, &taille_seg, &disp, &ctrl);
+    MPI_Win_allocate_shared( chef ? (MPI_Aint)w*h : 0, 1, MPI_INFO_NULL,
+                             comm_noeud, &ima, &win_noeud_ima);
+    MPI_Win_shared_query( win_noeud_ima, 0, &taille_seg, &disp, &ima);
+    if( iter_avec) {
+      MPI_Win_allocate_shared( chef ? (MPI_Aint)w*h*sizeof(int) : 0, sizeof(int), MPI_INFO_NULL,
+                               comm_noeud, &iter, &win_noeud_iter);
+      MPI_Win_shared_query( win_noeud_iter, 0, &taille_seg, &disp, &iter);
+    }
 
-    for(i = 0 ; i <p ; i++){
-      if(i != MAITRE){
-        // On envoie au esclave de rang i num_bloc
-        MPI_Send(&num_bloc, 1, MPI_INT, i, TAG_NUM_BLOC, MPI_COMM_WORLD);
-        num_bloc+=1;
+    /* Entre chefs : compteur des morceaux, et image du rang 0 s'il y a
+       d'autres noeuds pour y ecrire */
+    if( chef) {
+      MPI_Win_allocate( rank == MAITRE ? sizeof(int) : 0, sizeof(int), MPI_INFO_NULL,
+                        comm_chefs, &compteur, &win_compteur);
+      if( rank == MAITRE) {
+        MPI_Win_lock( MPI_LOCK_EXCLUSIVE, 0, 0, win_compteur);
+        *compteur = 0;
+        MPI_Win_unlock( 0, win_compteur);
       }
+      if( nnoeuds > 1) {
+        MPI_Win_create( ima, rank == MAITRE ? (MPI_Aint)w*h : 0, 1, MPI_INFO_NULL,
+                        comm_chefs, &win_ima);
+        if( iter_avec)
+          MPI_Win_create( iter, rank == MAITRE ? (MPI_Aint)w*h*sizeof(int) : 0, sizeof(int),
+                          MPI_INFO_NULL, comm_chefs, &win_iter);
+      }
+      MPI_Barrier( comm_chefs);
+      MPI_Win_lock_all( 0, win_compteur);
+      if( nnoeuds > 1) MPI_Win_lock_all( 0, win_ima);
+      if( nnoeuds > 1 && iter_avec) MPI_Win_lock_all( 0, win_iter);
+      // Premier morceau demande
+      MPI_Fetch_and_op( &un, &k_suivant, MPI_INT, 0, 0, MPI_SUM, win_compteur);
+      messages[0] += noeud != 0;
     }
+    MPI_Win_lock_all( 0, win_ctrl);
+    MPI_Win_lock_all( 0, win_noeud_ima);
+    if( iter_avec) MPI_Win_lock_all( 0, win_noeud_iter);
+
+    t_calcul = temps_processus();
+    for(;;){
+      if( chef) {
+        // Morceau demande au tour precedent ; le suivant est demande tout de suite
+        MPI_Win_flush( 0, win_compteur);
+        k_morceau = k_suivant;
+        if( k_morceau < nmorceaux) {
+          ctrl[0] = morceaux[2*k_morceau];
+          ctrl[1] = morceaux[2*k_morceau + 1];
+          MPI_Fetch_and_op( &un, &k_suivant, MPI_INT, 0, 0, MPI_SUM, win_compteur);
+          messages[0] += noeud != 0;
+        } else ctrl[0] = -1;
+        ctrl[2] = 0;
+        MPI_Win_sync( win_ctrl);
+      }
+      MPI_Barrier( comm_noeud);
+      MPI_Win_sync( win_ctrl);
+      i0 = ctrl[0];
+      n = ctrl[1];
+      if( i0 < 0) break;
+
+      // Blocs de nlin lignes du morceau, pris par les rangs du noeud
+      nb = (n + nlin - 1) / nlin;
+      for(;;){
+        MPI_Fetch_and_op( &un, &k_bloc, MPI_INT, 0, 2, MPI_SUM, win_ctrl);
+        MPI_Win_flush( 0, win_ctrl);
+        if( k_bloc >= nb) break;
+        a = i0 + k_bloc*nlin;
+        m = a + nlin < i0 + n ? nlin : i0 + n - a;
+        calculer_bloc( &t, a, m, ima + (long)a*w, iter_avec ? iter + (long)a*w : NULL, NULL);
+        nBloc_recu++;
+        mes_lignes += m;
+        /* par bloc, -rma aurait fait une prise et une ou deux ecritures */
+        messages[1] += noeud != 0 ? 2 + iter_avec : 0;
+      }
+      MPI_Win_sync( win_noeud_ima);
+      if( iter_avec) MPI_Win_sync( win_noeud_iter);
+      MPI_Barrier( comm_noeud);
+
+      // Morceau fini : une ecriture vers le rang 0 (deux avec -iter)
+      if( chef && noeud != 0) {
+        MPI_Win_sync( win_noeud_ima);
+        MPI_Put( ima + (long)i0*w, n*w, MPI_UNSIGNED_CHAR, 0, (MPI_Aint)i0*w, n*w,
+                 MPI_UNSIGNED_CHAR, win_ima);
+        if( iter_avec) {
+          MPI_Win_sync( win_noeud_iter);
+          MPI_Put( iter + (long)i0*w, n*w, MPI_INT, 0, (MPI_Aint)i0*w, n*w, MPI_INT, win_iter);
+        }
+        messages[0] += 1 + iter_avec;
+      }
+      mes_morceaux += chef;
+    }
+    t_calcul = temps_processus() - t_calcul;
 
+    /* Ecritures terminees chez le rang 0 (flush), puis visibles pour lui (sync) */
+    if( chef && nnoeuds > 1) {
+      MPI_Win_flush_all( win_ima);
+      if( iter_avec) MPI_Win_flush_all( win_iter);
+    }
+    MPI_Barrier( MPI_COMM_WORLD);
+    if( rank == MAITRE && nnoeuds > 1) {
+      MPI_Win_sync( win_ima);
+      if( iter_avec) MPI_Win_sync( win_iter);
+    }
+
+    /* Lignes et temps de calcul de chaque rang, messages entre noeuds */
+    if( rank == MAITRE) {
+      lignes_rang = (int *)malloc( p*sizeof(int));
+      bornes_rang = (int *)malloc( (p + 1)*sizeof(int));
+      mesure = (double *)malloc( p*sizeof(double));
+    }
+    MPI_Gather( &mes_lignes, 1, MPI_INT, lignes_rang, 1, MPI_INT, MAITRE, MPI_COMM_WORLD);
+    MPI_Gather( &t_calcul, 1, MPI_DOUBLE, mesure, 1, MPI_DOUBLE, MAITRE, MPI_COMM_WORLD);
+    MPI_Reduce( messages, total, 2, MPI_LONG_LONG, MPI_SUM, MAITRE, MPI_COMM_WORLD);
 
-    while(finCalc == 0){
-      /* Reception donnees ouvrier */
+    fin = my_gettimeofday();
+    fprintf( stderr, "Rang %d | noeud %d | %d blocs, %d morceaux | Temps total de calcul : %g sec\n",
+             rank, noeud, nBloc_recu, mes_morceaux, fin - debut);
+
+    if( rank == MAITRE) {
+      for( bornes_rang[0] = 0, i = 0; i < p; i++) bornes_rang[i + 1] = bornes_rang[i] + lignes_rang[i];
+      fprintf( stderr, "Hierarchique: %d noeuds, %d rangs au plus par noeud\n", nnoeuds, p_max);
+      decoupage_afficher( &d);
+      fprintf( stderr, "Messages entre noeuds: %lld (%lld par bloc de nlin lignes)\n",
+               total[0], total[1]);
+      desequilibre_afficher( "Rang", p, bornes_rang, NULL, mesure);
+      symetrie_recopier( ima, w, h, axe);
+      if( iter) symetrie_recopier( iter, w*sizeof(int), h, axe);
+      sauver_rasterfile( "mandel.ras", w, h, ima);
+      if( iter) {
+        iter_entete e = iter_entete_creer( w, h, prof, xmin, ymin, xmax, ymax);
+        iter_sauver( fichier_iter, &e, iter);
+      }
+    }
+    if( chef) {
+      MPI_Win_unlock_all( win_compteur);
+      MPI_Win_free( &win_compteur);
+      if( nnoeuds > 1) {
+        MPI_Win_unlock_all( win_ima);
+        MPI_Win_free( &win_ima);
+        if( iter_avec) {
+          MPI_Win_unlock_all( win_iter);
+          MPI_Win_free( &win_iter);
+        }
+      }
+      MPI_Comm_free( &comm_chefs);
+    }
+    MPI_Win_unlock_all( win_ctrl);
+    MPI_Win_unlock_all( win_noeud_ima);
+    MPI_Win_free( &win_ctrl);
+    MPI_Win_free( &win_noeud_ima);
+    if( iter_avec) {
+      MPI_Win_unlock_all( win_noeud_iter);
+      MPI_Win_free( &win_noeud_iter);
+    }
+    MPI_Comm_free( &comm_noeud);
+    ima = NULL;
+    iter = NULL;
+    free( morceaux);
+    free( lignes_rang);
+    free( bornes_rang);
+    free( mesure);
+
+  }else if(rank == MAITRE){
+
+    /* Allocation memoire du tableau resultat (sauf -mpiio : lignes gardees) */
+    if( !mpiio) ima = (unsigned char *)malloc( w*h*sizeof(unsigned char));
+    if( !mpiio && iter_avec) iter = (int *)calloc( (long)w*h, sizeof(int));
+    if( pas > 1) {
+      /* le maitre calcule aussi des unites : brouillon, valeurs, abscisses */
+      recu = (int *)calloc( npasses, sizeof(int));
+      vals = (int *)malloc( (long)w*nlin*sizeof(int));
+      iter_loc = (int *)malloc( (long)w*nlin*sizeof(int));
+      abscisses = t.abscisses = progressif_abscisses( xmin, xinc, w);
+    }
+    res = (unsigned char **)malloc( p*sizeof(unsigned char *));
+    req = (MPI_Request *)malloc( p*sizeof(MPI_Request));
+    en_cours = (int *)calloc( p, sizeof(int));
+    arrete = (int *)calloc( p, sizeof(int));
+    for(n = 0, i = 0 ; res != NULL && i < p ; i++){
+      res[i] = i == MAITRE ? NULL : (unsigned char *)malloc( taille_res);
+      n += i != MAITRE && res[i] == NULL;
+    }
+    if( lissage) {
+      bords = (int *)malloc( (long)w*h*sizeof(int));
+      rgb = (unsigned char *)malloc( 3L*w*h);
+      paquet = (long *)malloc( p*sizeof(long));
+    }
+    if( (!mpiio && (ima == NULL || (iter_avec && iter == NULL)))
+        || (pas > 1 && (recu == NULL || vals == NULL || iter_loc == NULL || abscisses == NULL))
+        || res == NULL || n > 0 || req == NULL || en_cours == NULL || arrete == NULL
+        || (lissage && (bords == NULL || rgb == NULL || paquet == NULL))) {
+      fprintf( stderr, "Erreur allocation mémoire du tableau \n");
+      return 0;
+    }
 
-      // On determine le rang de l'émetteur
-      MPI_Probe(MPI_ANY_SOURCE, TAG_NUM_BLOC, MPI_COMM_WORLD, &status);
-      int rank_src = status.MPI_SOURCE; // rank de la source
+    /* Chaque ouvrier recoit d'avance ses premieres unites ; un Irecv par ouvrier
+       attend son prochain resultat */
+    for(i = 0 ; i < p ; i++){
+      req[i] = MPI_REQUEST_NULL;
+      if(i == MAITRE) continue;
+      for(k = 0 ; k < avance ; k++){
+        unite[0] = unite_suivante( &t, &d, &num_bloc, nUnites, &unite[1]);
+        if(unite[0] < 0) break;
+        MPI_Send(unite, 2, MPI_INT, i, TAG_NUM_BLOC, MPI_COMM_WORLD);
+        en_cours[i]++;
+        nBloc_distribues++;
+      }
+      arrete[i] = k < avance;
+      if(arrete[i]) MPI_Send(stop, 2, MPI_INT, i, TAG_NUM_BLOC, MPI_COMM_WORLD);
+      if(en_cours[i] > 0)
+        MPI_Irecv(res[i], taille_res, MPI_BYTE, i, TAG_IM, MPI_COMM_WORLD, &req[i]);
+    }
 
-      if (rank_src != MAITRE) {
-        // On reçoit le numéro de bloc traite par l'ouvrier
-        MPI_Recv(&num_bloc_rec, 1, MPI_INT, rank_src, TAG_NUM_BLOC,MPI_COMM_WORLD, &status);
+    for(;;){
+      /* Un resultat est arrive ? Sinon le maitre calcule lui-meme une unite,
+         ou attend s'il n'en reste plus a distribuer */
+      MPI_Testany(p, req, &src, &flag, &status);
+      if(!flag || src == MPI_UNDEFINED){
+        num_bloc_rec = unite_suivante( &t, &d, &num_bloc, nUnites, &n);
+        if(num_bloc_rec >= 0){
+          src = MAITRE;
+          nBloc_distribues++;
+        }else if(nBloc_recu == nBloc_distribues) break;
+        else MPI_Waitany(p, req, &src, &status);
+      }
 
-        // On reçoit le bloc traité
-        MPI_Recv(ima + num_bloc_rec*nlin*w*sizeof(unsigned char), nlin*w, MPI_CHAR, rank_src, TAG_IM, MPI_COMM_WORLD, &status);
+      if(src == MAITRE){
+        t_bloc = temps_processus();
+        if( pas > 1) {
+          calculer_bloc( &t, num_bloc_rec, n, NULL, iter_loc, vals);
+          v = vals;
+        } else if( mpiio) {
+          k = garder( &mt, num_bloc_rec, n);
+          calculer_bloc( &t, num_bloc_rec, n, mt.ima + k*w, mt.iter ? mt.iter + k*w : NULL, NULL);
+        } else {
+          calculer_bloc( &t, num_bloc_rec, n, ima + (long)num_bloc_rec*w,
+                         iter ? iter + (long)num_bloc_rec*w : NULL, NULL);
+        }
+        decoupage_mesure( &d, n, temps_processus() - t_bloc);
+      } else {
+        // L'unite et son temps de calcul sont en tete du resultat
+        e = (entete *)res[src];
+        num_bloc_rec = e->num;
+        n = e->n;
+        v = (int *)(e + 1);
+        decoupage_mesure( &d, n, e->temps);
+        en_cours[src]--;
+
+        // L'ouvrier recoit tout de suite une nouvelle unite (ou l'arret)
+        if(!arrete[src]){
+          unite[0] = unite_suivante( &t, &d, &num_bloc, nUnites, &unite[1]);
+          if(unite[0] >= 0){
+            MPI_Send(unite, 2, MPI_INT, src, TAG_NUM_BLOC, MPI_COMM_WORLD);
+            en_cours[src]++;
+            nBloc_distribues++;
+          }else{
+            MPI_Send(stop, 2, MPI_INT, src, TAG_NUM_BLOC, MPI_COMM_WORLD);
+            arrete[src] = 1;
+          }
+        }
 
-        nBloc_recu ++;
+        if( pas == 1 && !mpiio) {
+          // Nombres d'iterations puis pixels des lignes num_bloc_rec..num_bloc_rec+n-1
+          if( iter) memcpy(iter + (long)num_bloc_rec*w, v, (long)n*w*sizeof(int));
+          memcpy(ima + (long)num_bloc_rec*w, res[src] + DECALAGE_IMA(n), (long)n*w);
+        }
+      }
 
-        // Test fin de calcul de l'image
-        if(num_bloc >= nBloc){
-          MPI_Send(&stop, 1, MPI_INT, rank_src, TAG_NUM_BLOC, MPI_COMM_WORLD);
-        }else{
-          MPI_Send(&num_bloc, 1, MPI_INT, rank_src, TAG_NUM_BLOC, MPI_COMM_WORLD);
-          num_bloc+=1;
+      if( pas > 1) {
+        // Pixels de la passe, replaces ligne par ligne
+        passe = num_bloc_rec / nBloc;
+        s = pas >> passe;
+        i0 = (num_bloc_rec % nBloc)*nlin;
+        for (n = 0, i = i0; i < i0 + nlin && i < h; i++)
+          n += progressif_etaler(v + n, i, w, s, pas, iter + (long)i*w);
+        recu[passe]++;
+
+        // Apercu des que toutes les passes jusqu'a celle-ci sont recues
+        while(ecrites < npasses - 1 && recu[ecrites] == nBloc){
+          progressif_apercu(iter, w, h, prof, pas >> ecrites, ima);
+          sauver_rasterfile( "mandel.ras", w, h, ima);
+          fprintf( stderr, "Progressif: passe de pas %d a %g sec\n",
+                   pas >> ecrites, my_gettimeofday() - debut);
+          ecrites++;
         }
+      }
+
+      if(src != MAITRE && en_cours[src] > 0)
+        MPI_Irecv(res[src], taille_res, MPI_BYTE, src, TAG_IM, MPI_COMM_WORLD, &req[src]);
+      if(src == MAITRE) nBloc_maitre++;
+      nBloc_recu ++;
+    }
+
+    fprintf( stderr, "Blocs calcules par le maitre: %d sur %d\n", nBloc_maitre, nBloc_recu);
+    if( pas == 1) decoupage_afficher( &d);
+    if( !mpiio) {
+      symetrie_recopier( ima, w, h, axe);
+      if( iter) symetrie_recopier( iter, w*sizeof(int), h, axe);
+    }
 
-        // Si tous recu on se stope
-        if(nBloc_recu == nBloc){
-          finCalc = -1;
+    /* Derniere passe : l'image complete */
+    if( pas > 1) progressif_apercu(iter, w, h, prof, 1, ima);
+
+    /* Anticrenelage : les pixels de bord sont distribues par paquets */
+    if( lissage) {
+      int actifs = 0, m;
+      nbords = lissage_bords( iter, w, h, seuil_lissage, bords);
+      // Les ouvriers attendent leur premier paquet : on arrete tout
+      if( nbords < 0
+          || (rgb_bords = (unsigned char *)malloc( 3*nbords + 1)) == NULL) {
+        fprintf( stderr, "Erreur allocation mémoire du tableau \n");
+        MPI_Abort( MPI_COMM_WORLD, 1);
+      }
+      for(k = 0, i = 0; i < p; i++){
+        if(i != MAITRE){
+          m = nbords - k < LISSAGE_PAQUET ? nbords - k : LISSAGE_PAQUET;
+          paquet[i] = k;
+          MPI_Send(bords + k, m, MPI_INT, i, TAG_LISSAGE, MPI_COMM_WORLD);
+          k += m;
+          actifs += m > 0;
         }
       }
+      // Un paquet vide arrete l'ouvrier
+      while(actifs > 0){
+        MPI_Probe(MPI_ANY_SOURCE, TAG_RGB, MPI_COMM_WORLD, &status);
+        int rank_src = status.MPI_SOURCE;
+        MPI_Get_count(&status, MPI_UNSIGNED_CHAR, &m);
+        MPI_Recv(rgb_bords + 3*paquet[rank_src], m, MPI_UNSIGNED_CHAR, rank_src, TAG_RGB, MPI_COMM_WORLD, &status);
+        m = nbords - k < LISSAGE_PAQUET ? nbords - k : LISSAGE_PAQUET;
+        paquet[rank_src] = k;
+        MPI_Send(bords + k, m, MPI_INT, rank_src, TAG_LISSAGE, MPI_COMM_WORLD);
+        k += m;
+        if(m == 0) actifs--;
+      }
+      // Sans ouvrier, le maitre (et ses threads) calcule tout
+      if( p == 1) lissage_pixels( &g, bords, nbords, w, lissage, prof, pal, rgb_bords);
+      lissage_rgb( ima, (long)w*h, pal, rgb);
+      lissage_placer( bords, nbords, rgb_bords, rgb);
     }
 
     /* fin du chronometrage */
@@ -351,50 +1229,85 @@ int main(int argc, char *argv[]) {
     fprintf( stderr, "Rang %d | Temps total de calcul : %g sec\n", rank,
        fin - debut);
 
+    if( lissage) lissage_afficher( nbords, (long)w*h, lissage);
+
     /* Sauvegarde de la grille dans le fichier resultat "mandel.ras" */
-    sauver_rasterfile( "mandel.ras", w, h, ima);
+    if( lissage) sauver_rasterfile_rgb( "mandel.ras", w, h, rgb);
+    else if( !mpiio) sauver_rasterfile( "mandel.ras", w, h, ima);
+    if( fichier_iter && !mpiio) iter_sauver( fichier_iter, &ie, iter);
 
   }else{
 
     /* Affichage parametres pour verificatrion */
     fprintf( stderr, "Rang: %d\n", rank);
 
-    /* Allocation memoire locale */
-    ima_loc = (unsigned char *)malloc( w*nlin*sizeof(unsigned char));
-    if( ima_loc == NULL) {
+    /* Allocation memoire locale : deux tampons de resultat, l'un part
+       pendant que l'autre se remplit */
+    res = (unsigned char **)malloc( 2*sizeof(unsigned char *));
+    res[0] = (unsigned char *)malloc( taille_res);
+    res[1] = (unsigned char *)malloc( taille_res);
+    if( pas > 1) iter_loc = (int *)malloc( (long)w*nlin*sizeof(int));
+    if( lissage) {
+      bords = (int *)malloc( LISSAGE_PAQUET*sizeof(int));
+      rgb_bords = (unsigned char *)malloc( 3*LISSAGE_PAQUET);
+    }
+    if( pas > 1) abscisses = t.abscisses = progressif_abscisses( xmin, xinc, w);
+    if( res[0] == NULL || res[1] == NULL || (pas > 1 && (iter_loc == NULL || abscisses == NULL))
+        || (lissage && (bords == NULL || rgb_bords == NULL))) {
       fprintf( stderr, "Erreur allocation mémoire du tableau \n");
       return 0;
     }
 
-    while(finCalc == 0){
-      // Reception numéro de bloc à traiter
-      MPI_Recv(&num_bloc, 1, MPI_INT, MAITRE, TAG_NUM_BLOC,MPI_COMM_WORLD, &status);
-
-      if(num_bloc == -1){
-        finCalc = -1;
-      }else{
-        pima_loc = ima_loc;
-
-        /* Traitement d'un bloc point par point */
-        y = ymin + nlin*num_bloc*yinc;
-        for (i = 0; i < nlin; i++) {
-          x = xmin;
-          for (j = 0; j < w; j++) {
-            // printf("%d\n", xy2color( x, y, prof));
-            // printf("(x,y)=(%g;%g)\t (i,j)=(%d,%d)\n", x, y, i, j);
-            *pima_loc++ = xy2color( x, y, prof);
-            x += xinc;
-          }
-          y += yinc;
-        }
-
-        // Envoie au master du numéro de bloc
-        MPI_Send(&num_bloc, 1, MPI_INT, MAITRE, TAG_NUM_BLOC, MPI_COMM_WORLD);
-
-        // Envoie au master du bloc
-        MPI_Send(ima_loc, nlin * w, MPI_CHAR, MAITRE, TAG_IM, MPI_COMM_WORLD);
-
+    /* Pendant le calcul d'une unite, la suivante est deja en attente (Irecv)
+       et le resultat precedent part (Isend) */
+    MPI_Request envoi[2] = { MPI_REQUEST_NULL, MPI_REQUEST_NULL }, req_num;
+    int tour = 0, suivant[2];
+    long taille;
+
+    MPI_Recv(unite, 2, MPI_INT, MAITRE, TAG_NUM_BLOC, MPI_COMM_WORLD, &status);
+    while(unite[0] != stop[0]){
+      MPI_Irecv(suivant, 2, MPI_INT, MAITRE, TAG_NUM_BLOC, MPI_COMM_WORLD, &req_num);
+      MPI_Wait(&envoi[tour], MPI_STATUS_IGNORE);
+
+      /* Resultat : en-tete, [nombres d'iterations,] pixels */
+      e = (entete *)res[tour];
+      e->num = unite[0];
+      e->n = unite[1];
+      t_bloc = temps_processus();
+      if( pas > 1) {
+        n = calculer_bloc( &t, unite[0], unite[1], NULL, iter_loc, (int *)(e + 1));
+        taille = sizeof(entete) + n*sizeof(int);
+      } else if( mpiio) {
+        // Lignes gardees : le resultat n'est plus que l'en-tete
+        k = garder( &mt, unite[0], unite[1]);
+        calculer_bloc( &t, unite[0], unite[1], mt.ima + k*w, mt.iter ? mt.iter + k*w : NULL, NULL);
+        taille = sizeof(entete);
+      } else {
+        calculer_bloc( &t, unite[0], unite[1], res[tour] + DECALAGE_IMA(unite[1]),
+                       iter_avec ? (int *)(e + 1) : NULL, NULL);
+        taille = DECALAGE_IMA(unite[1]) + (long)w*unite[1];
       }
+      e->temps = temps_processus() - t_bloc;
+      MPI_Isend(res[tour], taille, MPI_BYTE, MAITRE, TAG_IM, MPI_COMM_WORLD, &envoi[tour]);
+      tour = 1 - tour;
+
+      MPI_Wait(&req_num, &status);
+      unite[0] = suivant[0];
+      unite[1] = suivant[1];
+    }
+    MPI_Waitall(2, envoi, MPI_STATUSES_IGNORE);
+
+    /* Anticrenelage : paquets de pixels de bord, jusqu'au paquet vide */
+    if( lissage) {
+      do {
+        MPI_Probe(MAITRE, TAG_LISSAGE, MPI_COMM_WORLD, &status);
+        MPI_Get_count(&status, MPI_INT, &n);
+        MPI_Recv(bords, n, MPI_INT, MAITRE, TAG_LISSAGE, MPI_COMM_WORLD, &status);
+        if( n > 0) {
+          lissage_pixels( &g, bords, n, w, lissage, prof, pal, rgb_bords);
+          MPI_Send(rgb_bords, 3*n, MPI_UNSIGNED_CHAR, MAITRE, TAG_RGB, MPI_COMM_WORLD);
+        }
+      } while( n > 0);
     }
 
     /* fin du chronometrage */
@@ -403,6 +1316,27 @@ int main(int argc, char *argv[]) {
        fin - debut);
   }
 
+  /* Ecriture parallele : chaque processus ecrit les lignes qu'il a gardees */
+  if( mpiio) {
+    if( rank == MAITRE) fprintf( stderr, "MPI-IO: %d lignes gardees par le maitre sur %d\n", mt.n, h);
+    sauver_mpiio( w, h, axe, mt.ima, mt.iter, mt.lignes, mt.n, fichier_iter, &ie);
+  }
+  mpiio_tampon_liberer( &mt);
+
+  /* Statistiques de periodicite cumulees sur le maitre */
+  if( noyau_periode) {
+    periode_stats total;
+    MPI_Reduce(&noyau_stats.pixels, &total.pixels, 3, MPI_LONG_LONG, MPI_SUM, MAITRE, MPI_COMM_WORLD);
+    MPI_Reduce(&noyau_stats.periode_max, &total.periode_max, 1, MPI_LONG_LONG, MPI_MAX, MAITRE, MPI_COMM_WORLD);
+    if( rank == MAITRE) periode_afficher( &total, (long long)w*h);
+  }
+  if( mode_mariani) {
+    long long calcules;
+    MPI_Reduce(&ms.calcules, &calcules, 1, MPI_LONG_LONG, MPI_SUM, MAITRE, MPI_COMM_WORLD);
+    if( rank == MAITRE) mariani_afficher( calcules, (long long)w*h);
+  }
+
+  decoupage_liberer( &d);
   MPI_Finalize();
 
   return 0;
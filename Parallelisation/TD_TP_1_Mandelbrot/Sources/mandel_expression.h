@@ -0,0 +1,620 @@
+/*
+ * Formule quelconque (option -formule "z^3 + c*z + 0.2") : l'expression
+ * est traduite en un noyau C vectoriel (8 voies en double, comme
+ * NOYAU_POINTS_FORMULE), compile par le compilateur local ($CC, cc par
+ * defaut) en bibliotheque partagee, puis chargee par dlopen. Le noyau
+ * est range dans noyau_formule : il tourne a la vitesse d'un noyau
+ * compile avec le programme, sans interpreteur.
+ *
+ * Expression : nombres, z, c, i, + - * /, ^n (n entier naturel, deroule
+ * en carres et produits), conj(...) et parentheses. Les constantes sont
+ * calculees a la traduction, et les produits par un reel ou un imaginaire
+ * pur se reduisent a deux multiplications.
+ *
+ * Les noyaux compiles sont gardes dans $MANDEL_FORMULES (defaut
+ * ~/.cache/mandel, sinon $XDG_RUNTIME_DIR/mandel-formules, sinon
+ * /tmp/mandel-formules-<uid>), sous le nom formule_<h>.so, h etant un hachage du
+ * source genere, de la commande de compilation et de la machine (uname -m
+ * et le processeur, que -march=native suit) : une formule deja vue n'est
+ * pas recompilee, et un repertoire partage entre machines differentes ne
+ * donne pas a l'une le noyau de l'autre. Le source formule_<h>.c est
+ * garde a cote. Le nom est previsible : le repertoire et la bibliotheque
+ * doivent appartenir a l'utilisateur et n'etre modifiables que par lui,
+ * sinon rien n'est charge. Le compilateur est lance par fork/execvp, sans
+ * shell.
+ */
+
+#ifndef _mandel_expression_h
+#define _mandel_expression_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include <dlfcn.h>
+
+#include "mandel_noyau.h"
+
+/* Puissance entiere maximale (^n) */
+#define EXPRESSION_PUISSANCE_MAX 64
+
+/* Signature du noyau compile (formule_orbites) */
+typedef void (*expression_fn)(const double *pa, const double *pb, int np,
+                              int debut, int prof, int *iter,
+                              periode_stats *st, orbite *orb,
+                              int periode, double eps, int julia,
+                              double ja, double jb);
+
+static expression_fn expression_noyau = NULL;
+static int expression_julia = 0;
+static int expression_complexe = 0;   /* l'expression utilise i */
+static char expression_chemin[1024];  /* bibliotheque chargee */
+
+/* Valeur d'une sous-expression : constante, ou parties reelle et imaginaire */
+typedef struct {
+  int cst;
+  double re, im;          /* si constante */
+  char nr[48], ni[48];    /* code des deux parties */
+} expression_val;
+
+typedef struct {
+  const char *texte, *p;
+  FILE *f;                /* code genere */
+  int n;                  /* registres t<k> utilises */
+  int complexe;
+  const char *erreur;
+} expression_lecteur;
+
+static inline void expression_constante(expression_val *v, double re, double im) {
+  v->cst = 1;
+  v->re = re;
+  v->im = im;
+  snprintf(v->nr, sizeof(v->nr), "(%.17g)", re);
+  snprintf(v->ni, sizeof(v->ni), "(%.17g)", im);
+}
+
+/* Nouveau registre t<k>r + i.t<k>i, dont le code est re et im */
+static inline void expression_registre(expression_lecteur *L, expression_val *v,
+                                       const char *re, const char *im) {
+  fprintf(L->f, "        vt t%dr = %s;\n", L->n, re);
+  fprintf(L->f, "        vt t%di = %s;\n", L->n, im);
+  v->cst = 0;
+  snprintf(v->nr, sizeof(v->nr), "t%dr", L->n);
+  snprintf(v->ni, sizeof(v->ni), "t%di", L->n);
+  L->n++;
+}
+
+static inline int expression_reelle(const expression_val *v) {
+  return v->cst && v->im == 0.;
+}
+
+/* a + s.b, s = 1 ou -1 */
+static inline void expression_somme(expression_lecteur *L, expression_val *a,
+                                    const expression_val *b, int s) {
+  char re[128], im[128];
+  const char *op = s > 0 ? "+" : "-";
+  if (a->cst && b->cst) {
+    expression_constante(a, a->re + s*b->re, a->im + s*b->im);
+    return;
+  }
+  snprintf(re, sizeof(re), "%s %s %s", a->nr, op, b->nr);
+  if (expression_reelle(b))
+    snprintf(im, sizeof(im), "%s", a->ni);
+  else if (expression_reelle(a))
+    snprintf(im, sizeof(im), "%s%s", s > 0 ? "" : "-", b->ni);
+  else
+    snprintf(im, sizeof(im), "%s %s %s", a->ni, op, b->ni);
+  expression_registre(L, a, re, im);
+}
+
+static inline void expression_produit(expression_lecteur *L, expression_val *a,
+                                      const expression_val *b) {
+  char re[256], im[256];
+  const expression_val *k, *v;
+  if (a->cst && b->cst) {
+    expression_constante(a, a->re*b->re - a->im*b->im, a->re*b->im + a->im*b->re);
+    return;
+  }
+  k = a->cst ? a : b->cst ? b : NULL;
+  v = k == a ? b : a;
+  if (k && k->im == 0.) {                 /* reel */
+    if (k->re == 1.) { if (v != a) *a = *v; return; }
+    snprintf(re, sizeof(re), "%s*%s", k->nr, v->nr);
+    snprintf(im, sizeof(im), "%s*%s", k->nr, v->ni);
+  } else if (k && k->re == 0.) {          /* imaginaire pur */
+    snprintf(re, sizeof(re), "(%.17g)*%s", -k->im, v->ni);
+    snprintf(im, sizeof(im), "%s*%s", k->ni, v->nr);
+  } else if (strcmp(a->nr, b->nr) == 0 && strcmp(a->ni, b->ni) == 0) {
+    snprintf(re, sizeof(re), "%s*%s - %s*%s", a->nr, a->nr, a->ni, a->ni);
+    snprintf(im, sizeof(im), "2*%s*%s", a->nr, a->ni);
+  } else {
+    snprintf(re, sizeof(re), "%s*%s - %s*%s", a->nr, b->nr, a->ni, b->ni);
+    snprintf(im, sizeof(im), "%s*%s + %s*%s", a->nr, b->ni, a->ni, b->nr);
+  }
+  expression_registre(L, a, re, im);
+}
+
+static inline void expression_quotient(expression_lecteur *L, expression_val *a,
+                                       const expression_val *b) {
+  char re[256], im[256], d[16];
+  if (b->cst && b->re == 0. && b->im == 0.) {
+    L->erreur = "division par zero";
+    return;
+  }
+  if (a->cst && b->cst) {
+    double m = b->re*b->re + b->im*b->im;
+    expression_constante(a, (a->re*b->re + a->im*b->im)/m,
+                         (a->im*b->re - a->re*b->im)/m);
+    return;
+  }
+  if (expression_reelle(b)) {
+    snprintf(re, sizeof(re), "%s/%s", a->nr, b->nr);
+    snprintf(im, sizeof(im), "%s/%s", a->ni, b->nr);
+  } else {
+    snprintf(d, sizeof(d), "t%dd", L->n);
+    fprintf(L->f, "        vt %s = %s*%s + %s*%s;\n", d, b->nr, b->nr, b->ni, b->ni);
+    snprintf(re, sizeof(re), "(%s*%s + %s*%s)/%s", a->nr, b->nr, a->ni, b->ni, d);
+    snprintf(im, sizeof(im), "(%s*%s - %s*%s)/%s", a->ni, b->nr, a->nr, b->ni, d);
+  }
+  expression_registre(L, a, re, im);
+}
+
+/* a^n par carres successifs */
+static inline void expression_puissance(expression_lecteur *L, expression_val *a, int n) {
+  expression_val r, base = *a;
+  int premier = 1;
+  if (n == 0) { expression_constante(a, 1., 0.); return; }
+  while (n > 0) {
+    if (n & 1) {
+      if (premier) r = base; else expression_produit(L, &r, &base);
+      premier = 0;
+    }
+    n >>= 1;
+    if (n > 0) expression_produit(L, &base, &base);
+  }
+  *a = r;
+}
+
+static inline void expression_blancs(expression_lecteur *L) {
+  while (*L->p == ' ' || *L->p == '\t') L->p++;
+}
+
+static inline int expression_mot(expression_lecteur *L, const char *mot) {
+  size_t n = strlen(mot);
+  expression_blancs(L);
+  if (strncmp(L->p, mot, n) != 0) return 0;
+  if ((L->p[n] >= 'a' && L->p[n] <= 'z') || (L->p[n] >= '0' && L->p[n] <= '9'))
+    return 0;
+  L->p += n;
+  return 1;
+}
+
+static inline void expression_somme_lire(expression_lecteur *L, expression_val *v);
+
+/* nombre | z | c | i | conj(e) | (e) */
+static inline void expression_primaire(expression_lecteur *L, expression_val *v) {
+  char *fin;
+  expression_blancs(L);
+  if ((*L->p >= '0' && *L->p <= '9') || *L->p == '.') {
+    double x = strtod(L->p, &fin);
+    if (fin == L->p) { L->erreur = "nombre invalide"; return; }
+    L->p = fin;
+    expression_constante(v, x, 0.);
+  } else if (expression_mot(L, "z")) {
+    v->cst = 0;
+    strcpy(v->nr, "x");
+    strcpy(v->ni, "y");
+  } else if (expression_mot(L, "c")) {
+    v->cst = 0;
+    strcpy(v->nr, "ka");
+    strcpy(v->ni, "kb");
+  } else if (expression_mot(L, "i")) {
+    L->complexe = 1;
+    expression_constante(v, 0., 1.);
+  } else if (expression_mot(L, "conj")) {
+    expression_blancs(L);
+    if (*L->p != '(') { L->erreur = "( attendue apres conj"; return; }
+    expression_primaire(L, v);
+    if (L->erreur) return;
+    if (v->cst) expression_constante(v, v->re, -v->im);
+    else {
+      char im[64];
+      snprintf(im, sizeof(im), "-%s", v->ni);
+      expression_registre(L, v, v->nr, im);
+    }
+  } else if (*L->p == '(') {
+    L->p++;
+    expression_somme_lire(L, v);
+    if (L->erreur) return;
+    expression_blancs(L);
+    if (*L->p != ')') { L->erreur = ") attendue"; return; }
+    L->p++;
+  } else {
+    L->erreur = "nombre, z, c, i, conj ou ( attendu";
+  }
+}
+
+/* primaire [^n] */
+static inline void expression_facteur(expression_lecteur *L, expression_val *v) {
+  char *fin;
+  long n;
+  expression_primaire(L, v);
+  if (L->erreur) return;
+  expression_blancs(L);
+  if (*L->p != '^') return;
+  L->p++;
+  expression_blancs(L);
+  n = strtol(L->p, &fin, 10);
+  if (fin == L->p || n < 0 || n > EXPRESSION_PUISSANCE_MAX) {
+    L->erreur = "puissance entiere de 0 a 64 attendue";
+    return;
+  }
+  L->p = fin;
+  expression_puissance(L, v, (int)n);
+}
+
+/* [-] facteur */
+static inline void expression_unaire(expression_lecteur *L, expression_val *v) {
+  expression_blancs(L);
+  if (*L->p == '-') {
+    expression_val zero;
+    L->p++;
+    expression_unaire(L, v);
+    if (L->erreur) return;
+    expression_constante(&zero, 0., 0.);
+    expression_somme(L, &zero, v, -1);
+    *v = zero;
+  } else {
+    expression_facteur(L, v);
+  }
+}
+
+static inline void expression_terme(expression_lecteur *L, expression_val *v) {
+  expression_val w;
+  char op;
+  expression_unaire(L, v);
+  while (!L->erreur) {
+    expression_blancs(L);
+    op = *L->p;
+    if (op != '*' && op != '/') return;
+    L->p++;
+    expression_unaire(L, &w);
+    if (L->erreur) return;
+    if (op == '*') expression_produit(L, v, &w);
+    else expression_quotient(L, v, &w);
+  }
+}
+
+static inline void expression_somme_lire(expression_lecteur *L, expression_val *v) {
+  expression_val w;
+  char op;
+  expression_terme(L, v);
+  while (!L->erreur) {
+    expression_blancs(L);
+    op = *L->p;
+    if (op != '+' && op != '-') return;
+    L->p++;
+    expression_terme(L, &w);
+    if (L->erreur) return;
+    expression_somme(L, v, &w, op == '+' ? 1 : -1);
+  }
+}
+
+/*
+ * Debut et fin du source genere : meme boucle que NOYAU_POINTS_FORMULE
+ * (periodicite et orbites reprenables comprises), le pas z -> f(z, c)
+ * etant insere entre les deux.
+ */
+static const char *expression_avant =
+"#include <string.h>\n"
+"\n"
+"typedef double vt __attribute__((vector_size(8*sizeof(double))));\n"
+"typedef long long vi __attribute__((vector_size(8*sizeof(long long))));\n"
+"\n"
+"/* Memes dispositions que dans mandel_noyau.h */\n"
+"typedef struct { long long pixels, economie, periodes, periode_max; } periode_stats;\n"
+"typedef struct { double a, b, x, y, xr, yr; int actif; } orbite;\n"
+"\n"
+"void formule_orbites(const double *pa, const double *pb, int np, int debut,\n"
+"                     int prof, int *iter, periode_stats *st, orbite *orb,\n"
+"                     int periode, double eps_periode, int julia,\n"
+"                     double ja, double jb) {\n"
+"  int i, j, k;\n"
+"  for (j = 0; j < np; j += 8) {\n"
+"    vt a, b, x, y, x2, y2, xr, yr, dx, dy, ka, kb, zero = {0};\n"
+"    vt quatre = zero + 4., eps = zero + eps_periode;\n"
+"    vi actif, cpt, retour, izero = {0};\n"
+"    vi absmasque = izero + 0x7fffffffffffffffLL, ieps = (vi)eps;\n"
+"    long long n;\n"
+"    int verif = 1, iref = 0;\n"
+"\n"
+"    while (verif <= debut) { iref = verif; verif *= 2; }\n"
+"    x = y = xr = yr = zero;\n"
+"    for (k = 0; k < 8; k++) {\n"
+"      a[k] = j + k < np ? pa[j+k] : 0;\n"
+"      b[k] = j + k < np ? pb[j+k] : 0;\n"
+"      if (debut > 0 && j + k < np) {\n"
+"        x[k] = orb[j+k].x; y[k] = orb[j+k].y;\n"
+"        xr[k] = orb[j+k].xr; yr[k] = orb[j+k].yr;\n"
+"        cpt[k] = orb[j+k].actif ? debut : prof;\n"
+"      } else {\n"
+"        cpt[k] = j + k >= np ? prof : 0;\n"
+"      }\n"
+"      actif[k] = cpt[k] == prof ? 0 : -1;\n"
+"    }\n"
+"    ka = a; kb = b;\n"
+"    if (julia) {\n"
+"      if (debut == 0) { x = a; y = b; }\n"
+"      ka = zero + ja;\n"
+"      kb = zero + jb;\n"
+"    }\n"
+"    for (i = debut; i < prof; i++) {\n"
+"      x2 = x*x;\n"
+"      y2 = y*y;\n"
+"      actif &= ~(x2 + y2 >= quatre);\n"
+"      if (memcmp(&actif, &izero, sizeof(actif)) == 0) break;\n"
+"      cpt -= actif;\n"
+"      {\n";
+
+static const char *expression_apres =
+"      }\n"
+"      if (periode) {\n"
+"        dx = x - xr;\n"
+"        dy = y - yr;\n"
+"        retour = actif & ((((vi)dx & absmasque) - ieps)\n"
+"                        & (((vi)dy & absmasque) - ieps)) >> 63;\n"
+"        if (memcmp(&retour, &izero, sizeof(retour)) != 0) {\n"
+"          for (n = 0, k = 0; k < 8; k++)\n"
+"            if (retour[k]) { cpt[k] = prof; n++; }\n"
+"          st->pixels += n;\n"
+"          st->economie += n * (prof - i - 1);\n"
+"          st->periodes += n * (i + 1 - iref);\n"
+"          if (i + 1 - iref > st->periode_max) st->periode_max = i + 1 - iref;\n"
+"          actif &= ~retour;\n"
+"        }\n"
+"        if (i + 1 == verif) { xr = x; yr = y; iref = verif; verif *= 2; }\n"
+"      }\n"
+"    }\n"
+"    for (k = 0; k < 8 && j + k < np; k++) iter[j+k] = cpt[k];\n"
+"    for (k = 0; orb && k < 8 && j + k < np; k++) {\n"
+"      orb[j+k].x = x[k]; orb[j+k].y = y[k];\n"
+"      orb[j+k].xr = xr[k]; orb[j+k].yr = yr[k];\n"
+"      orb[j+k].actif = actif[k] != 0;\n"
+"    }\n"
+"  }\n"
+"}\n";
+
+/**
+ * Source C du noyau de l'expression (a liberer).
+ * @return NULL si l'expression est invalide (message sur stderr)
+ */
+static inline char *expression_source(const char *texte, int *complexe) {
+  expression_lecteur L = { texte, texte, NULL, 0, 0, NULL };
+  expression_val v;
+  char *src = NULL;
+  size_t taille;
+
+  L.f = open_memstream(&src, &taille);
+  if (L.f == NULL) return NULL;
+  fprintf(L.f, "/* Noyau genere par mandel_expression.h : z -> %s */\n", texte);
+  fputs(expression_avant, L.f);
+  expression_somme_lire(&L, &v);
+  expression_blancs(&L);
+  if (!L.erreur && *L.p != '\0') L.erreur = "caractere inattendu";
+  if (!L.erreur) {
+    if (v.cst)
+      fprintf(L.f, "        x = zero + %s;\n        y = zero + %s;\n", v.nr, v.ni);
+    else
+      fprintf(L.f, "        x = %s;\n        y = %s;\n", v.nr, v.ni);
+  }
+  fputs(expression_apres, L.f);
+  fclose(L.f);
+  if (L.erreur) {
+    fprintf(stderr, "Formule \"%s\" : %s a la position %d\n",
+            texte, L.erreur, (int)(L.p - texte) + 1);
+    free(src);
+    return NULL;
+  }
+  *complexe = L.complexe;
+  return src;
+}
+
+/* Hachage FNV-1a 64 bits */
+static inline unsigned long long expression_hachage(const char *s, unsigned long long h) {
+  for (; *s; s++) {
+    h ^= (unsigned char)*s;
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+/*
+ * Hachage de la machine : architecture (uname -m), puis modele et jeu
+ * d'instructions du premier processeur de /proc/cpuinfo (flags sur x86,
+ * Features et CPU part sur ARM), d'ou -march=native tire sa cible.
+ */
+static inline unsigned long long expression_machine(unsigned long long h) {
+  static const char *cles[] = { "model name", "flags", "Features", "CPU part" };
+  char ligne[4096];
+  struct utsname u;
+  FILE *f;
+  int k;
+
+  if (uname(&u) == 0) h = expression_hachage(u.machine, h);
+  if ((f = fopen("/proc/cpuinfo", "r")) == NULL) return h;
+  while (fgets(ligne, sizeof(ligne), f) != NULL && ligne[0] != '\n')
+    for (k = 0; k < 4; k++)
+      if (strncmp(ligne, cles[k], strlen(cles[k])) == 0) h = expression_hachage(ligne, h);
+  fclose(f);
+  return h;
+}
+
+/**
+ * Le fichier chemin (repertoire si rep, fichier ordinaire sinon, lien
+ * symbolique refuse) appartient-il a l'utilisateur, sans droit d'ecriture
+ * pour le groupe ni les autres ?
+ * @return 0, -1 sinon (message sur stderr)
+ */
+static inline int expression_sur(const char *chemin, int rep) {
+  struct stat s;
+  if (lstat(chemin, &s) != 0) {
+    fprintf(stderr, "Formule : %s inaccessible (%s)\n", chemin, strerror(errno));
+    return -1;
+  }
+  if ((rep ? !S_ISDIR(s.st_mode) : !S_ISREG(s.st_mode))
+      || s.st_uid != geteuid() || (s.st_mode & (S_IWGRP | S_IWOTH))) {
+    fprintf(stderr, "Formule : %s n'appartient pas a l'utilisateur ou est "
+            "modifiable par d'autres, rien n'est charge\n", chemin);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Repertoire des noyaux compiles, propre a l'utilisateur (cree au besoin).
+ * @return 0, -1 s'il n'est pas sur (voir expression_sur)
+ */
+static inline int expression_repertoire(char *rep, size_t n) {
+  const char *r = getenv("MANDEL_FORMULES"), *home = getenv("HOME");
+  const char *run = getenv("XDG_RUNTIME_DIR");
+  if (r != NULL) {
+    snprintf(rep, n, "%s", r);
+  } else if (home != NULL) {
+    snprintf(rep, n, "%s/.cache", home);
+    mkdir(rep, 0700);
+    snprintf(rep, n, "%s/.cache/mandel", home);
+  } else if (run != NULL) {
+    snprintf(rep, n, "%s/mandel-formules", run);
+  } else {
+    snprintf(rep, n, "/tmp/mandel-formules-%d", (int)geteuid());
+  }
+  mkdir(rep, 0700);
+  return expression_sur(rep, 1);
+}
+
+/**
+ * Compile source en bibliotheque partagee so avec la commande cmd ($CC,
+ * decoupe aux espaces, puis les options), sans passer par un shell.
+ * @return 0, -1 en cas d'echec
+ */
+static inline int expression_compiler(const char *cmd, const char *so, const char *source) {
+  char mots[4096], *args[64], *m;
+  int n = 0, etat;
+  pid_t pid;
+
+  snprintf(mots, sizeof(mots), "%s", cmd);
+  for (m = strtok(mots, " \t"); m != NULL && n < 60; m = strtok(NULL, " \t"))
+    args[n++] = m;
+  if (n == 0) return -1;
+  args[n++] = "-o";
+  args[n++] = (char *)so;
+  args[n++] = (char *)source;
+  args[n] = NULL;
+
+  fflush(NULL);
+  if ((pid = fork()) < 0) return -1;
+  if (pid == 0) {
+    execvp(args[0], args);
+    _exit(127);
+  }
+  while (waitpid(pid, &etat, 0) < 0)
+    if (errno != EINTR) return -1;
+  return WIFEXITED(etat) && WEXITSTATUS(etat) == 0 ? 0 : -1;
+}
+
+/**
+ * Compile (si ce n'est deja fait) et charge le noyau de l'expression, en
+ * mode Julia si julia. A appeler avant toute region parallele.
+ * @return 0, -1 en cas d'erreur (message sur stderr, noyau inchange)
+ */
+static inline int expression_charger(const char *texte, int julia) {
+  char rep[512], base[768], source[800], tmp[800], cmd[4096];
+  const char *cc = getenv("CC");
+  char *src;
+  int complexe;
+  unsigned long long h;
+  struct stat s;
+  FILE *f;
+  void *bib;
+  expression_fn fn;
+
+  src = expression_source(texte, &complexe);
+  if (src == NULL) return -1;
+  if (cc == NULL) cc = "cc";
+  if (expression_repertoire(rep, sizeof(rep)) != 0) {
+    free(src);
+    return -1;
+  }
+  snprintf(cmd, sizeof(cmd),
+           "%s -O2 -march=native -ffp-contract=off -shared -fPIC", cc);
+  h = expression_hachage(cmd, expression_hachage(src, 0xcbf29ce484222325ULL));
+  h = expression_machine(h);
+  snprintf(base, sizeof(base), "%s/formule_%016llx", rep, h);
+  snprintf(expression_chemin, sizeof(expression_chemin), "%s.so", base);
+
+  if (stat(expression_chemin, &s) != 0) {
+    /* noms propres au processus, puis rename : plusieurs processus MPI
+     * peuvent compiler la meme formule en meme temps */
+    snprintf(source, sizeof(source), "%s.%d.c", base, (int)getpid());
+    snprintf(tmp, sizeof(tmp), "%s.%d.so", base, (int)getpid());
+    f = fopen(source, "w");
+    if (f == NULL || fputs(src, f) == EOF) {
+      fprintf(stderr, "Formule : ecriture de %s impossible (%s)\n",
+              source, strerror(errno));
+      if (f) fclose(f);
+      free(src);
+      return -1;
+    }
+    fclose(f);
+    if (expression_compiler(cmd, tmp, source) != 0) {
+      fprintf(stderr, "Formule : echec de la compilation (%s -o %s %s)\n",
+              cmd, tmp, source);
+      unlink(tmp);
+      unlink(source);
+      free(src);
+      return -1;
+    }
+    /* droits fixes : le masque de l'utilisateur ne doit pas rendre la
+     * bibliotheque modifiable par le groupe */
+    if (chmod(tmp, 0755) != 0 || rename(tmp, expression_chemin) != 0) {
+      fprintf(stderr, "Formule : %s ne peut devenir %s (%s)\n",
+              tmp, expression_chemin, strerror(errno));
+      unlink(tmp);
+      unlink(source);
+      free(src);
+      return -1;
+    }
+    snprintf(tmp, sizeof(tmp), "%s.c", base);
+    rename(source, tmp);
+  }
+  free(src);
+
+  if (expression_sur(expression_chemin, 0) != 0) return -1;
+  bib = dlopen(expression_chemin, RTLD_NOW | RTLD_LOCAL);
+  fn = bib ? (expression_fn)dlsym(bib, "formule_orbites") : NULL;
+  if (fn == NULL) {
+    fprintf(stderr, "Formule : chargement de %s impossible (%s)\n",
+            expression_chemin, dlerror());
+    return -1;
+  }
+  expression_noyau = fn;
+  expression_julia = julia != 0;
+  expression_complexe = complexe;
+  return 0;
+}
+
+/* Le noyau charge, avec la signature de noyau_formule */
+static inline void expression_orbites(const double *pa, const double *pb, int np,
+                                      int debut, int prof, int *iter,
+                                      periode_stats *st, orbite *orb) {
+  expression_noyau(pa, pb, np, debut, prof, iter, st, orb, noyau_periode,
+                   noyau_periode_eps, expression_julia,
+                   noyau_julia_a, noyau_julia_b);
+}
+
+#endif /*!_mandel_expression_h*/
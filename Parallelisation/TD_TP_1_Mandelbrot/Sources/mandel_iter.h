@@ -0,0 +1,125 @@
+/*
+ * Fichier d'iterations : les nombres d'iterations bruts d'une image, a
+ * cote de l'image coloriee, pour changer de palette ou de coloriage
+ * (programme recolorier) sans recalculer la fractale.
+ *
+ * Format (ordre des octets de la machine) :
+ *   entete  : magie "MITR", version, octets par pixel (2 ou 4), w, h,
+ *             prof, puis le domaine xmin ymin xmax ymax en double
+ *   donnees : w*h nombres d'iterations, ligne par ligne, sur 16 bits si
+ *             prof < 65536 (le cas courant), sur 32 bits sinon
+ *
+ * Un point de l'ensemble a prof iterations.
+ *
+ * Active par l'option -iter fichier des programmes de calcul.
+ */
+
+#ifndef _mandel_iter_h
+#define _mandel_iter_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ITER_MAGIE   "MITR"
+#define ITER_VERSION 1
+
+typedef struct {
+  char magie[4];
+  int version;
+  int octets;                     /* octets par pixel : 2 ou 4 */
+  int w, h;
+  int prof;
+  double xmin, ymin, xmax, ymax;
+} iter_entete;
+
+/* Entete d'une image w x h de profondeur prof sur le domaine donne */
+static inline iter_entete iter_entete_creer(int w, int h, int prof, double xmin,
+                                            double ymin, double xmax, double ymax) {
+  iter_entete e;
+  memset(&e, 0, sizeof(e));
+  memcpy(e.magie, ITER_MAGIE, 4);
+  e.version = ITER_VERSION;
+  e.octets = prof < 65536 ? 2 : 4;
+  e.w = w; e.h = h; e.prof = prof;
+  e.xmin = xmin; e.ymin = ymin; e.xmax = xmax; e.ymax = ymax;
+  return e;
+}
+
+/**
+ * Ecrit l'entete et les n nombres d'iterations iter[] (n = w*h, ou un
+ * morceau quand on ecrit ligne par ligne : entete NULL).
+ * @return 0, ou -1 en cas d'erreur d'ecriture
+ */
+static inline int iter_ecrire(FILE *fd, const iter_entete *e, int octets,
+                              const int *iter, long n) {
+  unsigned short tampon[4096];
+  long k, m;
+  int i;
+
+  if (e && fwrite(e, sizeof(*e), 1, fd) != 1) return -1;
+  if (octets == 4)
+    return fwrite(iter, sizeof(int), n, fd) == (size_t)n ? 0 : -1;
+  for (k = 0; k < n; k += m) {
+    m = n - k < 4096 ? n - k : 4096;
+    for (i = 0; i < m; i++) tampon[i] = (unsigned short)iter[k + i];
+    if (fwrite(tampon, sizeof(unsigned short), m, fd) != (size_t)m) return -1;
+  }
+  return 0;
+}
+
+/* Sauve l'image d'iterations complete dans le fichier nom */
+static inline void iter_sauver(const char *nom, const iter_entete *e, const int *iter) {
+  FILE *fd = fopen(nom, "w");
+  if (fd == NULL || iter_ecrire(fd, e, e->octets, iter, (long)e->w*e->h) != 0) {
+    fprintf(stderr, "erreur dans l'ecriture du fichier %s\n", nom);
+    exit(1);
+  }
+  fclose(fd);
+}
+
+/**
+ * Lit l'entete e et les nombres d'iterations depuis fd (nom pour les
+ * messages) ; fd reste place juste apres.
+ * @return les w*h nombres d'iterations (a liberer), NULL en cas d'erreur
+ */
+static inline int *iter_lire(FILE *fd, const char *nom, iter_entete *e) {
+  unsigned short *court;
+  int *iter = NULL;
+  long n, k;
+
+  if (fread(e, sizeof(*e), 1, fd) != 1 || memcmp(e->magie, ITER_MAGIE, 4) != 0
+      || e->version != ITER_VERSION || (e->octets != 2 && e->octets != 4)) {
+    fprintf(stderr, "%s n'est pas un fichier d'iterations\n", nom);
+    return NULL;
+  }
+  n = (long)e->w * e->h;
+  iter = (int *)malloc(n * sizeof(int));
+  if (iter != NULL && fread(iter, e->octets, n, fd) == (size_t)n) {
+    /* 16 bits : elargissement en place, de la fin vers le debut */
+    court = (unsigned short *)iter;
+    if (e->octets == 2)
+      for (k = n - 1; k >= 0; k--) iter[k] = court[k];
+  } else {
+    fprintf(stderr, "erreur dans la lecture du fichier %s\n", nom);
+    free(iter);
+    iter = NULL;
+  }
+  return iter;
+}
+
+/* Lit le fichier d'iterations nom (NULL en cas d'erreur) */
+static inline int *iter_charger(const char *nom, iter_entete *e) {
+  FILE *fd = fopen(nom, "r");
+  int *iter;
+
+  if (fd == NULL) {
+    fprintf(stderr, "fichier %s introuvable\n", nom);
+    return NULL;
+  }
+  iter = iter_lire(fd, nom, e);
+  fclose(fd);
+  return iter;
+}
+
+#endif /*!_mandel_iter_h*/
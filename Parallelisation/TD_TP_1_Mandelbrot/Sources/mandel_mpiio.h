@@ -0,0 +1,187 @@
+/*
+ * Ecriture parallele des resultats (option -mpiio) : au lieu de tout
+ * rassembler chez le maitre, chaque processus ecrit ses propres lignes a
+ * leur place dans le fichier, en un seul appel collectif
+ * (MPI_File_write_at_all). Le rang 0 ecrit l'entete (et la palette).
+ *
+ * Une vue (MPI_File_set_view) decrit les lignes du processus dans le
+ * fichier : elles sont triees, et les suites consecutives fusionnees en
+ * un seul morceau. Avec la symetrie, le processus qui a calcule une ligne
+ * ecrit aussi sa ligne miroir, depuis la meme memoire : le maitre ne garde
+ * que les lignes qu'il a calculees, jamais l'image entiere.
+ *
+ * mpiio_tampon garde, a la suite, les lignes d'un processus dont la part
+ * n'est pas connue d'avance (distribution dynamique).
+ */
+
+#ifndef _mandel_mpiio_h
+#define _mandel_mpiio_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+
+#include "mandel_iter.h"
+#include "mandel_symetrie.h"
+
+/* Une ligne a ecrire : sa place dans le fichier et dans la memoire */
+typedef struct {
+  long fichier, memoire;
+} mpiio_ligne;
+
+static inline int mpiio_comparer(const void *a, const void *b) {
+  long fa = ((const mpiio_ligne *)a)->fichier, fb = ((const mpiio_ligne *)b)->fichier;
+  return (fa > fb) - (fa < fb);
+}
+
+/**
+ * Ecrit collectivement (comm) le fichier nom : taille_entete octets
+ * d'entete (ceux du rang 0), puis h lignes de taille octets. L'appelant
+ * fournit ses n lignes donnees, de numeros lignes[] ; les lignes miroir
+ * (axe, -1 sans symetrie) n'y sont pas calculees et sont ecrites depuis
+ * leur ligne source. n < 0 : l'appelant a manque de memoire (rien n'est
+ * ecrit pour lui, l'appel collectif echoue partout).
+ * @return 0, -1 si l'ecriture echoue sur un processus
+ */
+static inline int mpiio_ecrire(MPI_Comm comm, const char *nom, const void *entete, int taille_entete,
+                               const void *donnees, int taille, const int *lignes, int n,
+                               int axe, int h) {
+  MPI_File f;
+  MPI_Datatype ligne, type_fichier, type_memoire;
+  /* au plus deux places (ligne et miroir) par ligne donnee */
+  long places = n > 0 ? 2*(long)n + 1 : 1;
+  mpiio_ligne *l = (mpiio_ligne *)malloc(places * sizeof(mpiio_ligne));
+  int *longueurs = (int *)malloc(places * sizeof(int));
+  MPI_Aint *dep_fichier = (MPI_Aint *)malloc(places * sizeof(MPI_Aint));
+  MPI_Aint *dep_memoire = (MPI_Aint *)malloc(places * sizeof(MPI_Aint));
+  int rang, erreur = 0, nl = 0, nb = 0, k;
+
+  MPI_Comm_rank(comm, &rang);
+  if (n < 0 || l == NULL || longueurs == NULL || dep_fichier == NULL || dep_memoire == NULL) {
+    erreur = 1;
+    n = 0;
+  }
+
+  /* Lignes calculees et leurs miroirs, dans l'ordre du fichier */
+  for (k = 0; k < n; k++) {
+    if (!symetrie_calculee(lignes[k], axe)) continue;
+    l[nl++] = (mpiio_ligne){ lignes[k], k };
+    if (axe >= 0 && 2*lignes[k] < axe && axe - lignes[k] < h)
+      l[nl++] = (mpiio_ligne){ axe - lignes[k], k };
+  }
+  qsort(l, nl, sizeof(mpiio_ligne), mpiio_comparer);
+  for (k = 0; k < nl; k++) {
+    if (nb > 0 && l[k].fichier == l[k-1].fichier + 1 && l[k].memoire == l[k-1].memoire + 1) {
+      longueurs[nb-1]++;
+      continue;
+    }
+    longueurs[nb] = 1;
+    dep_fichier[nb] = (MPI_Aint)l[k].fichier * taille;
+    dep_memoire[nb] = (MPI_Aint)l[k].memoire * taille;
+    nb++;
+  }
+
+  MPI_Type_contiguous(taille, MPI_BYTE, &ligne);
+  MPI_Type_create_hindexed(nb, longueurs, dep_fichier, ligne, &type_fichier);
+  MPI_Type_create_hindexed(nb, longueurs, dep_memoire, ligne, &type_memoire);
+  MPI_Type_commit(&type_fichier);
+  MPI_Type_commit(&type_memoire);
+
+  if (MPI_File_open(comm, (char *)nom, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                    MPI_INFO_NULL, &f) != MPI_SUCCESS) {
+    erreur = 1;
+  } else {
+    /* un fichier plus long, d'une image precedente, est tronque */
+    if (MPI_File_set_size(f, taille_entete + (MPI_Offset)h * taille) != MPI_SUCCESS)
+      erreur = 1;
+    if (rang == 0 && MPI_File_write_at(f, 0, (void *)entete, taille_entete, MPI_BYTE,
+                                       MPI_STATUS_IGNORE) != MPI_SUCCESS)
+      erreur = 1;
+    MPI_File_set_view(f, taille_entete, MPI_BYTE, type_fichier, "native", MPI_INFO_NULL);
+    if (MPI_File_write_at_all(f, 0, (void *)donnees, nb > 0, type_memoire,
+                              MPI_STATUS_IGNORE) != MPI_SUCCESS)
+      erreur = 1;
+    MPI_File_close(&f);
+  }
+
+  MPI_Type_free(&ligne);
+  MPI_Type_free(&type_fichier);
+  MPI_Type_free(&type_memoire);
+  free(l);
+  free(longueurs);
+  free(dep_fichier);
+  free(dep_memoire);
+
+  MPI_Allreduce(MPI_IN_PLACE, &erreur, 1, MPI_INT, MPI_MAX, comm);
+  if (erreur && rang == 0) fprintf(stderr, "erreur dans l'ecriture du fichier %s\n", nom);
+  return erreur ? -1 : 0;
+}
+
+/**
+ * Fichier d'iterations (mandel_iter.h) : entete e, puis les n lignes
+ * iter[] de e->w nombres d'iterations, sur e->octets octets chacun.
+ * @return 0, -1 si l'ecriture echoue
+ */
+static inline int mpiio_ecrire_iter(MPI_Comm comm, const char *nom, const iter_entete *e,
+                                    const int *iter, const int *lignes, int n, int axe) {
+  long k, m = (long)e->w * n;
+  unsigned short *court = NULL;
+  int r;
+
+  if (e->octets == 2) {
+    court = (unsigned short *)malloc((m + 1) * sizeof(unsigned short));
+    if (court == NULL) n = -1;
+    for (k = 0; k < m && court != NULL; k++) court[k] = (unsigned short)iter[k];
+  }
+  r = mpiio_ecrire(comm, nom, e, sizeof(*e), court ? (void *)court : (void *)iter,
+                   e->w * e->octets, lignes, n, axe, e->h);
+  free(court);
+  return r;
+}
+
+/* Lignes gardees par un processus : n lignes de w pixels, a la suite */
+typedef struct {
+  int w, iter_avec, n, max;
+  unsigned char *ima;
+  int *iter;                      /* NULL sans -iter */
+  int *lignes;                    /* numero de chaque ligne */
+} mpiio_tampon;
+
+static inline void mpiio_tampon_init(mpiio_tampon *t, int w, int iter_avec) {
+  t->w = w;
+  t->iter_avec = iter_avec;
+  t->n = t->max = 0;
+  t->ima = NULL;
+  t->iter = NULL;
+  t->lignes = NULL;
+}
+
+/**
+ * Reserve la place des n lignes i0..i0+n-1 (la capacite double au besoin).
+ * @return indice de la premiere dans le tampon, -1 si l'allocation echoue
+ */
+static inline long mpiio_reserver(mpiio_tampon *t, int i0, int n) {
+  int k;
+  if (t->n + n > t->max) {
+    int max = 2*t->max > t->n + n ? 2*t->max : t->n + n;
+    unsigned char *ima = (unsigned char *)realloc(t->ima, (long)t->w * max);
+    int *lignes = (int *)realloc(t->lignes, max * sizeof(int));
+    int *iter = t->iter_avec ? (int *)realloc(t->iter, (long)t->w * max * sizeof(int)) : NULL;
+    if (ima) t->ima = ima;
+    if (lignes) t->lignes = lignes;
+    if (iter) t->iter = iter;
+    if (ima == NULL || lignes == NULL || (t->iter_avec && iter == NULL)) return -1;
+    t->max = max;
+  }
+  for (k = 0; k < n; k++) t->lignes[t->n + k] = i0 + k;
+  t->n += n;
+  return t->n - n;
+}
+
+static inline void mpiio_tampon_liberer(mpiio_tampon *t) {
+  free(t->ima);
+  free(t->iter);
+  free(t->lignes);
+}
+
+#endif /*!_mandel_mpiio_h*/
@@ -0,0 +1,951 @@
+/*
+ * Noyaux de calcul de l'ensemble de Mandelbrot, communs aux versions
+ * sequentielle, MPI et OpenMP.
+ *
+ *  - xy2color()       : un point a la fois, en double scalaire
+ *  - xy2color_ligne() : une ligne complete (et xy2color_points() : des
+ *                       points quelconques), plusieurs points
+ *                       par registre vectoriel (2 en SSE2, 4 en AVX2,
+ *                       8 en AVX-512, 4 en extensions vectorielles GCC
+ *                       pour les machines non x86 comme le Raspberry Pi)
+ *  - xy2iter_*()      : idem, mais rendent les nombres d'iterations bruts
+ *                       (pour les sauver et recolorier sans recalcul)
+ *
+ * La variante vectorielle est choisie a l'execution selon le processeur ;
+ * la variable d'environnement MANDEL_SIMD (scalaire, generique, sse2,
+ * avx2, avx512) permet de l'imposer.
+ *
+ * Les points de la cardioide principale et du disque de periode 2 sont
+ * reconnus analytiquement avant la boucle (ils ne divergent jamais) :
+ * actif par defaut, desactive a la compilation par -DCARDIOIDE=0 ou a
+ * l'execution par l'option -nocardio (-cardio pour le reactiver).
+ *
+ * En option (-periode, ou -DPERIODICITE=1), la detection de periodicite
+ * de Brent arrete l'iteration des points dont l'orbite revient a moins de
+ * eps (-eps_periode) d'un point de reference rafraichi aux iterations 1,
+ * 2, 4, 8... Le point est alors declare interieur ; le nombre de points
+ * concernes, les iterations evitees et les periodes sont cumules dans
+ * noyau_stats.
+ *
+ * Les formules z^d + c et les ensembles de Julia ont leurs propres
+ * noyaux, instancies dans mandel_formule.h et appeles a la place des
+ * precedents par xy2iter_points() des que l'une est choisie.
+ *
+ * Chaque voie fait exactement les memes operations flottantes que
+ * xy2color(), dans le meme ordre : le resultat est identique au bit pres.
+ * Pour cela, les noyaux interdisent la fusion multiplication/addition
+ * (FMA) que gcc fait sinon des que la cible la permet (AVX-512, ARM).
+ *
+ * Les fonctions des en-tetes partages sont static inline : un programme
+ * n'en garde que celles qu'il appelle, sans avertissement pour les autres.
+ */
+
+#ifndef _mandel_noyau_h
+#define _mandel_noyau_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NOYAU_X86
+#endif
+
+/* Compile sans -fopenmp, les directives omp des en-tetes sont ignorees */
+#if !defined(_OPENMP) && defined(__GNUC__)
+#pragma GCC diagnostic ignored "-Wunknown-pragmas"
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__)
+#define SANS_FMA __attribute__((optimize("fp-contract=off")))
+#else
+#define SANS_FMA
+#endif
+
+#ifndef CARDIOIDE
+#define CARDIOIDE 1
+#endif
+
+/* Test de la cardioide et du disque de periode 2 (modifiable par option) */
+static int noyau_cardioide = CARDIOIDE;
+
+/**
+ * Test analytique d'appartenance a la cardioide principale ou au disque
+ * de periode 2 (centre -1, rayon 1/4). Ces points sont dans l'ensemble :
+ * xy2color() y retournerait 255 apres prof iterations.
+ * @return 1 si c=a+ib est dans l'une des deux regions, 0 sinon
+ */
+static inline int interieur(double a, double b) {
+  double q, ax;
+
+  if (!noyau_cardioide) return 0;
+  ax = a - 0.25;
+  q = ax*ax + b*b;
+  if (q*(q + ax) <= 0.25*b*b) return 1;
+  return (a + 1)*(a + 1) + b*b <= 0.0625;
+}
+
+#ifndef PERIODICITE
+#define PERIODICITE 0
+#endif
+#ifndef PERIODE_EPS
+#define PERIODE_EPS 1e-13
+#endif
+
+/* Detection de periodicite et tolerance (modifiables par option) */
+static int noyau_periode = PERIODICITE;
+static double noyau_periode_eps = PERIODE_EPS;
+
+/* Statistiques de la detection de periodicite */
+typedef struct {
+  long long pixels;   /* points declares interieurs par periodicite */
+  long long economie; /* iterations evitees (somme des prof - i) */
+  long long periodes; /* somme des periodes detectees */
+  long long periode_max;
+} periode_stats;
+
+/*
+ * Etat d'une orbite en cours, pour reprendre le calcul d'un point qui a
+ * atteint prof iterations sans diverger (xy2iter_orbites).
+ */
+typedef struct {
+  double a, b;            /* point c = a + i.b */
+  double x, y;            /* z apres prof iterations */
+  double xr, yr;          /* point de reference de la periodicite */
+  int actif;              /* ni diverge, ni interieur reconnu */
+} orbite;
+
+/*
+ * Formule autre que z^2 + c (mandel_formule.h) : noyau en double qui
+ * remplace tous les autres dans xy2iter_points() et xy2iter_orbites(),
+ * et constante k des ensembles de Julia. NULL : z^2 + c.
+ */
+typedef void (*orbites_fn)(const double *pa, const double *pb, int np,
+                           int debut, int prof, int *iter,
+                           periode_stats *st, orbite *orb);
+static orbites_fn noyau_formule = NULL;
+static double noyau_julia_a = 0., noyau_julia_b = 0.;
+
+/* Cumul sur toute l'image (mis a jour par periode_ajouter) */
+static periode_stats noyau_stats;
+
+/* n points detectes apres i iterations avec la periode donnee */
+static inline void periode_cumuler(periode_stats *st, int n, int i, int periode,
+                                   int prof) {
+  st->pixels += n;
+  st->economie += (long long)n * (prof - i);
+  st->periodes += (long long)n * periode;
+  if (periode > st->periode_max) st->periode_max = periode;
+}
+
+/* Ajoute des statistiques locales (a une ligne) au cumul de l'image */
+static inline void periode_ajouter(const periode_stats *st) {
+  if (st->pixels == 0) return;
+#pragma omp critical (noyau_stats)
+  {
+    noyau_stats.pixels += st->pixels;
+    noyau_stats.economie += st->economie;
+    noyau_stats.periodes += st->periodes;
+    if (st->periode_max > noyau_stats.periode_max)
+      noyau_stats.periode_max = st->periode_max;
+  }
+}
+
+/**
+ * Affiche les statistiques de periodicite d'une image de npix points.
+ */
+static inline void periode_afficher(const periode_stats *st, long long npix) {
+  fprintf(stderr, "Periodicite: %lld points interieurs detectes, "
+          "%lld iterations evitees (%.1f par point de l'image), "
+          "periode moyenne %.2f, max %lld\n",
+          st->pixels, st->economie, npix ? (double)st->economie / npix : 0.,
+          st->pixels ? (double)st->periodes / st->pixels : 0.,
+          st->periode_max);
+}
+
+/**
+ * Étant donnée les coordonnées d'un point \f$c=a+ib\f$ dans le plan
+ * complexe, la fonction retourne la couleur correspondante estimant
+ * à quelle distance de l'ensemble de mandelbrot le point est.
+ * Soit la suite complexe défini par:
+ * \f[
+ * \left\{\begin{array}{l}
+ * z_0 = 0 \\
+ * z_{n+1} = z_n^2 - c
+ * \end{array}\right.
+ * \f]
+ * le nombre d'itérations que la suite met pour diverger est le
+ * nombre \f$ n \f$ pour lequel \f$ |z_n| > 2 \f$.
+ * Ce nombre est ramené à une valeur entre 0 et 255 correspond ainsi a
+ * une couleur dans la palette des couleurs.
+ */
+
+SANS_FMA
+static inline int xy2iter(double a, double b, int prof, periode_stats *st) {
+  double x, y, temp, x2, y2, xr, yr;
+  int i, verif, iref;
+
+  if (interieur(a, b)) return prof;
+
+  x = y = 0.;
+  xr = yr = 0.;
+  verif = 1; iref = 0;
+  for( i=0; i<prof; i++) {
+    /* garder la valeur précédente de x qui va etre ecrase */
+    temp = x;
+    /* nouvelles valeurs de x et y */
+    x2 = x*x;
+    y2 = y*y;
+    x = x2 - y2 + a;
+    y = 2*temp*y + b;
+    if( x2 + y2 >= 4.0) break;
+    if (noyau_periode) {
+      /* retour pres du point de reference : orbite periodique */
+      if (fabs(x - xr) < noyau_periode_eps && fabs(y - yr) < noyau_periode_eps) {
+        periode_cumuler(st, 1, i + 1, i + 1 - iref, prof);
+        return prof;
+      }
+      if (i + 1 == verif) { xr = x; yr = y; iref = verif; verif *= 2; }
+    }
+  }
+  return i;
+}
+
+/* Conversion nombre d'iterations -> couleur */
+#define ITER2COLOR(i, prof) ((i)==(prof) ? 255 : (int)((i)%255))
+
+static inline unsigned char xy2color(double a, double b, int prof) {
+  periode_stats st = {0, 0, 0, 0};
+  int i = xy2iter(a, b, prof, &st);
+  periode_ajouter(&st);
+  return ITER2COLOR(i, prof);
+}
+
+/*
+ * Toutes les variantes ont la meme signature : nombre d'iterations des n
+ * points c_k = a[k] + i.b[k]. Les points sont quelconques : pixels d'une
+ * ligne, d'une colonne (Mariani-Silver) ou echantillons libres.
+ */
+typedef void (*points_fn)(const double *a, const double *b, int n,
+                          int prof, int *iter, periode_stats *st);
+
+static inline void points_scalaire(const double *a, const double *b, int n,
+                                   int prof, int *iter, periode_stats *st) {
+  int k;
+  for (k = 0; k < n; k++) iter[k] = xy2iter(a[k], b[k], prof, st);
+}
+
+/*
+ * Extensions vectorielles GCC : portable (ARM NEON, ou decoupage en
+ * scalaire par le compilateur si le materiel n'a pas de double vectoriel).
+ * Une voie qui diverge est masquee ; on s'arrete quand toutes ont diverge.
+ * Le test est !(x2+y2 >= 4) pour se comporter comme xy2color avec les NaN.
+ * Les voies interieures (cardioide, disque) partent deja masquees avec
+ * prof iterations, de meme que les voies en trop du dernier paquet quand
+ * n n'est pas multiple de la largeur : les petits paquets (Mariani-Silver)
+ * restent vectoriels. Toutes les variantes suivent ce schema.
+ * Pour la periodicite, toutes les voies actives ont fait le meme nombre
+ * d'iterations i+1 : le point de reference est rafraichi pour toutes a
+ * la fois, et une voie qui y revient est masquee avec prof iterations.
+ *
+ * Le noyau est ecrit une fois pour un type flottant T quelconque (NV voies,
+ * compteurs entiers I de la meme taille que T) : il est instancie en
+ * double (points_generique) et en float (points_float). La tolerance de
+ * periodicite ne descend pas sous EPS_MIN : en float, les cycles ne se
+ * referment qu'a quelques ulp pres. Le test |x - xr| < eps se fait sur
+ * les bits : sans bit de signe, un flottant se compare comme un entier, et
+ * le signe de |dx| - eps donne le masque (gcc ne vectorise pas les
+ * comparaisons de vecteurs flottants enchainees par &).
+ *
+ * nom##_orbites() peut aussi partir de debut > 0 iterations, depuis les
+ * orbites orb[] sauvees par un appel precedent avec prof = debut : le
+ * resultat est alors le meme qu'un calcul complet jusqu'a prof (meme
+ * calendrier des points de reference). Si orb n'est pas NULL, l'etat
+ * final de chaque point y est range.
+ *
+ * Le meme modele donne les formules z^D + c (Multibrot) et, si JULIA,
+ * les ensembles de Julia z^D + k (z_0 = c, k = noyau_julia_a + i.b) :
+ * D et JULIA sont des constantes, la puissance se deroule en D - 1
+ * produits complexes et les tests sur JULIA disparaissent a la
+ * compilation (voir mandel_formule.h). D = 2 sans JULIA refait exactement
+ * les operations de xy2color.
+ */
+#define NOYAU_POINTS_VECTEUR(nom, T, I, NV, EPS_MIN, ATTR)                  \
+  NOYAU_POINTS_FORMULE(nom, T, I, NV, EPS_MIN, ATTR, 2, 0)
+
+#define NOYAU_POINTS_FORMULE(nom, T, I, NV, EPS_MIN, ATTR, D, JULIA)        \
+typedef T nom##_vt __attribute__((vector_size(NV*sizeof(T))));             \
+typedef I nom##_vi __attribute__((vector_size(NV*sizeof(I))));             \
+                                                                            \
+ATTR SANS_FMA                                                               \
+static inline void nom##_orbites(const double *pa, const double *pb, int np, \
+                                 int debut, int prof, int *iter,            \
+                                 periode_stats *st, orbite *orb) {          \
+  int i, j, k;                                                              \
+  for (j = 0; j < np; j += NV) {                                            \
+    nom##_vt a, b, x, y, x2, y2, temp, xr, yr, dx, dy, zero = {0};          \
+    nom##_vt ka, kb, px, py;                                                \
+    nom##_vt quatre = zero + (T)4;                                          \
+    nom##_vt eps = zero + (T)fmax(noyau_periode_eps, EPS_MIN);              \
+    nom##_vi actif, cpt, retour, izero = {0};                               \
+    nom##_vi absmasque = izero + (I)(~0ULL >> (65 - 8*sizeof(I)));          \
+    nom##_vi ieps = (nom##_vi)eps;                                          \
+    I n;                                                                    \
+    int verif = 1, iref = 0, e;                                             \
+                                                                            \
+    while (verif <= debut) { iref = verif; verif *= 2; }                    \
+    x = y = xr = yr = zero;                                                 \
+    for (k = 0; k < NV; k++) {                                              \
+      a[k] = j + k < np ? (T)pa[j+k] : 0;                                   \
+      b[k] = j + k < np ? (T)pb[j+k] : 0;                                   \
+      if (debut > 0 && j + k < np) {                                        \
+        x[k] = (T)orb[j+k].x; y[k] = (T)orb[j+k].y;                         \
+        xr[k] = (T)orb[j+k].xr; yr[k] = (T)orb[j+k].yr;                     \
+        cpt[k] = orb[j+k].actif ? debut : prof;                             \
+      } else {                                                              \
+        cpt[k] = j + k >= np                                                \
+                 || (D == 2 && !JULIA && interieur(pa[j+k], pb[j+k]))       \
+                 ? prof : 0;                                                \
+      }                                                                     \
+      actif[k] = cpt[k] == prof ? 0 : -1;                                   \
+    }                                                                       \
+    ka = a; kb = b;                                                         \
+    if (JULIA) {                                                            \
+      if (debut == 0) { x = a; y = b; }                                     \
+      ka = zero + (T)noyau_julia_a;                                         \
+      kb = zero + (T)noyau_julia_b;                                         \
+    }                                                                       \
+    for (i = debut; i < prof; i++) {                                        \
+      x2 = x*x;                                                             \
+      y2 = y*y;                                                             \
+      actif &= ~(x2 + y2 >= quatre);                                        \
+      if (memcmp(&actif, &izero, sizeof(actif)) == 0) break;               \
+      cpt -= actif;                                                         \
+      if (D == 2) {                                                         \
+        temp = x;                                                           \
+        x = x2 - y2 + ka;                                                   \
+        y = 2*temp*y + kb;                                                  \
+      } else {                                                              \
+        px = x2 - y2;                                                       \
+        py = 2*x*y;                                                         \
+        _Pragma("GCC unroll 16")                                            \
+        for (e = 2; e < D; e++) {                                           \
+          temp = px*x - py*y;                                               \
+          py = px*y + py*x;                                                 \
+          px = temp;                                                        \
+        }                                                                   \
+        x = px + ka;                                                        \
+        y = py + kb;                                                        \
+      }                                                                     \
+      if (noyau_periode) {                                                  \
+        dx = x - xr;                                                        \
+        dy = y - yr;                                                        \
+        retour = actif & ((((nom##_vi)dx & absmasque) - ieps)               \
+                        & (((nom##_vi)dy & absmasque) - ieps))              \
+                         >> (8*sizeof(I) - 1);                              \
+        if (memcmp(&retour, &izero, sizeof(retour)) != 0) {                 \
+          for (n = 0, k = 0; k < NV; k++)                                   \
+            if (retour[k]) { cpt[k] = prof; n++; }                          \
+          periode_cumuler(st, n, i + 1, i + 1 - iref, prof);                \
+          actif &= ~retour;                                                 \
+        }                                                                   \
+        if (i + 1 == verif) { xr = x; yr = y; iref = verif; verif *= 2; }   \
+      }                                                                     \
+    }                                                                       \
+    for (k = 0; k < NV && j + k < np; k++) iter[j+k] = cpt[k];              \
+    for (k = 0; orb && k < NV && j + k < np; k++) {                         \
+      orb[j+k].x = x[k]; orb[j+k].y = y[k];                                 \
+      orb[j+k].xr = xr[k]; orb[j+k].yr = yr[k];                             \
+      orb[j+k].actif = actif[k] != 0;                                       \
+    }                                                                       \
+  }                                                                         \
+}                                                                           \
+                                                                            \
+static inline void nom(const double *pa, const double *pb, int np,          \
+                       int prof, int *iter, periode_stats *st) {            \
+  nom##_orbites(pa, pb, np, 0, prof, iter, st, NULL);                       \
+}
+
+NOYAU_POINTS_VECTEUR(points_generique, double, long long, 4, 0., )
+
+/*
+ * En float, deux fois plus de voies par registre : 16 en AVX-512. Sur x86
+ * gcc en compile une version par jeu d'instructions (target_clones),
+ * choisie au chargement du programme.
+ */
+#ifdef NOYAU_X86
+#define NOYAU_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define NOYAU_CLONES
+#endif
+
+NOYAU_POINTS_VECTEUR(points_float, float, int, 16, 16*FLT_EPSILON, NOYAU_CLONES)
+
+/* En double sur 8 voies, pour les orbites reprenables */
+NOYAU_POINTS_VECTEUR(points_double, double, long long, 8, 0., NOYAU_CLONES)
+
+#ifdef NOYAU_X86
+
+__attribute__((target("sse2"))) SANS_FMA
+static inline void points_sse2(const double *pa, const double *pb, int np,
+                               int prof, int *iter, periode_stats *st) {
+  double xa[2] __attribute__((aligned(16)));
+  double ya[2] __attribute__((aligned(16)));
+  double ca[2] __attribute__((aligned(16)));
+  int i, j, k;
+  for (j = 0; j < np; j += 2) {
+    __m128d a, b, x, y, x2, y2, temp, actif, cpt, xr, yr, retour;
+    const __m128d deux = _mm_set1_pd(2.);
+    const __m128d quatre = _mm_set1_pd(4.), un = _mm_set1_pd(1.);
+    const __m128d eps = _mm_set1_pd(noyau_periode_eps), vprof = _mm_set1_pd(prof);
+    const __m128d absmasque = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+    int verif = 1, iref = 0, n;
+
+    for (k = 0; k < 2; k++) {
+      xa[k] = j + k < np ? pa[j+k] : 0.;
+      ya[k] = j + k < np ? pb[j+k] : 0.;
+      ca[k] = j + k >= np || interieur(xa[k], ya[k]) ? prof : 0;
+    }
+    a = _mm_load_pd(xa);
+    b = _mm_load_pd(ya);
+    cpt = _mm_load_pd(ca);
+    x = y = xr = yr = _mm_setzero_pd();
+    actif = _mm_cmpeq_pd(cpt, x);
+    for (i = 0; i < prof; i++) {
+      x2 = _mm_mul_pd(x, x);
+      y2 = _mm_mul_pd(y, y);
+      actif = _mm_and_pd(actif, _mm_cmpnge_pd(_mm_add_pd(x2, y2), quatre));
+      if (_mm_movemask_pd(actif) == 0) break;
+      cpt = _mm_add_pd(cpt, _mm_and_pd(actif, un));
+      temp = x;
+      x = _mm_add_pd(_mm_sub_pd(x2, y2), a);
+      y = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(deux, temp), y), b);
+      if (noyau_periode) {
+        retour = _mm_and_pd(actif, _mm_and_pd(
+                   _mm_cmplt_pd(_mm_and_pd(_mm_sub_pd(x, xr), absmasque), eps),
+                   _mm_cmplt_pd(_mm_and_pd(_mm_sub_pd(y, yr), absmasque), eps)));
+        n = _mm_movemask_pd(retour);
+        if (n) {
+          periode_cumuler(st, __builtin_popcount(n), i + 1, i + 1 - iref, prof);
+          cpt = _mm_or_pd(_mm_andnot_pd(retour, cpt), _mm_and_pd(retour, vprof));
+          actif = _mm_andnot_pd(retour, actif);
+        }
+        if (i + 1 == verif) { xr = x; yr = y; iref = verif; verif *= 2; }
+      }
+    }
+    _mm_store_pd(ca, cpt);
+    for (k = 0; k < 2 && j + k < np; k++) iter[j+k] = (int)ca[k];
+  }
+}
+
+__attribute__((target("avx2"))) SANS_FMA
+static inline void points_avx2(const double *pa, const double *pb, int np,
+                               int prof, int *iter, periode_stats *st) {
+  double xa[4] __attribute__((aligned(32)));
+  double ya[4] __attribute__((aligned(32)));
+  double ca[4] __attribute__((aligned(32)));
+  int i, j, k;
+  for (j = 0; j < np; j += 4) {
+    __m256d a, b, x, y, x2, y2, temp, actif, cpt, xr, yr, retour;
+    const __m256d deux = _mm256_set1_pd(2.);
+    const __m256d quatre = _mm256_set1_pd(4.), un = _mm256_set1_pd(1.);
+    const __m256d eps = _mm256_set1_pd(noyau_periode_eps), vprof = _mm256_set1_pd(prof);
+    const __m256d absmasque = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+    int verif = 1, iref = 0, n;
+
+    for (k = 0; k < 4; k++) {
+      xa[k] = j + k < np ? pa[j+k] : 0.;
+      ya[k] = j + k < np ? pb[j+k] : 0.;
+      ca[k] = j + k >= np || interieur(xa[k], ya[k]) ? prof : 0;
+    }
+    a = _mm256_load_pd(xa);
+    b = _mm256_load_pd(ya);
+    cpt = _mm256_load_pd(ca);
+    x = y = xr = yr = _mm256_setzero_pd();
+    actif = _mm256_cmp_pd(cpt, x, _CMP_EQ_OQ);
+    for (i = 0; i < prof; i++) {
+      x2 = _mm256_mul_pd(x, x);
+      y2 = _mm256_mul_pd(y, y);
+      actif = _mm256_and_pd(actif,
+                _mm256_cmp_pd(_mm256_add_pd(x2, y2), quatre, _CMP_NGE_UQ));
+      if (_mm256_movemask_pd(actif) == 0) break;
+      cpt = _mm256_add_pd(cpt, _mm256_and_pd(actif, un));
+      temp = x;
+      x = _mm256_add_pd(_mm256_sub_pd(x2, y2), a);
+      y = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(deux, temp), y), b);
+      if (noyau_periode) {
+        retour = _mm256_and_pd(actif, _mm256_and_pd(
+                   _mm256_cmp_pd(_mm256_and_pd(_mm256_sub_pd(x, xr), absmasque), eps, _CMP_LT_OQ),
+                   _mm256_cmp_pd(_mm256_and_pd(_mm256_sub_pd(y, yr), absmasque), eps, _CMP_LT_OQ)));
+        n = _mm256_movemask_pd(retour);
+        if (n) {
+          periode_cumuler(st, __builtin_popcount(n), i + 1, i + 1 - iref, prof);
+          cpt = _mm256_blendv_pd(cpt, vprof, retour);
+          actif = _mm256_andnot_pd(retour, actif);
+        }
+        if (i + 1 == verif) { xr = x; yr = y; iref = verif; verif *= 2; }
+      }
+    }
+    _mm256_store_pd(ca, cpt);
+    for (k = 0; k < 4 && j + k < np; k++) iter[j+k] = (int)ca[k];
+  }
+}
+
+__attribute__((target("avx512f"))) SANS_FMA
+static inline void points_avx512(const double *pa, const double *pb, int np,
+                                 int prof, int *iter, periode_stats *st) {
+  double xa[8] __attribute__((aligned(64)));
+  double ya[8] __attribute__((aligned(64)));
+  double ca[8] __attribute__((aligned(64)));
+  int i, j, k;
+  for (j = 0; j < np; j += 8) {
+    __m512d a, b, x, y, x2, y2, temp, cpt, xr, yr;
+    __mmask8 actif, retour;
+    const __m512d deux = _mm512_set1_pd(2.);
+    const __m512d quatre = _mm512_set1_pd(4.), un = _mm512_set1_pd(1.);
+    const __m512d eps = _mm512_set1_pd(noyau_periode_eps), vprof = _mm512_set1_pd(prof);
+    int verif = 1, iref = 0;
+
+    for (k = 0; k < 8; k++) {
+      xa[k] = j + k < np ? pa[j+k] : 0.;
+      ya[k] = j + k < np ? pb[j+k] : 0.;
+      ca[k] = j + k >= np || interieur(xa[k], ya[k]) ? prof : 0;
+    }
+    a = _mm512_load_pd(xa);
+    b = _mm512_load_pd(ya);
+    cpt = _mm512_load_pd(ca);
+    x = y = xr = yr = _mm512_setzero_pd();
+    actif = _mm512_cmp_pd_mask(cpt, x, _CMP_EQ_OQ);
+    for (i = 0; i < prof; i++) {
+      x2 = _mm512_mul_pd(x, x);
+      y2 = _mm512_mul_pd(y, y);
+      actif = _mm512_mask_cmp_pd_mask(actif, _mm512_add_pd(x2, y2), quatre,
+                                      _CMP_NGE_UQ);
+      if (actif == 0) break;
+      cpt = _mm512_mask_add_pd(cpt, actif, cpt, un);
+      temp = x;
+      x = _mm512_add_pd(_mm512_sub_pd(x2, y2), a);
+      y = _mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(deux, temp), y), b);
+      if (noyau_periode) {
+        retour = _mm512_mask_cmp_pd_mask(actif,
+                   _mm512_abs_pd(_mm512_sub_pd(x, xr)), eps, _CMP_LT_OQ);
+        retour = _mm512_mask_cmp_pd_mask(retour,
+                   _mm512_abs_pd(_mm512_sub_pd(y, yr)), eps, _CMP_LT_OQ);
+        if (retour) {
+          periode_cumuler(st, __builtin_popcount(retour), i + 1, i + 1 - iref, prof);
+          cpt = _mm512_mask_mov_pd(cpt, retour, vprof);
+          actif &= ~retour;
+        }
+        if (i + 1 == verif) { xr = x; yr = y; iref = verif; verif *= 2; }
+      }
+    }
+    _mm512_store_pd(ca, cpt);
+    for (k = 0; k < 8 && j + k < np; k++) iter[j+k] = (int)ca[k];
+  }
+}
+
+#endif /* NOYAU_X86 */
+
+/*
+ * Niveaux de precision. Chaque iteration commet une erreur d'arrondi de
+ * l'ordre de u * max(2, |coordonnees|) (u : 2^-24 en float, 2^-53 en
+ * double, ~2^-100 en double-double), qui se propage comme un deplacement
+ * de c : au pire, les prof erreurs s'ajoutent. Le calcul est fiable tant
+ * que u * max(2, |coordonnees|) * prof reste petit devant le pas de la
+ * grille. En automatique, on prend le type le plus rapide dont l'erreur
+ * est sous PRECISION_SEUIL pas : float seulement pour les vues larges et
+ * les petites profondeurs (prof < ~40 sur [-2,2]^2 en 800x800), double
+ * jusqu'a un pas de ~1e-13 * prof, double-double au dela. Quand le pas
+ * approche l'ulp des coordonnees, il faut mandel_profond (perturbations).
+ */
+#define PRECISION_AUTO   0
+#define PRECISION_FLOAT  1
+#define PRECISION_DOUBLE 2
+#define PRECISION_DD     3
+
+#ifndef PRECISION_SEUIL
+#define PRECISION_SEUIL 1e-3
+#endif
+
+static const char *precision_noms[] = { "auto", "float", "double", "double-double" };
+static const double precision_u[] = { 0., 0x1p-24, 0x1p-53, 0x1p-100 };
+
+/* Precision retenue (double tant que precision_choisir n'est pas appelee) */
+static int noyau_precision = PRECISION_DOUBLE;
+static double noyau_precision_erreur = 0.;
+
+/**
+ * Nom d'une precision (option -precision).
+ * @return code PRECISION_*, PRECISION_AUTO si le nom est inconnu
+ */
+static inline int precision_depuis_nom(const char *nom) {
+  int p;
+  for (p = PRECISION_FLOAT; p <= PRECISION_DD; p++)
+    if (strcmp(nom, precision_noms[p]) == 0) return p;
+  if (strcmp(nom, "dd") == 0) return PRECISION_DD;
+  if (strcmp(nom, "auto") != 0)
+    fprintf(stderr, "Precision %s inconnue, choix automatique\n", nom);
+  return PRECISION_AUTO;
+}
+
+/**
+ * Fixe noyau_precision (demande, ou le choix automatique d'apres le pas,
+ * l'etendue du domaine et la profondeur) et l'erreur estimee, en pas de
+ * grille. Toujours double avec une formule autre que z^2 + c.
+ */
+static inline void precision_choisir(int demande, double xmin, double ymin,
+                                     double xmax, double ymax,
+                                     double xinc, double yinc, int prof) {
+  double m = 2., pas = fmin(fabs(xinc), fabs(yinc));
+  int p = demande;
+
+  m = fmax(m, fmax(fmax(fabs(xmin), fabs(xmax)), fmax(fabs(ymin), fabs(ymax))));
+  m *= prof > 1 ? prof : 1;
+  if (p == PRECISION_AUTO)
+    for (p = PRECISION_FLOAT; p < PRECISION_DD; p++)
+      if (precision_u[p] * m <= PRECISION_SEUIL * pas) break;
+  if (noyau_formule != NULL) p = PRECISION_DOUBLE;
+  noyau_precision = p;
+  noyau_precision_erreur = precision_u[p] * m / pas;
+}
+
+static inline void precision_afficher(void) {
+  fprintf(stderr, "Precision: %s (erreur estimee %.2g pas)\n",
+          precision_noms[noyau_precision], noyau_precision_erreur);
+  if (noyau_precision_erreur > PRECISION_SEUIL)
+    fprintf(stderr, "Attention : pas trop petit pour cette precision, "
+            "voir mandel_profond\n");
+}
+
+/*
+ * Arithmetique double-double : un reel est la somme non evaluee hi + lo
+ * de deux double (~106 bits). Les macros s'appliquent aux scalaires comme
+ * aux vecteurs GCC. Le produit exact utilise la separation de Dekker, qui
+ * suppose qu'aucune multiplication/addition n'est fusionnee (SANS_FMA).
+ */
+#define DD_SEP 134217729.   /* 2^27 + 1 */
+
+/* s + e = a + b exactement */
+#define DD_SOMME(a, b, s, e) do {                                           \
+    __typeof__(s) _v;                                                       \
+    s = (a) + (b); _v = s - (a);                                            \
+    e = ((a) - (s - _v)) + ((b) - _v);                                      \
+  } while (0)
+
+/* idem si |a| >= |b| */
+#define DD_SOMME_RAPIDE(a, b, s, e) do {                                    \
+    s = (a) + (b); e = (b) - (s - (a));                                     \
+  } while (0)
+
+/* p + e = a * b exactement */
+#define DD_PRODUIT(a, b, p, e) do {                                         \
+    __typeof__(p) _ah, _al, _bh, _bl, _t;                                   \
+    _t = DD_SEP*(a); _ah = _t - (_t - (a)); _al = (a) - _ah;                \
+    _t = DD_SEP*(b); _bh = _t - (_t - (b)); _bl = (b) - _bh;                \
+    p = (a)*(b);                                                            \
+    e = ((_ah*_bh - p) + _ah*_bl + _al*_bh) + _al*_bl;                      \
+  } while (0)
+
+/* (rh,rl) = (ah,al) * (bh,bl) */
+#define DD_MUL(ah, al, bh, bl, rh, rl) do {                                 \
+    __typeof__(rh) _p, _e;                                                  \
+    DD_PRODUIT(ah, bh, _p, _e);                                             \
+    _e += (ah)*(bl) + (al)*(bh);                                            \
+    DD_SOMME_RAPIDE(_p, _e, rh, rl);                                        \
+  } while (0)
+
+/* (rh,rl) = (ah,al) + (bh,bl) */
+#define DD_ADD(ah, al, bh, bl, rh, rl) do {                                 \
+    __typeof__(rh) _s, _e;                                                  \
+    DD_SOMME(ah, bh, _s, _e);                                               \
+    _e += (al) + (bl);                                                      \
+    DD_SOMME_RAPIDE(_s, _e, rh, rl);                                        \
+  } while (0)
+
+/* Grille de pixels : le pixel (i,j) est le point (xmin + j*xinc, ymin + i*yinc) */
+typedef struct {
+  double xmin, xinc;
+  double ymin, yinc;
+} grille;
+
+/* (h,l) = min + k*inc en double-double */
+#define DD_GRILLE(min, inc, k, h, l) do {                                   \
+    double _p, _q;                                                          \
+    DD_PRODUIT((double)(k), inc, _p, _q);                                   \
+    DD_ADD(min, 0., _p, _q, h, l);                                          \
+  } while (0)
+
+#define NV_DD 4
+typedef double vdd __attribute__((vector_size(NV_DD*sizeof(double))));
+typedef long long vddl __attribute__((vector_size(NV_DD*sizeof(long long))));
+
+/*
+ * w pixels j0, j0+pas, j0+2.pas... de la ligne i en double-double, meme
+ * schema que les noyaux vectoriels. Le test de divergence et la periodicite ne regardent
+ * que les parties hautes.
+ */
+NOYAU_CLONES SANS_FMA
+static inline void ligne_dd(const grille *g, int i, int j0, int pas, int w, int prof,
+                            int *iter, periode_stats *st) {
+  double bh, bl;
+  int it, j, k;
+
+  DD_GRILLE(g->ymin, g->yinc, i, bh, bl);
+  for (j = 0; j < w; j += NV_DD) {
+    vdd ah, al, xh, xl, yh, yl, x2h, x2l, y2h, y2l, xyh, xyl, th, tl;
+    vdd xr, yr, dx, dy, zero = {0};
+    vdd vbh = zero + bh, vbl = zero + bl;
+    vdd quatre = zero + 4., eps = zero + noyau_periode_eps;
+    vddl actif, cpt, retour;
+    long long n;
+    int verif = 1, iref = 0;
+
+    for (k = 0; k < NV_DD; k++) {
+      double h = 0., l = 0.;
+      if (j + k < w) DD_GRILLE(g->xmin, g->xinc, j0 + (j + k)*pas, h, l);
+      ah[k] = h; al[k] = l;
+      cpt[k] = j + k >= w || interieur(h, bh) ? prof : 0;
+      actif[k] = cpt[k] ? 0 : -1;
+    }
+    xh = xl = yh = yl = xr = yr = zero;
+    for (it = 0; it < prof; it++) {
+      DD_MUL(xh, xl, xh, xl, x2h, x2l);
+      DD_MUL(yh, yl, yh, yl, y2h, y2l);
+      actif &= ~(x2h + y2h >= quatre);
+      for (n = 0, k = 0; k < NV_DD; k++) n |= actif[k];
+      if (n == 0) break;
+      cpt -= actif;
+      DD_MUL(xh, xl, yh, yl, xyh, xyl);
+      DD_ADD(x2h, x2l, -y2h, -y2l, th, tl);
+      DD_ADD(th, tl, ah, al, xh, xl);
+      DD_ADD(2*xyh, 2*xyl, vbh, vbl, yh, yl);
+      if (noyau_periode) {
+        dx = xh - xr;
+        dy = yh - yr;
+        retour = actif & (dx < eps) & (dx > -eps) & (dy < eps) & (dy > -eps);
+        for (n = 0, k = 0; k < NV_DD; k++) n += retour[k] != 0;
+        if (n) {
+          periode_cumuler(st, n, it + 1, it + 1 - iref, prof);
+          for (k = 0; k < NV_DD; k++) if (retour[k]) cpt[k] = prof;
+          actif &= ~retour;
+        }
+        if (it + 1 == verif) { xr = xh; yr = yh; iref = verif; verif *= 2; }
+      }
+    }
+    for (k = 0; k < NV_DD && j + k < w; k++) iter[j+k] = cpt[k];
+  }
+}
+
+static points_fn points_choisie = NULL;
+static const char *points_nom = NULL;
+
+/**
+ * Choisit la variante de xy2iter_points() d'apres le processeur (ou
+ * MANDEL_SIMD). A appeler une fois avant toute region parallele.
+ * @return nom de la variante retenue
+ */
+static inline const char *noyau_choisir(void) {
+  const char *force = getenv("MANDEL_SIMD");
+
+  points_choisie = points_generique;
+  points_nom = "generique";
+#ifdef NOYAU_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    points_choisie = points_avx512; points_nom = "avx512";
+  } else if (__builtin_cpu_supports("avx2")) {
+    points_choisie = points_avx2; points_nom = "avx2";
+  } else if (__builtin_cpu_supports("sse2")) {
+    points_choisie = points_sse2; points_nom = "sse2";
+  }
+#endif
+
+  if (force != NULL) {
+    if (strcmp(force, "scalaire") == 0) {
+      points_choisie = points_scalaire; points_nom = "scalaire";
+    } else if (strcmp(force, "generique") == 0) {
+      points_choisie = points_generique; points_nom = "generique";
+#ifdef NOYAU_X86
+    } else if (strcmp(force, "sse2") == 0) {
+      points_choisie = points_sse2; points_nom = "sse2";
+    } else if (strcmp(force, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+      points_choisie = points_avx2; points_nom = "avx2";
+    } else if (strcmp(force, "avx512") == 0 && __builtin_cpu_supports("avx512f")) {
+      points_choisie = points_avx512; points_nom = "avx512";
+#endif
+    } else {
+      fprintf(stderr, "MANDEL_SIMD=%s non disponible, variante %s\n",
+              force, points_nom);
+    }
+  }
+  return points_nom;
+}
+
+/**
+ * Nom du noyau reellement utilise par xy2iter_points() et xy2iter_grille()
+ * apres formule_options() et precision_choisir() : la variante de
+ * noyau_choisir() en double, sinon le noyau de la formule ou de la
+ * precision choisie et son clone (celui que prend le chargeur).
+ */
+static inline const char *noyau_nom(void) {
+  static char nom[64];
+  const char *clone = "default";
+
+  if (points_choisie == NULL) noyau_choisir();
+  if (noyau_formule == NULL && noyau_precision == PRECISION_DOUBLE)
+    return points_nom;
+#ifdef NOYAU_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) clone = "avx512f";
+  else if (__builtin_cpu_supports("avx2")) clone = "avx2";
+#endif
+  snprintf(nom, sizeof(nom), "%s (%s)",
+           noyau_formule != NULL ? "formule, double 8 voies"
+           : noyau_precision == PRECISION_FLOAT ? "float 16 voies"
+           : "double-double 4 voies", clone);
+  return nom;
+}
+
+/* Nombre de points traites par appel au noyau (tampons sur la pile) */
+#define NOYAU_BLOC 256
+
+/**
+ * Nombre d'iterations des n points c_k = a[k] + i.b[k] (comme xy2iter),
+ * en float si c'est la precision choisie, en double sinon ; avec le
+ * noyau de la formule choisie s'il y en a une.
+ */
+static inline void xy2iter_points(const double *a, const double *b, int n,
+                                  int prof, int *iter) {
+  periode_stats st = {0, 0, 0, 0};
+  if (points_choisie == NULL) noyau_choisir();
+  if (noyau_formule != NULL)
+    noyau_formule(a, b, n, 0, prof, iter, &st, NULL);
+  else if (noyau_precision == PRECISION_FLOAT)
+    points_float(a, b, n, prof, iter, &st);
+  else
+    points_choisie(a, b, n, prof, iter, &st);
+  periode_ajouter(&st);
+}
+
+/**
+ * Nombres d'iterations des n orbites orb[] (points orb[k].a + i.orb[k].b),
+ * de debut a prof iterations (voir NOYAU_POINTS_VECTEUR) ; l'etat final
+ * est range dans orb[]. En float ou en double seulement.
+ */
+static inline void xy2iter_orbites(orbite *orb, int n, int debut, int prof, int *iter) {
+  double pa[NOYAU_BLOC], pb[NOYAU_BLOC];
+  periode_stats st = {0, 0, 0, 0};
+  int j, k, m;
+  for (j = 0; j < n; j += m) {
+    m = n - j < NOYAU_BLOC ? n - j : NOYAU_BLOC;
+    for (k = 0; k < m; k++) {
+      pa[k] = orb[j+k].a;
+      pb[k] = orb[j+k].b;
+    }
+    if (noyau_formule != NULL)
+      noyau_formule(pa, pb, m, debut, prof, iter + j, &st, orb + j);
+    else if (noyau_precision == PRECISION_FLOAT)
+      points_float_orbites(pa, pb, m, debut, prof, iter + j, &st, orb + j);
+    else
+      points_double_orbites(pa, pb, m, debut, prof, iter + j, &st, orb + j);
+  }
+  periode_ajouter(&st);
+}
+
+/* Conversion de n nombres d'iterations en couleurs */
+static inline void iter2color(const int *iter, int n, int prof, unsigned char *coul) {
+  int k;
+  for (k = 0; k < n; k++) coul[k] = ITER2COLOR(iter[k], prof);
+}
+
+/**
+ * Couleurs des n points c_k = a[k] + i.b[k] : coul[k] = xy2color(a[k], b[k], prof).
+ */
+static inline void xy2color_points(const double *a, const double *b, int n,
+                                   int prof, unsigned char *coul) {
+  int iter[NOYAU_BLOC], j, m;
+  for (j = 0; j < n; j += m) {
+    m = n - j < NOYAU_BLOC ? n - j : NOYAU_BLOC;
+    xy2iter_points(a + j, b + j, m, prof, iter);
+    iter2color(iter, m, prof, coul + j);
+  }
+}
+
+/*
+ * Remplit les m points (x_k, b) d'un morceau de ligne, x_{k+1} = x_k + xinc.
+ * @return l'abscisse du point suivant
+ */
+static inline double ligne_points(double x, double xinc, double b, int m,
+                                  double *pa, double *pb) {
+  int k;
+  for (k = 0; k < m; k++) {
+    pa[k] = x;
+    pb[k] = b;
+    x += xinc;
+  }
+  return x;
+}
+
+/**
+ * Calcule une ligne de w pixels : ligne[j] = xy2color(x_j, b, prof) avec
+ * x_0 = xmin et x_{j+1} = x_j + xinc.
+ */
+static inline void xy2color_ligne(double xmin, double xinc, double b, int w,
+                                  int prof, unsigned char *ligne) {
+  double pa[NOYAU_BLOC], pb[NOYAU_BLOC];
+  int j, m;
+  for (j = 0; j < w; j += m) {
+    m = w - j < NOYAU_BLOC ? w - j : NOYAU_BLOC;
+    xmin = ligne_points(xmin, xinc, b, m, pa, pb);
+    xy2color_points(pa, pb, m, prof, ligne + j);
+  }
+}
+
+/* Idem avec les nombres d'iterations : iter[j] = xy2iter(x_j, b, prof) */
+static inline void xy2iter_ligne(double xmin, double xinc, double b, int w,
+                                 int prof, int *iter) {
+  double pa[NOYAU_BLOC], pb[NOYAU_BLOC];
+  int j, m;
+  for (j = 0; j < w; j += m) {
+    m = w - j < NOYAU_BLOC ? w - j : NOYAU_BLOC;
+    xmin = ligne_points(xmin, xinc, b, m, pa, pb);
+    xy2iter_points(pa, pb, m, prof, iter + j);
+  }
+}
+
+/**
+ * Nombres d'iterations des pixels j0..j0+w-1 de la ligne i de la grille g,
+ * dans la precision choisie. y est l'ordonnee de la ligne calculee par
+ * l'appelant : en float et en double, c'est elle qui est utilisee (comme
+ * xy2color_ligne), en double-double elle est recalculee a partir de i.
+ */
+static inline void xy2iter_grille(const grille *g, int i, double y, int j0, int w,
+                                  int prof, int *iter) {
+  periode_stats st = {0, 0, 0, 0};
+  if (noyau_precision == PRECISION_DD) {
+    ligne_dd(g, i, j0, 1, w, prof, iter, &st);
+    periode_ajouter(&st);
+  } else {
+    xy2iter_ligne(g->xmin + j0*g->xinc, g->xinc, y, w, prof, iter);
+  }
+}
+
+/* Idem en couleurs */
+static inline void xy2color_grille(const grille *g, int i, double y, int j0, int w,
+                                   int prof, unsigned char *ligne) {
+  int iter[NOYAU_BLOC], j, m;
+  if (noyau_precision == PRECISION_DD) {
+    for (j = 0; j < w; j += m) {
+      m = w - j < NOYAU_BLOC ? w - j : NOYAU_BLOC;
+      xy2iter_grille(g, i, y, j0 + j, m, prof, iter);
+      iter2color(iter, m, prof, ligne + j);
+    }
+  } else {
+    xy2color_ligne(g->xmin + j0*g->xinc, g->xinc, y, w, prof, ligne);
+  }
+}
+
+#endif /*!_mandel_noyau_h*/
@@ -9,21 +9,52 @@ Modifié par Julie Marcuzzi
 #include <time.h>	/* chronometrage */
 #include <string.h>     /* pour memset */
 #include <math.h>
+#include <limits.h>
 #include <sys/time.h>
 #include <mpi.h>
 
 #include "rasterfile.h"
+#include "mandel_noyau.h"
+#include "mandel_options.h"
+#include "mandel_mariani.h"
+#include "mandel_iter.h"
+#include "mandel_symetrie.h"
+#include "mandel_formule.h"
+#include "mandel_partition.h"
+#include "mandel_mpiio.h"
 
 #define MAITRE 0
+#define TAG_ITER 1
 
 char info[] = "\
 Usage:\n\
-      mandel dimx dimy xmin ymin xmax ymax prof\n\
+      mandel dimx dimy xmin ymin xmax ymax prof [options]\n\
 \n\
       dimx,dimy : dimensions de l'image a generer\n\
       xmin,ymin,xmax,ymax : domaine a calculer dans le plan complexe\n\
       prof : nombre maximale d'iteration\n\
 \n\
+Options\n\
+      -nocardio : pas de test de la cardioide et du disque de periode 2\n\
+      -periode : detection de periodicite des orbites (methode de Brent)\n\
+      -eps_periode eps : tolerance de la detection de periodicite\n\
+      -mariani : subdivision recursive de Mariani-Silver\n\
+      -taille_min n : cote en dessous duquel Mariani-Silver calcule tout\n\
+      -precision p : float, double, dd (double-double) ou auto (defaut)\n\
+      -iter fichier : sauve aussi les nombres d'iterations (voir recolorier)\n\
+      -degre d : formule z^d + c, 2 <= d <= 8 (defaut 2)\n\
+      -julia a,b : ensemble de Julia de z^d + k, k = a + i.b\n\
+      -formule \"expr\" : iteration z -> expr (z, c, i, + - * / ^n, conj),\n\
+                        compilee a l'execution (ex. \"z^3 + c*z + 0.2\")\n\
+      -nosymetrie : calcule aussi les lignes miroir par rapport a l'axe reel\n\
+      -equilibrage pas : lignes reparties selon leur cout, estime sur une\n\
+                         ligne et une colonne sur pas (h quelconque)\n\
+      -cyclique b : blocs de b lignes distribues tour a tour aux processus\n\
+                    (h quelconque ; par defaut b = 1 si h n'est pas\n\
+                    multiple du nombre de processus)\n\
+      -mpiio : chaque processus ecrit ses lignes dans mandel.ras (et le\n\
+               fichier -iter) par MPI-IO, sans tout rassembler au maitre\n\
+\n\
 Quelques exemples d'execution\n\
       mandel 800 800 0.35 0.355 0.353 0.358 200\n\
       mandel 800 800 -0.736 -0.184 -0.735 -0.183 500\n\
@@ -174,39 +205,106 @@ void sauver_rasterfile( char *nom, int largeur, int hauteur, unsigned char *p) {
   fclose( fd);
 }
 
+
 /**
- * Étant donnée les coordonnées d'un point \f$c=a+ib\f$ dans le plan
- * complexe, la fonction retourne la couleur correspondante estimant
- * à quelle distance de l'ensemble de mandelbrot le point est.
- * Soit la suite complexe défini par:
- * \f[
- * \left\{\begin{array}{l}
- * z_0 = 0 \\
- * z_{n+1} = z_n^2 - c
- * \end{array}\right.
- * \f]
- * le nombre d'itérations que la suite met pour diverger est le
- * nombre \f$ n \f$ pour lequel \f$ |z_n| > 2 \f$.
- * Ce nombre est ramené à une valeur entre 0 et 255 correspond ainsi a
- * une couleur dans la palette des couleurs.
+ * Entete de mandel.ras (ENTETE_RASTERFILE octets) : l'entete et la palette
+ * que sauver_rasterfile ecrit avant les pixels.
+ * Au dela de 2 Go, la taille de l'image ne tient pas dans ras_length,
+ * qui vaut alors 0 : le lecteur la deduit de la largeur et de la hauteur
+ * (voir rasterfile.h).
  */
+#define ENTETE_RASTERFILE ((int)sizeof(struct rasterfile) + 3*256)
 
-unsigned char xy2color(double a, double b, int prof) {
-  double x, y, temp, x2, y2;
+void entete_rasterfile( unsigned char *e, int largeur, int hauteur) {
+  struct rasterfile file;
+  long taille = (long)largeur*hauteur;
   int i;
 
-  x = y = 0.;
-  for( i=0; i<prof; i++) {
-    /* garder la valeur précédente de x qui va etre ecrase */
-    temp = x;
-    /* nouvelles valeurs de x et y */
-    x2 = x*x;
-    y2 = y*y;
-    x = x2 - y2 + a;
-    y = 2*temp*y + b;
-    if( x2 + y2 >= 4.0) break;
+  file.ras_magic  = swap(RAS_MAGIC);
+  file.ras_width  = swap(largeur);
+  file.ras_height = swap(hauteur);
+  file.ras_depth  = swap(8);
+  file.ras_length = swap(taille > INT_MAX ? 0 : (int)taille);
+  file.ras_type    = swap(RT_STANDARD);
+  file.ras_maptype = swap(RMT_EQUAL_RGB);
+  file.ras_maplength = swap(256*3);
+  memcpy( e, &file, sizeof(struct rasterfile));
+
+  /* Palette de couleurs : rouge, vert puis bleu, de 255 a 0 */
+  e += sizeof(struct rasterfile);
+  for( i = 0; i < 256; i++) {
+    e[i]       = COMPOSANTE_ROUGE(255 - i);
+    e[256 + i] = COMPOSANTE_VERT(255 - i);
+    e[512 + i] = COMPOSANTE_BLEU(255 - i);
+  }
+}
+
+/**
+ * Sauvegarde MPI-IO (option -mpiio), collective : chaque processus ecrit
+ * ses n lignes ima_loc (et iter_loc si fichier_iter), de numeros
+ * lignes[], dans mandel.ras (et le fichier d'iterations, entete ie)
+ */
+void sauver_mpiio( int w, int h, int axe, unsigned char *ima_loc, int *iter_loc,
+                   int *lignes, int n, char *fichier_iter, iter_entete *ie) {
+  unsigned char e[ENTETE_RASTERFILE];
+  double debut = my_gettimeofday();
+  int rank;
+
+  MPI_Comm_rank( MPI_COMM_WORLD, &rank);
+  entete_rasterfile( e, w, h);
+  mpiio_ecrire( MPI_COMM_WORLD, "mandel.ras", e, ENTETE_RASTERFILE, ima_loc, w, lignes, n, axe, h);
+  if( fichier_iter) mpiio_ecrire_iter( MPI_COMM_WORLD, fichier_iter, ie, iter_loc, lignes, n, axe);
+  if( rank == MAITRE) fprintf( stderr, "MPI-IO: ecriture en %g sec\n", my_gettimeofday() - debut);
+}
+
+
+/**
+ * Distribution cyclique par blocs de b lignes (option -cyclique b) : le
+ * bloc j, lignes j*b..j*b+b-1, revient au processus j % P, qui range ses
+ * blocs a la suite dans loc. Rassemble les loc de tous les processus
+ * directement a leur place dans tab, de h lignes de w elements de type
+ * type (taille octets), sans tampon intermediaire :
+ *  - r tours complets (un bloc entier par processus) : un vecteur de r blocs
+ *    espaces de P*b lignes, d'etendue ramenee a b lignes, que MPI_Gather
+ *    place au rang de chaque processus ;
+ *  - le dernier tour, incomplet, est contigu dans l'image : MPI_Gatherv.
+ */
+void cyclique_rassembler(void *loc, void *tab, MPI_Datatype type, int taille,
+                         int b, int w, int h, int P, int rank) {
+  /* tours complets : de blocs entiers seulement (le dernier bloc peut etre tronque) */
+  int nb = (h + b - 1) / b, r = h / b / P, k, j;
+  long bloc = (long)b * w;
+  MPI_Datatype vecteur, tours;
+  int *nombres = NULL, *deplacements = NULL, n0 = 0;
+
+  if (r > 0) {
+    MPI_Type_vector(r, bloc, (long)P * bloc, type, &vecteur);
+    MPI_Type_create_resized(vecteur, 0, bloc * taille, &tours);
+    MPI_Type_commit(&tours);
+    MPI_Gather(loc, r * bloc, type, tab, 1, tours, MAITRE, MPI_COMM_WORLD);
+    MPI_Type_free(&tours);
+    MPI_Type_free(&vecteur);
+  }
+  if (nb == r * P) return;
+
+  /* Dernier tour : blocs r*P..nb-1, le dernier eventuellement tronque */
+  if (rank == MAITRE) {
+    nombres = (int *)calloc(P, sizeof(int));
+    deplacements = (int *)calloc(P, sizeof(int));
+    for (k = 0; k < nb - r * P; k++) {
+      j = r * P + k;
+      deplacements[k] = j * bloc;
+      nombres[k] = ((j + 1) * b <= h ? b : h - j * b) * w;
+    }
+  }
+  if (rank < nb - r * P) {
+    j = r * P + rank;
+    n0 = ((j + 1) * b <= h ? b : h - j * b) * w;
   }
-  return (i==prof)?255:(int)((i%255));
+  MPI_Gatherv((char *)loc + r * bloc * taille, n0, type,
+              tab, nombres, deplacements, type, MAITRE, MPI_COMM_WORLD);
+  free(nombres);
+  free(deplacements);
 }
 
 /*
@@ -224,12 +322,32 @@ int main(int argc, char *argv[]) {
   /* Profondeur d'iteration */
   int prof;
   /* Image resultat */
-  unsigned char	*ima, *pima;
+  unsigned char	*ima = NULL, *pima;
   /* Variables intermediaires */
-  int  i, j, k;
-  double x, y;
+  int  i, k;
+  double y;
   /* Chronometrage */
   double debut, fin;
+  /* Valeur d'option */
+  char *opt;
+  /* Subdivision de Mariani-Silver */
+  int mode_mariani = 0, taille_min = MARIANI_TAILLE_MIN;
+  mariani ms;
+  /* Grille et precision du calcul */
+  grille g;
+  int precision = PRECISION_AUTO;
+  /* Nombres d'iterations bruts (option -iter) */
+  char *fichier_iter;
+  int *iter = NULL, *piter = NULL;
+  /* Symetrie par rapport a l'axe reel : la ligne axe - i est recopiee */
+  int symetrie = 1, axe, k1, q;
+  /* Partition selon le cout estime (option -equilibrage) */
+  int equilibrage = 0;
+  /* Distribution cyclique par blocs de lignes (option -cyclique) */
+  int cyclique = 0;
+  /* Ecriture parallele (option -mpiio) : entete du fichier d'iterations */
+  int mpiio = 0;
+  iter_entete ie;
 
   /* debut du chronometrage */
   debut = my_gettimeofday();
@@ -245,7 +363,25 @@ int main(int argc, char *argv[]) {
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
   MPI_Comm_size(MPI_COMM_WORLD, &P);
 
-  /* Informations */
+  /* Options facultatives */
+  if( option_presente(&argc, argv, "-nocardio")) noyau_cardioide = 0;
+  if( option_presente(&argc, argv, "-cardio")) noyau_cardioide = 1;
+  if( option_presente(&argc, argv, "-periode")) noyau_periode = 1;
+  if( (opt = option_valeur(&argc, argv, "-eps_periode"))) noyau_periode_eps = atof(opt);
+  if( option_presente(&argc, argv, "-mariani")) mode_mariani = 1;
+  if( (opt = option_valeur(&argc, argv, "-taille_min"))) taille_min = atoi(opt);
+  if( (opt = option_valeur(&argc, argv, "-precision"))) precision = precision_depuis_nom(opt);
+  if( formule_options(&argc, argv) != 0) {
+    if( rank == MAITRE) fprintf( stderr, "%s\n", info);
+    MPI_Finalize();
+    return 1;
+  }
+  fichier_iter = option_valeur(&argc, argv, "-iter");
+  if( option_presente(&argc, argv, "-nosymetrie")) symetrie = 0;
+  if( (opt = option_valeur(&argc, argv, "-equilibrage"))) equilibrage = atoi(opt);
+  if( (opt = option_valeur(&argc, argv, "-cyclique"))) cyclique = atoi(opt);
+  if( option_presente(&argc, argv, "-mpiio")) mpiio = 1;
+
   if( argc == 1) fprintf( stderr, "%s\n", info);
 
   /* Valeurs par defaut de la fractale */
@@ -266,30 +402,254 @@ int main(int argc, char *argv[]) {
   /* Calcul des pas d'incrementation */
   xinc = (xmax - xmin) / (w-1);
   yinc = (ymax - ymin) / (h-1);
+  g = (grille){ xmin, xinc, ymin, yinc };
+  precision_choisir( precision, xmin, ymin, xmax, ymax, xinc, yinc, prof);
+  ie = iter_entete_creer( w, h, prof, xmin, ymin, xmax, ymax);
 
   /* affichage parametres pour verificatrion */
   fprintf( stderr, "Domaine: {[%lg,%lg]x[%lg,%lg]}\n", xmin, ymin, xmax, ymax);
   fprintf( stderr, "Increment : %lg %lg\n", xinc, yinc);
   fprintf( stderr, "Prof: %d\n",  prof);
   fprintf( stderr, "Dim image: %dx%d\n", w, h);
+  fprintf( stderr, "Noyau: %s\n", noyau_nom());
+  precision_afficher();
+  formule_afficher();
+  fprintf( stderr, "Cardioide: %s\n", noyau_cardioide ? "oui" : "non");
+  if( noyau_periode) fprintf( stderr, "Periodicite: eps %lg\n", noyau_periode_eps);
+  if( mode_mariani) fprintf( stderr, "Mariani-Silver: taille min %d\n", taille_min);
+  axe = symetrie && formule_symetrique() ? symetrie_axe( ymin, yinc, h) : -1;
+  if( axe >= 0) fprintf( stderr, "Symetrie: %d lignes recopiees\n", symetrie_recopiees( axe, h));
+  if( equilibrage < 0) equilibrage = 0;
+  if( cyclique < 0) cyclique = 0;
+  if( !cyclique && axe < 0 && !equilibrage && P > 0 && h % P != 0) cyclique = 1;
+  if( cyclique && equilibrage) {
+    fprintf( stderr, "Equilibrage ignore avec -cyclique\n");
+    equilibrage = 0;
+  }
+  if( cyclique) fprintf( stderr, "Cyclique: blocs de %d lignes\n", cyclique);
+  if( equilibrage) fprintf( stderr, "Equilibrage: pre-passe sur une ligne et une colonne sur %d\n", equilibrage);
+  if( mpiio) fprintf( stderr, "MPI-IO: chaque processus ecrit ses lignes\n");
+
+  if (P > 0 && cyclique) {
+		/* Le processus rank calcule les blocs j = t*P + rank, t = 0..n0-1, ranges
+		   a la suite ; symetrie : les lignes miroir ne sont pas calculees */
+		int b = cyclique, nb = (h + b - 1) / b, r = nb / P, t;
+		int n0 = r + (rank < nb - r * P), *bornes = NULL;
+		long bloc = (long)b * w;
+		double t_calcul, *mesure = NULL;
+		unsigned char *ima_loc = (unsigned char *)malloc(bloc * (n0 + 1));
+		int *iter_loc = fichier_iter ? (int *)malloc(bloc * (n0 + 1) * sizeof(int)) : NULL;
+
+		if (rank == MAITRE && !mpiio) {
+			ima = (unsigned char *)malloc( w*h*sizeof(unsigned char));
+			if (fichier_iter) iter = (int *)malloc( (long)w*h*sizeof(int));
+		}
+		if( ima_loc == NULL || (fichier_iter && iter_loc == NULL)
+		    || (rank == MAITRE && !mpiio && (ima == NULL || (fichier_iter && iter == NULL)))) {
+			fprintf( stderr, "Erreur allocation mémoire du tableau \n");
+			MPI_Finalize();
+			return 0;
+		}
+
+		t_calcul = partition_temps();
+		ms = (mariani){ .ima = ima_loc, .w = w, .g = g,
+		                .prof = prof, .taille_min = taille_min, .iter = iter_loc };
+		for (t = 0; t < n0; t++) {
+			int i0 = (t * P + rank) * b, n = i0 + b <= h ? b : h - i0;
+			unsigned char *ima_bloc = ima_loc + t * bloc;
+			int *iter_bloc = iter_loc ? iter_loc + t * bloc : NULL;
+			/* par suites de lignes de meme nature (calculees ou recopiees) */
+			for (i = i0; i < i0 + n; i = k1) {
+				for (k1 = i + 1; k1 < i0 + n && symetrie_calculee(k1, axe) == symetrie_calculee(i, axe); k1++);
+				if (!symetrie_calculee(i, axe)) continue;
+				if (mode_mariani) {
+					ms.ima = ima_bloc + (long)(i - i0) * w;
+					ms.iter = iter_bloc ? iter_bloc + (long)(i - i0) * w : NULL;
+					ms.i0 = i;
+					mariani_silver(&ms, k1 - i);
+				} else {
+					for (q = i; q < k1; q++) {
+						long o = (long)(q - i0) * w;
+						y = ymin + q * yinc;
+						if (iter_bloc) {
+							xy2iter_grille(&g, q, y, 0, w, prof, iter_bloc + o);
+							iter2color(iter_bloc + o, w, prof, ima_bloc + o);
+						} else {
+							xy2color_grille(&g, q, y, 0, w, prof, ima_bloc + o);
+						}
+					}
+				}
+			}
+		}
+		t_calcul = partition_temps() - t_calcul;
+
+		if (mpiio) {
+			/* ligne t*b + j du tampon : ligne (t*P + rank)*b + j de l'image */
+			int *mes_lignes = (int *)malloc((bloc / w) * (n0 + 1) * sizeof(int)), m = 0;
+			for (t = 0; mes_lignes != NULL && t < n0; t++)
+				for (i = (t * P + rank) * b; i < (t * P + rank + 1) * b && i < h; i++)
+					mes_lignes[m++] = i;
+			sauver_mpiio(w, h, axe, ima_loc, iter_loc, mes_lignes, mes_lignes ? m : -1, fichier_iter, &ie);
+			free(mes_lignes);
+		} else {
+			/* Rassemblement direct dans l'image du maitre */
+			cyclique_rassembler(ima_loc, ima, MPI_CHAR, sizeof(unsigned char), b, w, h, P, rank);
+			if (iter_loc) cyclique_rassembler(iter_loc, iter, MPI_INT, sizeof(int), b, w, h, P, rank);
+		}
+		if (rank == MAITRE && !mpiio) {
+			symetrie_recopier(ima, w, h, axe);
+			if (iter) symetrie_recopier(iter, w * sizeof(int), h, axe);
+		}
+
+		/* Temps mesure de chaque processus (lignes distribuees, miroir compris) */
+		if (rank == MAITRE) mesure = (double *)malloc(P * sizeof(double));
+		MPI_Gather(&t_calcul, 1, MPI_DOUBLE, mesure, 1, MPI_DOUBLE, MAITRE, MPI_COMM_WORLD);
+		if (rank == MAITRE) {
+			bornes = (int *)malloc((P + 1) * sizeof(int));
+			for (bornes[0] = 0, k = 0; k < P; k++) {
+				int j = r * P + k;
+				bornes[k + 1] = bornes[k] + r * b + (j < nb ? ((j + 1) * b <= h ? b : h - j * b) : 0);
+			}
+			desequilibre_afficher("Processus", P, bornes, NULL, mesure);
+		}
+		free(ima_loc);
+		free(iter_loc);
+		free(bornes);
+		free(mesure);
+	}
+	else if (P > 0 && (axe >= 0 || equilibrage)) {
+		/* Symetrie : seules les lignes calculees sont reparties, dans l'ordre,
+		   entre les processus ; le maitre recopie les lignes miroir.
+		   Le processus k calcule les lignes lignes[bornes[k]..bornes[k+1]-1] */
+		int *lignes = (int *)malloc(h * sizeof(int));
+		int nc = symetrie_lignes(axe, h, lignes);
+		int *bornes = (int *)malloc((P + 1) * sizeof(int)), nmax = 0;
+		double *cout = NULL, par_unite = 0., t_calcul, *prevu = NULL, *mesure = NULL;
+		for (k = 0; k <= P; k++) bornes[k] = (long)nc * k / P;
+		if (equilibrage) {
+			/* pre-passe partagee entre les processus, puis meme decoupage partout ;
+			   temps d'une iteration : temps processeur de la pre-passe */
+			double u[2];
+			cout = (double *)calloc(nc + 1, sizeof(double));
+			u[0] = partition_temps();
+			u[1] = partition_echantillonner(&g, w, prof, lignes, nc, equilibrage, rank, P, cout);
+			u[0] = partition_temps() - u[0];
+			MPI_Allreduce(MPI_IN_PLACE, cout, nc, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+			MPI_Allreduce(MPI_IN_PLACE, u, 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+			partition_interpoler(cout, nc, equilibrage);
+			partition_decouper(cout, nc, P, bornes);
+			par_unite = u[1] > 0. ? u[0] / u[1] : 0.;
+		}
+		for (k = 0; k < P; k++)
+			if (bornes[k + 1] - bornes[k] > nmax) nmax = bornes[k + 1] - bornes[k];
+		int a0 = bornes[rank], n0 = bornes[rank + 1] - a0;
+		unsigned char *ima_loc = (unsigned char *)malloc((long)w * (n0 + 1));
+		int *iter_loc = fichier_iter ? (int *)malloc((long)w * (n0 + 1) * sizeof(int)) : NULL;
+
+		if (rank == MAITRE && !mpiio) {
+			ima = (unsigned char *)malloc( w*h*sizeof(unsigned char));
+			if (fichier_iter) iter = (int *)malloc( (long)w*h*sizeof(int));
+		}
+		if( ima_loc == NULL || (fichier_iter && iter_loc == NULL)
+		    || (rank == MAITRE && !mpiio && (ima == NULL || (fichier_iter && iter == NULL)))) {
+			fprintf( stderr, "Erreur allocation mémoire du tableau \n");
+			MPI_Finalize();
+			return 0;
+		}
+
+		/* Traitement des lignes a0..a0+n0-1 de la liste, par suites de lignes consecutives */
+		t_calcul = partition_temps();
+		ms = (mariani){ .ima = ima_loc, .w = w, .g = g,
+		                .prof = prof, .taille_min = taille_min, .iter = iter_loc };
+		for (k = 0; k < n0; k = k1) {
+			for (k1 = k + 1; k1 < n0 && lignes[a0 + k1] == lignes[a0 + k1 - 1] + 1; k1++);
+			if (mode_mariani) {
+				ms.ima = ima_loc + (long)k * w;
+				ms.iter = iter_loc ? iter_loc + (long)k * w : NULL;
+				ms.i0 = lignes[a0 + k];
+				mariani_silver(&ms, k1 - k);
+			} else {
+				for (q = k; q < k1; q++) {
+					i = lignes[a0 + q];
+					y = ymin + i * yinc;
+					if (iter_loc) {
+						xy2iter_grille(&g, i, y, 0, w, prof, iter_loc + (long)q * w);
+						iter2color(iter_loc + (long)q * w, w, prof, ima_loc + (long)q * w);
+					} else {
+						xy2color_grille(&g, i, y, 0, w, prof, ima_loc + (long)q * w);
+					}
+				}
+			}
+		}
+
+		t_calcul = partition_temps() - t_calcul;
+
+		/* Envoie et reception : le maitre range les lignes de chacun a leur place */
+		if (mpiio) {
+			sauver_mpiio(w, h, axe, ima_loc, iter_loc, lignes + a0, n0, fichier_iter, &ie);
+		} else if (rank == MAITRE) {
+			unsigned char *tampon = (unsigned char *)malloc((long)w * (nmax + 1));
+			int *itampon = iter ? (int *)malloc((long)w * (nmax + 1) * sizeof(int)) : NULL;
+			for (k = 0; k < P; k++) {
+				int a = bornes[k], n = bornes[k + 1] - a;
+				unsigned char *src = ima_loc;
+				int *isrc = iter_loc;
+				if (k != MAITRE) {
+					MPI_Recv(tampon, w * n, MPI_CHAR, k, 0, MPI_COMM_WORLD, &status);
+					if (iter) MPI_Recv(itampon, w * n, MPI_INT, k, TAG_ITER, MPI_COMM_WORLD, &status);
+					src = tampon;
+					isrc = itampon;
+				}
+				for (q = 0; q < n; q++) {
+					memcpy(ima + (long)lignes[a + q] * w, src + (long)q * w, w);
+					if (iter) memcpy(iter + (long)lignes[a + q] * w, isrc + (long)q * w, w * sizeof(int));
+				}
+			}
+			symetrie_recopier(ima, w, h, axe);
+			if (iter) symetrie_recopier(iter, w * sizeof(int), h, axe);
+			free(tampon);
+			free(itampon);
+		} else {
+			MPI_Send(ima_loc, w * n0, MPI_CHAR, MAITRE, 0, MPI_COMM_WORLD);
+			if (iter_loc) MPI_Send(iter_loc, w * n0, MPI_INT, MAITRE, TAG_ITER, MPI_COMM_WORLD);
+		}
 
-  if (P > 0) {
+		/* Temps prevu et mesure de chaque processus */
+		if (rank == MAITRE) mesure = (double *)malloc(P * sizeof(double));
+		MPI_Gather(&t_calcul, 1, MPI_DOUBLE, mesure, 1, MPI_DOUBLE, MAITRE, MPI_COMM_WORLD);
+		if (rank == MAITRE) {
+			if (cout) {
+				prevu = (double *)malloc(P * sizeof(double));
+				for (k = 0; k < P; k++)
+					prevu[k] = par_unite * partition_cout(cout, bornes[k], bornes[k + 1]);
+			}
+			desequilibre_afficher("Processus", P, bornes, prevu, mesure);
+		}
+		free(lignes);
+		free(bornes);
+		free(cout);
+		free(prevu);
+		free(mesure);
+	}
+	else if (P > 0) {
 		int H_local = h % P;
 
 		/* si divisible */
 		if (H_local	== 0) {
 			H_local = h / P;
 
-			if (rank == MAITRE) {
+			if (rank == MAITRE && !mpiio) {
 				pima = ima = (unsigned char *)malloc( w*h*sizeof(unsigned char));
+				if (fichier_iter) piter = iter = (int *)malloc( (long)w*h*sizeof(int));
 				printf( "rang maitre \n");
 			}
 			else {
 				pima = ima = (unsigned char *)malloc( w*H_local*sizeof(unsigned char));
+				if (fichier_iter) piter = iter = (int *)malloc( (long)w*H_local*sizeof(int));
 				printf( "rang \n");
 			}
 
-			if( ima == NULL) {
+			if( ima == NULL || (fichier_iter && iter == NULL)) {
 				fprintf( stderr, "Erreur allocation mémoire du tableau \n");
 				MPI_Finalize();
 				return 0;
@@ -297,28 +657,44 @@ int main(int argc, char *argv[]) {
 
 			/* Traitement de la grille point par point d'un bloc */
 			y = ymin + (H_local * rank * yinc);
-			for (i = 0; i < H_local; i++) {
-				x = xmin;
-				for (j = 0; j < w; j++) {
-					*pima++ = xy2color(x, y, prof);
-					x += xinc;
+			if (mode_mariani) {
+				ms = (mariani){ .ima = ima, .w = w, .g = g, .i0 = H_local * rank,
+				                .prof = prof, .taille_min = taille_min, .iter = iter };
+				mariani_silver(&ms, H_local);
+			} else {
+				for (i = 0; i < H_local; i++) {
+					if (iter) {
+						xy2iter_grille(&g, H_local * rank + i, y, 0, w, prof, piter);
+						iter2color(piter, w, prof, pima);
+						piter += w;
+					} else {
+						xy2color_grille(&g, H_local * rank + i, y, 0, w, prof, pima);
+					}
+					pima += w;
+					y += yinc;
 				}
-				y += yinc;
 			}
 			printf("grille calculée \n");
 
 			/* Envoie et recepte morceau d'image */
-			if (rank == MAITRE) {
+			if (mpiio) {
+				int *mes_lignes = (int *)malloc(H_local * sizeof(int));
+				for (i = 0; mes_lignes != NULL && i < H_local; i++) mes_lignes[i] = H_local * rank + i;
+				sauver_mpiio(w, h, axe, ima, iter, mes_lignes, mes_lignes ? H_local : -1, fichier_iter, &ie);
+				free(mes_lignes);
+			} else if (rank == MAITRE) {
 				for (k = 1; k < P; k++) {
 					MPI_Probe(MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &status);
 					int s = status.MPI_SOURCE;
 					if (s != MAITRE) {
 						MPI_Recv(ima + s * w * H_local * sizeof(unsigned char), w * H_local, MPI_CHAR, s, 0, MPI_COMM_WORLD, &status);
+						if (iter) MPI_Recv(iter + (long)s * w * H_local, w * H_local, MPI_INT, s, TAG_ITER, MPI_COMM_WORLD, &status);
 						printf("recoit \n");
 					}
 				}
 			} else {
 				MPI_Send(ima, w * H_local, MPI_CHAR, MAITRE, 0, MPI_COMM_WORLD);
+				if (iter) MPI_Send(iter, w * H_local, MPI_INT, MAITRE, TAG_ITER, MPI_COMM_WORLD);
 				printf("envoi \n");
 			}
 
@@ -341,8 +717,22 @@ int main(int argc, char *argv[]) {
 	   fin - debut);
   fprintf( stdout, "%g\n", fin - debut);
 
+  /* Statistiques de periodicite cumulees sur le maitre */
+  if( noyau_periode) {
+    periode_stats total;
+    MPI_Reduce(&noyau_stats.pixels, &total.pixels, 3, MPI_LONG_LONG, MPI_SUM, MAITRE, MPI_COMM_WORLD);
+    MPI_Reduce(&noyau_stats.periode_max, &total.periode_max, 1, MPI_LONG_LONG, MPI_MAX, MAITRE, MPI_COMM_WORLD);
+    if( rank == MAITRE) periode_afficher( &total, (long long)w*h);
+  }
+  if( mode_mariani) {
+    long long calcules;
+    MPI_Reduce(&ms.calcules, &calcules, 1, MPI_LONG_LONG, MPI_SUM, MAITRE, MPI_COMM_WORLD);
+    if( rank == MAITRE) mariani_afficher( calcules, (long long)w*h);
+  }
+
   /* Sauvegarde de la grille dans le fichier resultat "mandel.ras" */
-  sauver_rasterfile( "mandel.ras", w, h, ima);
+  if( rank == MAITRE && !mpiio) sauver_rasterfile( "mandel.ras", w, h, ima);
+  if( rank == MAITRE && !mpiio && iter) iter_sauver( fichier_iter, &ie, iter);
 
   MPI_Finalize();
   return 0;
@@ -0,0 +1,347 @@
+/*
+ * Zoom profond par la methode des perturbations.
+ *
+ * En double, deux pixels voisins ne sont plus distingues des que le pas
+ * descend vers 1e-13 fois les coordonnees : l'image devient une mosaique
+ * de blocs. On calcule donc une seule orbite de reference Z_n, celle du
+ * centre C de l'image, en virgule fixe multi-precision (grand), puis
+ * chaque pixel c = C + dc est itere en double sur son ecart a la
+ * reference, z_n = Z_n + d_n :
+ *
+ *   d_{n+1} = 2 Z_n d_n + d_n^2 + dc,   d_0 = 0
+ *
+ * Les ecarts restent de l'ordre du pas, que le double represente sans
+ * perte jusqu'a ~1e-290.
+ *
+ * Rebasement (glitchs) : quand |Z_n + d_n| < |d_n|, l'orbite du pixel
+ * passe plus pres de 0 que la reference et l'ecart perd sa precision
+ * relative (glitch). On repart alors du debut de la reference avec
+ * d = z et n_ref = 0 ; idem quand la reference a diverge avant le pixel.
+ * Le nombre de rebasements est compte.
+ *
+ * Approximation en serie : tant que les pixels restent proches de la
+ * reference, d_n = A_n dc + B_n dc^2 + C_n dc^3 avec
+ *
+ *   A_{n+1} = 2 Z_n A_n + 1
+ *   B_{n+1} = 2 Z_n B_n + A_n^2
+ *   C_{n+1} = 2 Z_n C_n + 2 A_n B_n
+ *
+ * ce qui saute les n0 premieres iterations, communes a tous les pixels.
+ * n0 est la derniere iteration ou la serie reste en accord (a eps pres,
+ * en relatif) avec des points sondes aux coins et aux milieux des bords
+ * de l'image, itere par perturbation en meme temps que les coefficients.
+ * Pres du bord de l'ensemble, decaler un pixel d'un millionieme de pas
+ * change deja le nombre d'iterations de ~2% des points : avec
+ * eps = SERIE_EPS (1e-9) la serie ne modifie pas plus de points que ce
+ * bruit (-eps_serie pour ajuster).
+ */
+
+#ifndef _mandel_perturbation_h
+#define _mandel_perturbation_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "mandel_noyau.h"
+
+/*
+ * Reel en virgule fixe : signe et mots de 32 bits, m[0] partie entiere,
+ * m[1..] partie fractionnaire (poids 2^-32, 2^-64...). Seuls les
+ * grand_mots premiers mots sont utilises.
+ */
+#define GRAND_MOTS_MAX 40
+
+typedef struct {
+  int signe;                  /* 1 si negatif */
+  uint32_t m[GRAND_MOTS_MAX];
+} grand;
+
+static int grand_mots = 4;
+
+/* Comparaison des valeurs absolues */
+static inline int grand_cmp_abs(const grand *a, const grand *b) {
+  int k;
+  for (k = 0; k < grand_mots; k++)
+    if (a->m[k] != b->m[k]) return a->m[k] < b->m[k] ? -1 : 1;
+  return 0;
+}
+
+/* |r| = |a| + |b| */
+static inline void grand_add_abs(grand *r, const grand *a, const grand *b) {
+  uint64_t s = 0;
+  int k;
+  for (k = grand_mots - 1; k >= 0; k--) {
+    s += (uint64_t)a->m[k] + b->m[k];
+    r->m[k] = (uint32_t)s;
+    s >>= 32;
+  }
+}
+
+/* |r| = |a| - |b|, avec |a| >= |b| */
+static inline void grand_sub_abs(grand *r, const grand *a, const grand *b) {
+  int64_t s = 0;
+  int k;
+  for (k = grand_mots - 1; k >= 0; k--) {
+    s += (int64_t)a->m[k] - b->m[k];
+    r->m[k] = (uint32_t)s;
+    s = s < 0 ? -1 : 0;
+  }
+}
+
+/* r = a + b (r peut etre a ou b) */
+static inline void grand_add(grand *r, const grand *a, const grand *b) {
+  if (a->signe == b->signe) {
+    r->signe = a->signe;
+    grand_add_abs(r, a, b);
+  } else if (grand_cmp_abs(a, b) >= 0) {
+    r->signe = a->signe;
+    grand_sub_abs(r, a, b);
+  } else {
+    r->signe = b->signe;
+    grand_sub_abs(r, b, a);
+  }
+}
+
+/* r = a - b */
+static inline void grand_sub(grand *r, const grand *a, const grand *b) {
+  grand nb = *b;
+  nb.signe = !nb.signe;
+  grand_add(r, a, &nb);
+}
+
+/*
+ * r = a * b, tronque a grand_mots mots. La partie entiere du produit
+ * doit tenir sur 32 bits (ici |z| reste petit).
+ */
+static inline void grand_mul(grand *r, const grand *a, const grand *b) {
+  uint64_t t[GRAND_MOTS_MAX + 1] = {0}, p;
+  int i, j, n = grand_mots;
+
+  for (i = 0; i < n; i++) {
+    if (a->m[i] == 0) continue;
+    for (j = 0; j < n && i + j <= n; j++) {
+      p = (uint64_t)a->m[i] * b->m[j];
+      t[i+j] += (uint32_t)p;
+      if (i + j > 0) t[i+j-1] += p >> 32;
+    }
+  }
+  for (i = n; i > 0; i--) {
+    t[i-1] += t[i] >> 32;
+    t[i] &= 0xffffffffu;
+  }
+  for (i = 0; i < n; i++) r->m[i] = (uint32_t)t[i];
+  r->signe = a->signe != b->signe;
+}
+
+static inline double grand_vers_double(const grand *a) {
+  double d = 0., p = 1.;
+  int k;
+  for (k = 0; k < grand_mots && k < 4; k++) {
+    d += a->m[k] * p;
+    p *= 1. / 4294967296.;
+  }
+  return a->signe ? -d : d;
+}
+
+/* a - b en double, meme si a et b ne different qu'au-dela du 4e mot */
+static inline double grand_ecart(const grand *a, const grand *b) {
+  grand r;
+  double d = 0., p = 1.;
+  int k, k0;
+  grand_sub(&r, a, b);
+  for (k0 = 0; k0 < grand_mots && r.m[k0] == 0; k0++) p *= 1. / 4294967296.;
+  for (k = k0; k < grand_mots && k < k0 + 4; k++) {
+    d += r.m[k] * p;
+    p *= 1. / 4294967296.;
+  }
+  return r.signe ? -d : d;
+}
+
+/* r = d, exactement si d n'a pas de bits au-dela du dernier mot */
+static inline void grand_depuis_double(grand *r, double d) {
+  int k;
+  memset(r, 0, sizeof(grand));
+  r->signe = d < 0;
+  d = fabs(d);
+  for (k = 0; k < grand_mots; k++) {
+    r->m[k] = (uint32_t)d;
+    d = (d - r->m[k]) * 4294967296.;
+  }
+}
+
+/**
+ * Lit un decimal de longueur quelconque ("-1.7499370000000000000001").
+ * @return 1 si la chaine est correcte, 0 sinon
+ */
+static inline int grand_depuis_chaine(grand *r, const char *s) {
+  const char *point, *fin, *p;
+  uint64_t reste;
+  long entier = 0;
+  int k;
+
+  memset(r, 0, sizeof(grand));
+  if (*s == '-' || *s == '+') r->signe = *s++ == '-';
+  for (p = s; *p >= '0' && *p <= '9'; p++) {
+    entier = entier*10 + (*p - '0');
+    if (entier > 1000000) return 0;
+  }
+  point = p;
+  if (*p == '.')
+    for (p++; *p >= '0' && *p <= '9'; p++) ;
+  fin = p;
+  if (*fin != '\0' || fin == s) return 0;
+  r->m[0] = (uint32_t)entier;
+
+  /* fraction : en partant du dernier chiffre, f = (chiffre + f) / 10 */
+  for (p = fin - 1; *point == '.' && p > point; p--) {
+    reste = *p - '0';
+    for (k = 1; k < grand_mots; k++) {
+      reste = (reste << 32) | r->m[k];
+      r->m[k] = (uint32_t)(reste / 10);
+      reste %= 10;
+    }
+  }
+  return 1;
+}
+
+/* Orbite de reference et approximation en serie */
+typedef struct {
+  int n;               /* Z_0..Z_n calcules (n = prof ou divergence) */
+  double *zx, *zy;     /* orbite, arrondie en double */
+  int n0;              /* iterations sautees par la serie */
+  double ax, ay, bx, by, cx, cy;   /* A, B, C a l'iteration n0 */
+} reference;
+
+/**
+ * Orbite de Z_{n+1} = Z_n^2 + C en multi-precision, arretee a prof
+ * iterations ou des que |Z_n| >= 2.
+ */
+static inline void reference_orbite(reference *ref, const grand *cr, const grand *ci,
+                                    int prof) {
+  grand x, y, x2, y2, xy;
+  int n;
+
+  ref->zx = (double *)malloc((prof + 1) * sizeof(double));
+  ref->zy = (double *)malloc((prof + 1) * sizeof(double));
+  if (ref->zx == NULL || ref->zy == NULL) {
+    fprintf(stderr, "Erreur allocation memoire de l'orbite de reference\n");
+    exit(1);
+  }
+  memset(&x, 0, sizeof(grand));
+  memset(&y, 0, sizeof(grand));
+  for (n = 0; ; n++) {
+    ref->zx[n] = grand_vers_double(&x);
+    ref->zy[n] = grand_vers_double(&y);
+    if (n == prof || ref->zx[n]*ref->zx[n] + ref->zy[n]*ref->zy[n] >= 4.) break;
+    grand_mul(&x2, &x, &x);
+    grand_mul(&y2, &y, &y);
+    grand_mul(&xy, &x, &y);
+    grand_sub(&x, &x2, &y2);
+    grand_add(&x, &x, cr);
+    grand_add(&y, &xy, &xy);
+    grand_add(&y, &y, ci);
+  }
+  ref->n = n;
+  /* pas de serie tant que reference_serie() n'est pas appelee */
+  ref->n0 = 0;
+  ref->ax = ref->ay = ref->bx = ref->by = ref->cx = ref->cy = 0.;
+}
+
+#define SERIE_SONDES 8
+#ifndef SERIE_EPS
+#define SERIE_EPS 1e-9
+#endif
+
+/**
+ * Calcule les coefficients de la serie et n0, d'apres les sondes aux
+ * coins et milieux des bords de l'image (demi-largeurs rx, ry).
+ */
+static inline void reference_serie(reference *ref, double rx, double ry, double eps) {
+  double sx[SERIE_SONDES] = { -rx, rx, -rx, rx, 0., 0., -rx, rx };
+  double sy[SERIE_SONDES] = { -ry, -ry, ry, ry, -ry, ry, 0., 0. };
+  double dx[SERIE_SONDES] = {0}, dy[SERIE_SONDES] = {0};
+  double ax = 0., ay = 0., bx = 0., by = 0., cx = 0., cy = 0.;
+  double nax, nay, nbx, nby, zx, zy, wx, wy, ex, ey, t, px, py;
+  double d2x, d2y, d3x, d3y;
+  int n, k, ok;
+
+  for (n = 0; n + 1 < ref->n; n++) {
+    zx = ref->zx[n]; zy = ref->zy[n];
+    /* A, B, C a l'iteration n+1 */
+    nax = 2*(zx*ax - zy*ay) + 1.;
+    nay = 2*(zx*ay + zy*ax);
+    nbx = 2*(zx*bx - zy*by) + ax*ax - ay*ay;
+    nby = 2*(zx*by + zy*bx) + 2*ax*ay;
+    t   = 2*(zx*cx - zy*cy) + 2*(ax*bx - ay*by);
+    cy  = 2*(zx*cy + zy*cx) + 2*(ax*by + ay*bx);
+    cx = t;
+    ax = nax; ay = nay; bx = nbx; by = nby;
+
+    /* Sondes par perturbation, comparees a la serie */
+    ok = 1;
+    for (k = 0; k < SERIE_SONDES && ok; k++) {
+      t      = 2*(zx*dx[k] - zy*dy[k]) + dx[k]*dx[k] - dy[k]*dy[k] + sx[k];
+      dy[k]  = 2*(zx*dy[k] + zy*dx[k]) + 2*dx[k]*dy[k] + sy[k];
+      dx[k]  = t;
+      /* dc^2 et dc^3 */
+      d2x = sx[k]*sx[k] - sy[k]*sy[k]; d2y = 2*sx[k]*sy[k];
+      d3x = d2x*sx[k] - d2y*sy[k];     d3y = d2x*sy[k] + d2y*sx[k];
+      px = ax*sx[k] - ay*sy[k] + bx*d2x - by*d2y + cx*d3x - cy*d3y;
+      py = ax*sy[k] + ay*sx[k] + bx*d2y + by*d2x + cx*d3y + cy*d3x;
+      ex = px - dx[k]; ey = py - dy[k];
+      ok = ex*ex + ey*ey <= eps*eps*(dx[k]*dx[k] + dy[k]*dy[k]);
+      /* le pixel passerait pres de 0 : rebasement, serie invalide */
+      wx = ref->zx[n+1] + dx[k]; wy = ref->zy[n+1] + dy[k];
+      if (wx*wx + wy*wy < dx[k]*dx[k] + dy[k]*dy[k]) ok = 0;
+    }
+    if (!ok) break;
+    ref->n0 = n + 1;
+    ref->ax = ax; ref->ay = ay; ref->bx = bx; ref->by = by;
+    ref->cx = cx; ref->cy = cy;
+  }
+}
+
+static inline void reference_liberer(reference *ref) {
+  free(ref->zx);
+  free(ref->zy);
+}
+
+/**
+ * Nombre d'iterations du pixel c = C + dc (comme xy2iter), par
+ * perturbation autour de la reference ; rebasements cumules dans *rebase.
+ */
+static inline int perturbation_iter(const reference *ref, double dcx, double dcy,
+                                    int prof, long long *rebase) {
+  const double *Zx = ref->zx, *Zy = ref->zy;
+  double dx, dy, zx, zy, z2, t, d2x, d2y;
+  int n, m;
+
+  /* point de depart donne par la serie */
+  d2x = dcx*dcx - dcy*dcy; d2y = 2*dcx*dcy;
+  dx = ref->ax*dcx - ref->ay*dcy + ref->bx*d2x - ref->by*d2y
+     + ref->cx*(d2x*dcx - d2y*dcy) - ref->cy*(d2x*dcy + d2y*dcx);
+  dy = ref->ax*dcy + ref->ay*dcx + ref->bx*d2y + ref->by*d2x
+     + ref->cx*(d2x*dcy + d2y*dcx) + ref->cy*(d2x*dcx - d2y*dcy);
+  n = m = ref->n0;
+
+  for ( ; n < prof; n++, m++) {
+    zx = Zx[m] + dx;
+    zy = Zy[m] + dy;
+    z2 = zx*zx + zy*zy;
+    if (z2 >= 4.) break;
+    if (m == ref->n || z2 < dx*dx + dy*dy) {
+      /* rebasement : z devient l'ecart a Z_0 = 0 */
+      dx = zx; dy = zy; m = 0;
+      (*rebase)++;
+    }
+    t  = 2*(Zx[m]*dx - Zy[m]*dy) + dx*dx - dy*dy + dcx;
+    dy = 2*(Zx[m]*dy + Zy[m]*dx) + 2*dx*dy + dcy;
+    dx = t;
+  }
+  return n;
+}
+
+#endif /*!_mandel_perturbation_h*/
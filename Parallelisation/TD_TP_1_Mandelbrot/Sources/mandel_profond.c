@@ -0,0 +1,298 @@
+/*
+ * Programmation Parallèle - Avril 2012
+ * Polytech'Paris
+ * Université Pierre et Marie Curie
+ * Calcul de l'ensemble de Mandelbrot, zoom profond par perturbations
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>	/* chronometrage */
+#include <string.h>     /* pour memset */
+#include <math.h>
+#include <sys/time.h>
+
+#include "rasterfile.h"
+#include "mandel_noyau.h"
+#include "mandel_options.h"
+#include "mandel_perturbation.h"
+
+
+
+char info[] = "\
+Usage:\n\
+      mandel_profond dimx dimy cx cy rayon prof [options]\n\
+\n\
+      dimx,dimy : dimensions de l'image a generer\n\
+      cx,cy : centre de l'image, nombres decimaux de longueur quelconque\n\
+      rayon : demi-hauteur du domaine (jusqu'a ~1e-290)\n\
+      prof : nombre maximale d'iteration\n\
+\n\
+Options\n\
+      -noserie : pas d'approximation en serie (toutes les iterations)\n\
+      -eps_serie eps : ecart relatif tolere entre la serie et les sondes\n\
+\n\
+Quelques exemples d'execution\n\
+      mandel_profond 800 800 -0.743643887037158704752191506114774 0.131825904205311970493132056385139 1e-20 20000\n\
+      mandel_profond 800 800 -1.7499370189 0 1e-12 20000\n\
+      mandel_profond 800 800 -0.7435669 0.1314023 1e-5 2000\n\
+";
+
+
+
+double my_gettimeofday(){
+  struct timeval tmp_time;
+  gettimeofday(&tmp_time, NULL);
+  return tmp_time.tv_sec + (tmp_time.tv_usec * 1.0e-6L);
+}
+
+
+
+
+/**
+ * Convertion entier (4 octets) LINUX en un entier SUN
+ * @param i entier � convertir
+ * @return entier converti
+ */
+
+int swap(int i) {
+  int init = i;
+  int conv;
+  unsigned char *o, *d;
+
+  o = ( (unsigned char *) &init) + 3;
+  d = (unsigned char *) &conv;
+
+  *d++ = *o--;
+  *d++ = *o--;
+  *d++ = *o--;
+  *d++ = *o--;
+
+  return conv;
+}
+
+
+/***
+ * Par Francois-Xavier MOREL (M2 SAR, oct2009):
+ */
+
+unsigned char power_composante(int i, int p) {
+  unsigned char o;
+  double iD=(double) i;
+
+  iD/=255.0;
+  iD=pow(iD,p);
+  iD*=255;
+  o=(unsigned char) iD;
+  return o;
+}
+
+unsigned char cos_composante(int i, double freq) {
+  unsigned char o;
+  double iD=(double) i;
+  iD=cos(iD/255.0*2*M_PI*freq);
+  iD+=1;
+  iD*=128;
+
+  o=(unsigned char) iD;
+  return o;
+}
+
+/***
+ * Choix du coloriage : definir une (et une seule) des constantes
+ * ci-dessous :
+ */
+//#define ORIGINAL_COLOR
+#define COS_COLOR
+
+#ifdef ORIGINAL_COLOR
+#define COMPOSANTE_ROUGE(i)    ((i)/2)
+#define COMPOSANTE_VERT(i)     ((i)%190)
+#define COMPOSANTE_BLEU(i)     (((i)%120) * 2)
+#endif /* #ifdef ORIGINAL_COLOR */
+#ifdef COS_COLOR
+#define COMPOSANTE_ROUGE(i)    cos_composante(i,13.0)
+#define COMPOSANTE_VERT(i)     cos_composante(i,5.0)
+#define COMPOSANTE_BLEU(i)     cos_composante(i+10,7.0)
+#endif /* #ifdef COS_COLOR */
+
+
+/**
+ *  Sauvegarde le tableau de donn�es au format rasterfile
+ *  8 bits avec une palette de 256 niveaux de gris du blanc (valeur 0)
+ *  vers le noir (255)
+ *    @param nom Nom de l'image
+ *    @param largeur largeur de l'image
+ *    @param hauteur hauteur de l'image
+ *    @param p pointeur vers tampon contenant l'image
+ */
+
+void sauver_rasterfile( char *nom, int largeur, int hauteur, unsigned char *p) {
+  FILE *fd;
+  struct rasterfile file;
+  int i;
+  unsigned char o;
+
+  if ( (fd=fopen(nom, "w")) == NULL ) {
+	printf("erreur dans la creation du fichier %s \n",nom);
+	exit(1);
+  }
+
+  file.ras_magic  = swap(RAS_MAGIC);
+  file.ras_width  = swap(largeur);	  /* largeur en pixels de l'image */
+  file.ras_height = swap(hauteur);         /* hauteur en pixels de l'image */
+  file.ras_depth  = swap(8);	          /* profondeur de chaque pixel (1, 8 ou 24 )   */
+  file.ras_length = swap(largeur*hauteur); /* taille de l'image en nb de bytes		*/
+  file.ras_type    = swap(RT_STANDARD);	  /* type de fichier */
+  file.ras_maptype = swap(RMT_EQUAL_RGB);
+  file.ras_maplength = swap(256*3);
+
+  fwrite(&file, sizeof(struct rasterfile), 1, fd);
+
+  /* Palette de couleurs : composante rouge */
+  i = 256;
+  while( i--) {
+    o = COMPOSANTE_ROUGE(i);
+    fwrite( &o, sizeof(unsigned char), 1, fd);
+  }
+
+  /* Palette de couleurs : composante verte */
+  i = 256;
+  while( i--) {
+    o = COMPOSANTE_VERT(i);
+    fwrite( &o, sizeof(unsigned char), 1, fd);
+  }
+
+  /* Palette de couleurs : composante bleu */
+  i = 256;
+  while( i--) {
+    o = COMPOSANTE_BLEU(i);
+    fwrite( &o, sizeof(unsigned char), 1, fd);
+  }
+
+  // pour verifier l'ordre des lignes dans l'image :
+  //fwrite( p, largeur*hauteur/3, sizeof(unsigned char), fd);
+
+  // pour voir la couleur du '0' :
+  // memset (p, 0, largeur*hauteur);
+
+  fwrite( p, largeur*hauteur, sizeof(unsigned char), fd);
+  fclose( fd);
+}
+
+/*
+ * Partie principale: orbite de reference au centre, puis chaque pixel
+ * par perturbation
+ */
+
+int main(int argc, char *argv[]) {
+  /* Centre (decimaux en texte) et demi-hauteur du domaine */
+  char *cx, *cy;
+  double rayon;
+  grand cr, ci;
+  /* Dimension de l'image */
+  int w,h;
+  /* Ecart entre deux pixels */
+  double pas;
+  /* Profondeur d'iteration */
+  int prof;
+  /* Orbite de reference et serie */
+  reference ref;
+  /* Image resultat */
+  unsigned char	*ima;
+  /* Variables intermediaires */
+  int  i, j;
+  long long rebase = 0;
+  /* Chronometrage */
+  double debut, t_ref, fin;
+  /* Approximation en serie */
+  int serie = 1;
+  double eps_serie = SERIE_EPS;
+  /* Valeur d'option */
+  char *opt;
+
+  /* debut du chronometrage */
+  debut = my_gettimeofday();
+
+
+  /* Options facultatives */
+  if( option_presente(&argc, argv, "-noserie")) serie = 0;
+  if( (opt = option_valeur(&argc, argv, "-eps_serie"))) eps_serie = atof(opt);
+
+  if( argc == 1) fprintf( stderr, "%s\n", info);
+
+  /* Valeurs par defaut : vallee des hippocampes */
+  cx = "-0.743643887037158704752191506114774";
+  cy = "0.131825904205311970493132056385139";
+  rayon = 1e-20;
+  w = h = 800;
+  prof = 20000;
+
+  /* Recuperation des parametres */
+  if( argc > 1) w     = atoi(argv[1]);
+  if( argc > 2) h     = atoi(argv[2]);
+  if( argc > 3) cx    = argv[3];
+  if( argc > 4) cy    = argv[4];
+  if( argc > 5) rayon = atof(argv[5]);
+  if( argc > 6) prof  = atoi(argv[6]);
+
+  /* Pas, et precision de la reference : 64 bits de mieux que le pas */
+  pas = 2*rayon / (h-1);
+  if( !(pas > 1e-290)) {
+    fprintf( stderr, "Rayon %lg hors de portee du double\n", rayon);
+    return 1;
+  }
+  grand_mots = 2 + (int)((64 - log2(pas)) / 32);
+  if( grand_mots > GRAND_MOTS_MAX) grand_mots = GRAND_MOTS_MAX;
+  if( !grand_depuis_chaine( &cr, cx) || !grand_depuis_chaine( &ci, cy)) {
+    fprintf( stderr, "Centre incorrect : %s %s\n", cx, cy);
+    return 1;
+  }
+
+  /* affichage parametres pour verificatrion */
+  fprintf( stderr, "Centre: %s %s\n", cx, cy);
+  fprintf( stderr, "Rayon: %lg (pas %lg)\n", rayon, pas);
+  fprintf( stderr, "Prof: %d\n",  prof);
+  fprintf( stderr, "Dim image: %dx%d\n", w, h);
+  fprintf( stderr, "Precision reference: %d bits\n", 32*grand_mots);
+
+  /* Allocation memoire du tableau resultat */
+  ima = (unsigned char *)malloc( (size_t)w*h*sizeof(unsigned char));
+
+  if( ima == NULL) {
+    fprintf( stderr, "Erreur allocation memoire du tableau \n");
+    return 0;
+  }
+
+  /* Orbite de reference, puis serie validee par des sondes */
+  reference_orbite( &ref, &cr, &ci, prof);
+  if( serie)
+    reference_serie( &ref, pas*(w-1)/2, pas*(h-1)/2, eps_serie);
+  t_ref = my_gettimeofday();
+  fprintf( stderr, "Reference: %d iterations, serie: %d iterations sautees (%g sec)\n",
+           ref.n, ref.n0, t_ref - debut);
+
+  /* Traitement de la grille pixel par pixel */
+#pragma omp parallel for private(j) schedule(dynamic) reduction(+:rebase)
+  for (i = 0; i < h; i++) {
+    for (j = 0; j < w; j++) {
+      int n = perturbation_iter( &ref, (j - (w-1)/2.)*pas, (i - (h-1)/2.)*pas,
+                                 prof, &rebase);
+      ima[(size_t)i*w + j] = ITER2COLOR(n, prof);
+    }
+  }
+
+  /* fin du chronometrage */
+  fin = my_gettimeofday();
+  fprintf( stderr, "Temps total de calcul : %g sec\n",
+	   fin - debut);
+  fprintf( stdout, "%g\n", fin - debut);
+  fprintf( stderr, "Rebasements (glitchs): %lld\n", rebase);
+
+  /* Sauvegarde de la grille dans le fichier resultat "mandel.ras" */
+  sauver_rasterfile( "mandel.ras", w, h, ima);
+
+  reference_liberer( &ref);
+  free( ima);
+  return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * Rendu progressif (option -progressif pas) : une premiere passe calcule
+ * un pixel sur pas dans chaque direction, puis chaque passe divise le pas
+ * par deux et calcule les pixels de la nouvelle grille qui ne l'ont pas
+ * encore ete (entrelacement a la Adam7) : aucun pixel n'est calcule deux
+ * fois. Apres chaque passe, un apercu est sauve, chaque pixel pas encore
+ * calcule prenant la couleur du coin haut gauche de son carre de cote pas.
+ *
+ * Les points sont ceux d'un calcul ligne par ligne (abscisses accumulees
+ * comme xy2color_ligne) : l'image finale est identique.
+ */
+
+#ifndef _mandel_progressif_h
+#define _mandel_progressif_h
+
+#include <stdlib.h>
+
+#include "mandel_noyau.h"
+
+/* Pas de la premiere passe : la puissance de 2 au moins egale a pas */
+static inline int progressif_pas_initial(int pas) {
+  int s = 1;
+  while (s < pas) s *= 2;
+  return s;
+}
+
+/* Nombre de passes d'un rendu de pas initial s0 (s0, s0/2, ..., 1) */
+static inline int progressif_passes(int s0) {
+  int n = 1;
+  while (s0 > 1) { s0 /= 2; n++; }
+  return n;
+}
+
+/* Le pixel (i,j) est-il calcule par la passe de pas s (s0 : premiere) ? */
+static inline int progressif_nouveau(int i, int j, int s, int s0) {
+  if (i % s || j % s) return 0;
+  return s == s0 || i % (2*s) || j % (2*s);
+}
+
+/* Abscisses des w colonnes, x_0 = xmin et x_{j+1} = x_j + xinc (a liberer) */
+static inline double *progressif_abscisses(double xmin, double xinc, int w) {
+  double *x = (double *)malloc(w*sizeof(double));
+  int j;
+  if (x != NULL)
+    for (j = 0; j < w; j++) {
+      x[j] = xmin;
+      xmin += xinc;
+    }
+  return x;
+}
+
+/**
+ * Nombres d'iterations des pixels de la ligne i (ordonnee y, comme
+ * xy2iter_grille) nouveaux a la passe de pas s : seuls ces iter[j] sont
+ * ecrits. x : abscisses des colonnes (progressif_abscisses).
+ */
+static inline void progressif_ligne(const grille *g, const double *x, int i, double y,
+                                    int w, int prof, int s, int s0, int *iter) {
+  double pa[NOYAU_BLOC], pb[NOYAU_BLOC];
+  int pj[NOYAU_BLOC], it[NOYAU_BLOC];
+  int j, k, m = 0;
+
+  if (i % s) return;
+  if (noyau_precision == PRECISION_DD) {
+    /* colonnes regulierement espacees j0, j0+d... (coordonnees en double-double) */
+    periode_stats st = {0, 0, 0, 0};
+    int j0 = s == s0 || i % (2*s) ? 0 : s, d = j0 ? 2*s : s;
+    for (j = j0; j < w; j += m*d) {
+      m = (w - 1 - j)/d + 1;
+      if (m > NOYAU_BLOC) m = NOYAU_BLOC;
+      ligne_dd(g, i, j, d, m, prof, it, &st);
+      for (k = 0; k < m; k++) iter[j + k*d] = it[k];
+    }
+    periode_ajouter(&st);
+  } else {
+    /* points quelconques, par paquets de NOYAU_BLOC */
+    for (j = 0; j <= w; j++) {
+      if (j < w && progressif_nouveau(i, j, s, s0)) {
+        pa[m] = x[j];
+        pb[m] = y;
+        pj[m++] = j;
+      }
+      if (m == NOYAU_BLOC || (j == w && m > 0)) {
+        xy2iter_points(pa, pb, m, prof, it);
+        for (k = 0; k < m; k++) iter[pj[k]] = it[k];
+        m = 0;
+      }
+    }
+  }
+}
+
+/* Range a la suite dans vals les pixels de la ligne iter nouveaux a la passe s */
+static inline int progressif_tasser(const int *iter, int i, int w, int s, int s0,
+                                    int *vals) {
+  int j, n = 0;
+  for (j = 0; j < w; j++)
+    if (progressif_nouveau(i, j, s, s0)) vals[n++] = iter[j];
+  return n;
+}
+
+/* Inverse : replace les valeurs vals dans la ligne iter, renvoie leur nombre */
+static inline int progressif_etaler(const int *vals, int i, int w, int s, int s0,
+                                    int *iter) {
+  int j, n = 0;
+  for (j = 0; j < w; j++)
+    if (progressif_nouveau(i, j, s, s0)) iter[j] = vals[n++];
+  return n;
+}
+
+/**
+ * Couleurs de l'image w x h apres la passe de pas s : chaque pixel prend
+ * celle du pixel calcule au coin haut gauche de son carre (s = 1 : image
+ * finale).
+ */
+static inline void progressif_apercu(const int *iter, int w, int h, int prof, int s,
+                                     unsigned char *ima) {
+  int i;
+#pragma omp parallel for
+  for (i = 0; i < h; i++) {
+    const int *ligne = iter + (long)(i - i % s)*w;
+    int j;
+    for (j = 0; j < w; j++)
+      ima[(long)i*w + j] = ITER2COLOR(ligne[j - j % s], prof);
+  }
+}
+
+#endif /*!_mandel_progressif_h*/
@@ -0,0 +1,197 @@
+/*
+ * Calcul reprenable (option -reprise fichier) : on garde, pour chaque
+ * point encore actif a prof iterations, son orbite (z et le point de
+ * reference de la periodicite). Relance avec un prof plus grand, le
+ * calcul ne poursuit que ces points, a partir de la ou ils s'etaient
+ * arretes : l'image est identique a un calcul complet au nouveau prof.
+ *
+ * Le fichier est un fichier d'iterations (mandel_iter.h, lisible par
+ * recolorier) suivi d'une section "MORB" : les options du calcul et la
+ * formule, puis les indices des points actifs et leurs orbites.
+ *
+ * Seulement en float et en double, sans Mariani-Silver (dont les
+ * rectangles remplis n'ont pas d'orbite).
+ */
+
+#ifndef _mandel_reprise_h
+#define _mandel_reprise_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mandel_noyau.h"
+#include "mandel_iter.h"
+#include "mandel_formule.h"
+
+#define REPRISE_MAGIE "MORB"
+
+/* Options du calcul, qui doivent etre les memes pour reprendre */
+typedef struct {
+  char magie[4];
+  int precision, cardioide, periode;
+  double eps;
+  formule_id formule;
+  long n;                 /* nombre de points actifs */
+} reprise_section;
+
+typedef struct {
+  iter_entete e;          /* dimensions, domaine et prof atteint */
+  int *iter;              /* w*h nombres d'iterations */
+  long n, max;            /* points actifs, et place allouee */
+  long *indice;           /* pixel de chaque point actif */
+  orbite *orb;            /* et son orbite */
+} reprise;
+
+/* Calcul neuf d'une image w x h de profondeur prof sur le domaine donne */
+static inline int reprise_creer(reprise *r, int w, int h, int prof, double xmin,
+                                double ymin, double xmax, double ymax) {
+  memset(r, 0, sizeof(*r));
+  r->e = iter_entete_creer(w, h, prof, xmin, ymin, xmax, ymax);
+  r->iter = (int *)malloc((long)w*h*sizeof(int));
+  return r->iter ? 0 : -1;
+}
+
+/* Ajoute le point actif de pixel indice */
+static inline void reprise_ajouter(reprise *r, long indice, const orbite *o) {
+  if (r->n == r->max) {
+    r->max = r->max ? 2*r->max : 1024;
+    r->indice = (long *)realloc(r->indice, r->max*sizeof(long));
+    r->orb = (orbite *)realloc(r->orb, r->max*sizeof(orbite));
+    if (r->indice == NULL || r->orb == NULL) {
+      fprintf(stderr, "Erreur allocation memoire des orbites \n");
+      exit(1);
+    }
+  }
+  r->indice[r->n] = indice;
+  r->orb[r->n] = *o;
+  r->n++;
+}
+
+/**
+ * Calcule la ligne i d'un calcul neuf : ligne[j] = xy2color(x_j, y, prof)
+ * avec x_0 = xmin et x_{j+1} = x_j + xinc (comme xy2color_ligne), et garde
+ * les orbites des points encore actifs.
+ */
+static inline void reprise_ligne(reprise *r, double xmin, double xinc, double y,
+                                 int i, unsigned char *ligne) {
+  orbite orb[NOYAU_BLOC];
+  int w = r->e.w, prof = r->e.prof, j, k, m;
+  int *iter = r->iter + (long)i*w;
+
+  for (j = 0; j < w; j += m) {
+    m = w - j < NOYAU_BLOC ? w - j : NOYAU_BLOC;
+    for (k = 0; k < m; k++) {
+      orb[k].a = xmin;
+      orb[k].b = y;
+      xmin += xinc;
+    }
+    xy2iter_orbites(orb, m, 0, prof, iter + j);
+    for (k = 0; k < m; k++)
+      if (orb[k].actif) {
+#pragma omp critical (reprise)
+        reprise_ajouter(r, (long)i*w + j + k, &orb[k]);
+      }
+  }
+  iter2color(iter, w, prof, ligne);
+}
+
+/**
+ * Poursuit les points actifs jusqu'a prof (>= r->e.prof) iterations et
+ * met a jour les couleurs de l'image ima.
+ */
+static inline void reprise_poursuivre(reprise *r, int prof, unsigned char *ima) {
+  long npix = (long)r->e.w * r->e.h, k, n;
+  int debut = r->e.prof;
+
+  if (prof > debut) {
+    /* Les points interieurs deja reconnus le restent */
+    for (k = 0; k < npix; k++)
+      if (r->iter[k] == debut) r->iter[k] = prof;
+
+#pragma omp parallel for schedule(dynamic)
+    for (k = 0; k < r->n; k += NOYAU_BLOC) {
+      int iter[NOYAU_BLOC], q, m = r->n - k < NOYAU_BLOC ? r->n - k : NOYAU_BLOC;
+      xy2iter_orbites(r->orb + k, m, debut, prof, iter);
+      for (q = 0; q < m; q++) r->iter[r->indice[k + q]] = iter[q];
+    }
+
+    /* On ne garde que les points encore actifs */
+    for (n = 0, k = 0; k < r->n; k++)
+      if (r->orb[k].actif) {
+        r->indice[n] = r->indice[k];
+        r->orb[n] = r->orb[k];
+        n++;
+      }
+    r->n = n;
+    r->e.prof = prof;
+    r->e.octets = prof < 65536 ? 2 : 4;
+  }
+
+  for (k = 0; k < npix; k++) ima[k] = ITER2COLOR(r->iter[k], prof);
+}
+
+/* Sauve l'etat du calcul dans le fichier nom */
+static inline void reprise_sauver(const char *nom, const reprise *r) {
+  reprise_section s;
+  FILE *fd = fopen(nom, "w");
+
+  memcpy(s.magie, REPRISE_MAGIE, 4);
+  s.precision = noyau_precision;
+  s.cardioide = noyau_cardioide;
+  s.periode = noyau_periode;
+  s.eps = noyau_periode_eps;
+  s.formule = formule_identite();
+  s.n = r->n;
+  if (fd == NULL
+      || iter_ecrire(fd, &r->e, r->e.octets, r->iter, (long)r->e.w*r->e.h) != 0
+      || fwrite(&s, sizeof(s), 1, fd) != 1
+      || fwrite(r->indice, sizeof(long), r->n, fd) != (size_t)r->n
+      || fwrite(r->orb, sizeof(orbite), r->n, fd) != (size_t)r->n) {
+    fprintf(stderr, "erreur dans l'ecriture du fichier %s\n", nom);
+    exit(1);
+  }
+  fclose(fd);
+}
+
+/**
+ * Relit le fichier nom s'il existe et correspond au meme calcul (memes
+ * dimensions, domaine, options et formule, prof au plus egal a prof).
+ * @return 0 si le calcul peut reprendre, -1 sinon (calcul neuf)
+ */
+static inline int reprise_charger(const char *nom, reprise *r, int w, int h, int prof,
+                                  double xmin, double ymin, double xmax, double ymax) {
+  reprise_section s;
+  FILE *fd = fopen(nom, "r");
+  int ok;
+
+  memset(r, 0, sizeof(*r));
+  if (fd == NULL) return -1;
+  r->iter = iter_lire(fd, nom, &r->e);
+  ok = r->iter != NULL && fread(&s, sizeof(s), 1, fd) == 1
+    && memcmp(s.magie, REPRISE_MAGIE, 4) == 0
+    && s.n >= 0 && s.n <= (long)r->e.w*r->e.h;
+  if (ok) {
+    r->n = r->max = s.n;
+    r->indice = (long *)malloc((s.n + 1)*sizeof(long));
+    r->orb = (orbite *)malloc((s.n + 1)*sizeof(orbite));
+    ok = r->indice && r->orb
+      && fread(r->indice, sizeof(long), s.n, fd) == (size_t)s.n
+      && fread(r->orb, sizeof(orbite), s.n, fd) == (size_t)s.n;
+  }
+  fclose(fd);
+  if (ok && r->e.w == w && r->e.h == h && r->e.prof <= prof
+      && r->e.xmin == xmin && r->e.ymin == ymin
+      && r->e.xmax == xmax && r->e.ymax == ymax
+      && s.precision == noyau_precision && s.cardioide == noyau_cardioide
+      && s.periode == noyau_periode && (!s.periode || s.eps == noyau_periode_eps)
+      && formule_meme(&s.formule))
+    return 0;
+  fprintf(stderr, "Reprise: %s ne correspond pas a ce calcul, calcul complet\n", nom);
+  free(r->iter);
+  free(r->indice);
+  free(r->orb);
+  return -1;
+}
+
+#endif /*!_mandel_reprise_h*/
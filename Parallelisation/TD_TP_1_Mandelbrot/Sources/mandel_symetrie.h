@@ -0,0 +1,74 @@
+/*
+ * Symetrie par rapport a l'axe reel : le conjugue d'une orbite est
+ * l'orbite du conjugue, donc xy2iter(x, -y) = xy2iter(x, y). Si, pour un
+ * entier axe, la ligne axe - i de la grille est le miroir de la ligne i
+ * (a SYMETRIE_TOL pas pres), une seule ligne de chaque paire est
+ * calculee et l'autre est recopiee ensuite.
+ *
+ * Les lignes recopiees ont l'ordonnee exacte -y, celle de la grille peut
+ * en differer de quelques ulp : pres du bord de l'ensemble, quelques
+ * pixels peuvent differer d'un calcul complet.
+ *
+ * Active par defaut, l'option -nosymetrie fait tout calculer.
+ */
+
+#ifndef _mandel_symetrie_h
+#define _mandel_symetrie_h
+
+#include <string.h>
+#include <math.h>
+
+#ifndef SYMETRIE_TOL
+#define SYMETRIE_TOL 1e-3
+#endif
+
+/**
+ * Axe de la grille de h lignes (ymin, yinc) : la ligne axe - i est le
+ * miroir de la ligne i.
+ * @return axe, ou -1 si aucune ligne n'a son miroir dans l'image
+ */
+static inline int symetrie_axe(double ymin, double yinc, int h) {
+  double u = -2*ymin/yinc;
+  long k;
+  if (!(u > 0.5 && u < 2.*h)) return -1;
+  k = lround(u);
+  if (fabs(u - k) > SYMETRIE_TOL || k > 2*(h - 1) - 1) return -1;
+  return (int)k;
+}
+
+/* La ligne i est-elle calculee (et non recopiee de son miroir) ? */
+static inline int symetrie_calculee(int i, int axe) {
+  return axe < 0 || 2*i <= axe || i > axe;
+}
+
+/* Fin (exclue, au plus h) de la suite de lignes de meme nature que la ligne a */
+static inline int symetrie_suite(int a, int axe, int h) {
+  int b = a + 1, c = symetrie_calculee(a, axe);
+  while (b < h && symetrie_calculee(b, axe) == c) b++;
+  return b;
+}
+
+/* Range les lignes calculees dans lignes[], renvoie leur nombre */
+static inline int symetrie_lignes(int axe, int h, int *lignes) {
+  int i, n = 0;
+  for (i = 0; i < h; i++)
+    if (symetrie_calculee(i, axe)) lignes[n++] = i;
+  return n;
+}
+
+/* Recopie les lignes miroir d'un tableau de h lignes de taille octets */
+static inline void symetrie_recopier(void *tab, size_t taille, int h, int axe) {
+  char *t = (char *)tab;
+  int i;
+  if (axe < 0) return;
+  for (i = axe/2 + 1; i <= axe && i < h; i++)
+    memcpy(t + i*taille, t + (axe - i)*taille, taille);
+}
+
+/* Nombre de lignes recopiees */
+static inline int symetrie_recopiees(int axe, int h) {
+  if (axe < 0) return 0;
+  return (axe < h - 1 ? axe : h - 1) - axe/2;
+}
+
+#endif /*!_mandel_symetrie_h*/
@@ -0,0 +1,241 @@
+/*
+ * Recoloriage d'une image de Mandelbrot a partir de son fichier
+ * d'iterations (option -iter des programmes de calcul) : la fractale
+ * n'est pas recalculee, seule la conversion iterations -> couleur change.
+ *
+ * Compile avec -fopenmp, les pixels sont repartis entre les threads :
+ *   gcc -O2 -fopenmp -o recolorier recolorier.c -lm
+ * (sans -fopenmp, le programme est sequentiel).
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+
+/* Compile sans -fopenmp, les directives omp sont ignorees */
+#if !defined(_OPENMP) && defined(__GNUC__)
+#pragma GCC diagnostic ignored "-Wunknown-pragmas"
+#endif
+
+#include "rasterfile.h"
+#include "mandel_options.h"
+#include "mandel_iter.h"
+
+char info[] = "\
+Usage:\n\
+      recolorier fichier.iter [options]\n\
+\n\
+Options\n\
+      -palette p : cos (defaut, celle de mandel), original, gris ou feu\n\
+      -log : echelle logarithmique des iterations\n\
+      -egalisation : egalisation d'histogramme (couleurs equireparties)\n\
+      -sortie nom : image produite (defaut mandel.ras)\n\
+\n\
+Sans -log ni -egalisation, la couleur est celle de mandel (iterations\n\
+modulo 255) : avec la palette cos, l'image est identique a mandel.ras.\n\
+";
+
+double my_gettimeofday(){
+  struct timeval tmp_time;
+  gettimeofday(&tmp_time, NULL);
+  return tmp_time.tv_sec + (tmp_time.tv_usec * 1.0e-6L);
+}
+
+/**
+ * Convertion entier (4 octets) LINUX en un entier SUN
+ * @param i entier a convertir
+ * @return entier converti
+ */
+int swap(int i) {
+  int init = i;
+  int conv;
+  unsigned char *o, *d;
+
+  o = ( (unsigned char *) &init) + 3;
+  d = (unsigned char *) &conv;
+
+  *d++ = *o--;
+  *d++ = *o--;
+  *d++ = *o--;
+  *d++ = *o--;
+
+  return conv;
+}
+
+unsigned char cos_composante(int i, double freq) {
+  return (unsigned char)((cos(i/255.0*2*M_PI*freq) + 1) * 128);
+}
+
+/*
+ * Palettes : composante c (0 rouge, 1 vert, 2 bleu) de la couleur i.
+ * Comme dans mandel, l'indice 255 (interieur de l'ensemble) prend la
+ * couleur 0.
+ */
+unsigned char palette_cos(int c, int i) {
+  switch (c) {
+  case 0: return cos_composante(i, 13.0);
+  case 1: return cos_composante(i, 5.0);
+  default: return cos_composante(i + 10, 7.0);
+  }
+}
+
+unsigned char palette_original(int c, int i) {
+  switch (c) {
+  case 0: return i / 2;
+  case 1: return i % 190;
+  default: return (i % 120) * 2;
+  }
+}
+
+unsigned char palette_gris(int c, int i) {
+  (void)c;
+  return i;
+}
+
+unsigned char palette_feu(int c, int i) {
+  int v = 3*i - 255*c;       /* rouge, puis jaune, puis blanc */
+  return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+/**
+ *  Sauvegarde l'image au format rasterfile 8 bits avec la palette donnee
+ *    @param nom Nom de l'image
+ *    @param largeur largeur de l'image
+ *    @param hauteur hauteur de l'image
+ *    @param pal palette (couleur i = pal(c, 255 - i))
+ *    @param p pointeur vers tampon contenant l'image
+ */
+void sauver_rasterfile( char *nom, int largeur, int hauteur,
+                        unsigned char (*pal)(int, int), unsigned char *p) {
+  FILE *fd;
+  struct rasterfile file;
+  int c, i;
+  unsigned char o;
+
+  if ( (fd=fopen(nom, "w")) == NULL ) {
+    printf("erreur dans la creation du fichier %s \n",nom);
+    exit(1);
+  }
+
+  file.ras_magic  = swap(RAS_MAGIC);
+  file.ras_width  = swap(largeur);
+  file.ras_height = swap(hauteur);
+  file.ras_depth  = swap(8);
+  file.ras_length = swap(largeur*hauteur);
+  file.ras_type    = swap(RT_STANDARD);
+  file.ras_maptype = swap(RMT_EQUAL_RGB);
+  file.ras_maplength = swap(256*3);
+
+  fwrite(&file, sizeof(struct rasterfile), 1, fd);
+
+  for (c = 0; c < 3; c++) {
+    i = 256;
+    while( i--) {
+      o = pal(c, i);
+      fwrite( &o, sizeof(unsigned char), 1, fd);
+    }
+  }
+
+  fwrite( p, largeur*hauteur, sizeof(unsigned char), fd);
+  fclose( fd);
+}
+
+int main(int argc, char *argv[]) {
+  /* Fichier d'iterations */
+  iter_entete e;
+  int *iter;
+  long n, k, hors;
+  /* Image resultat */
+  unsigned char *ima;
+  /* Options */
+  char *opt, *sortie = "mandel.ras";
+  unsigned char (*pal)(int, int) = palette_cos;
+  int mode_log, mode_egal;
+  /* Chronometrage */
+  double debut, fin;
+
+  if( (opt = option_valeur(&argc, argv, "-palette"))) {
+    if( strcmp(opt, "original") == 0) pal = palette_original;
+    else if( strcmp(opt, "gris") == 0) pal = palette_gris;
+    else if( strcmp(opt, "feu") == 0) pal = palette_feu;
+    else if( strcmp(opt, "cos") != 0)
+      fprintf( stderr, "Palette %s inconnue, palette cos\n", opt);
+  }
+  mode_log = option_presente(&argc, argv, "-log");
+  mode_egal = option_presente(&argc, argv, "-egalisation");
+  if( (opt = option_valeur(&argc, argv, "-sortie"))) sortie = opt;
+
+  if( argc < 2) {
+    fprintf( stderr, "%s\n", info);
+    return 1;
+  }
+
+  iter = iter_charger( argv[1], &e);
+  if( iter == NULL) return 1;
+  fprintf( stderr, "Domaine: {[%lg,%lg]x[%lg,%lg]}\n", e.xmin, e.ymin, e.xmax, e.ymax);
+  fprintf( stderr, "Prof: %d\n", e.prof);
+  fprintf( stderr, "Dim image: %dx%d\n", e.w, e.h);
+
+  n = (long)e.w * e.h;
+  ima = (unsigned char *)malloc( n*sizeof(unsigned char));
+  if( ima == NULL) {
+    fprintf( stderr, "Erreur allocation memoire du tableau \n");
+    return 1;
+  }
+
+  debut = my_gettimeofday();
+
+  /* Un fichier abime peut sortir de [0,prof] : ramene pour tous les modes */
+  hors = 0;
+#pragma omp parallel for reduction(+:hors)
+  for (k = 0; k < n; k++)
+    if( iter[k] < 0 || iter[k] > e.prof) {
+      iter[k] = iter[k] < 0 ? 0 : e.prof;
+      hors++;
+    }
+  if( hors) fprintf( stderr, "Attention : %ld valeurs hors de [0,%d] ramenees\n", hors, e.prof);
+
+  if( mode_egal) {
+    /* Couleur = rang du nombre d'iterations parmi les points hors de l'ensemble */
+    long *hist = (long *)calloc( e.prof + 1, sizeof(long));
+    long total = 0;
+    int prof = e.prof;
+    if( hist == NULL) {
+      fprintf( stderr, "Erreur allocation memoire de l'histogramme \n");
+      return 1;
+    }
+#pragma omp parallel for reduction(+:hist[:prof + 1])
+    for (k = 0; k < n; k++) hist[iter[k]]++;
+    for (k = 0; k < prof; k++) { total += hist[k]; hist[k] = total; }
+    /* Tous les points dans l'ensemble : pas de division */
+    if( total == 0) total = 1;
+#pragma omp parallel for
+    for (k = 0; k < n; k++)
+      ima[k] = iter[k] == prof ? 255 : (int)(254. * hist[iter[k]] / total);
+    free( hist);
+  } else if( mode_log) {
+    /* Echelle logarithmique jusqu'au plus grand nombre d'iterations hors de l'ensemble */
+    int prof = e.prof, max = 1;
+    double l;
+#pragma omp parallel for reduction(max:max)
+    for (k = 0; k < n; k++) if( iter[k] < prof && iter[k] > max) max = iter[k];
+    l = 254. / log1p( max);
+#pragma omp parallel for
+    for (k = 0; k < n; k++)
+      ima[k] = iter[k] == prof ? 255 : (int)(l * log1p( iter[k]));
+  } else {
+    /* Comme mandel */
+#pragma omp parallel for
+    for (k = 0; k < n; k++) ima[k] = iter[k] == e.prof ? 255 : iter[k] % 255;
+  }
+
+  fin = my_gettimeofday();
+  fprintf( stderr, "Temps de recoloriage : %g sec\n", fin - debut);
+
+  sauver_rasterfile( sortie, e.w, e.h, pal, ima);
+  free( iter);
+  free( ima);
+  return 0;
+}
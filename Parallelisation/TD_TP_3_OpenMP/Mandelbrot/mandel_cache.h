@@ -0,0 +1,221 @@
+/*
+ * Reutilisation d'une vue precedente (option -cache fichier) : le fichier
+ * est le fichier d'iterations (mandel_iter.h) du dernier calcul. Une
+ * colonne de la nouvelle vue est reprise si son abscisse tombe sur une
+ * colonne de l'ancienne grille (a CACHE_TOL pas pres), de meme pour les
+ * lignes, et un pixel si sa ligne et sa colonne le sont : deplacement d'un
+ * nombre entier de pixels, zoom d'un facteur entier (2, 4...) ou son
+ * inverse, meme prof. Seuls les autres points sont calcules ; le fichier
+ * est ensuite remplace par la nouvelle vue.
+ *
+ * Le fichier reste lisible par recolorier : une section "MCAC" suit les
+ * iterations, avec la precision, le test de la cardioide, la detection
+ * de periodicite et la formule du calcul.
+ * Une vue calculee autrement (en precision auto, un deplacement peut
+ * changer la precision choisie) n'est pas reprise.
+ *
+ * Les points repris ont ete calcules avec les coordonnees de l'ancienne
+ * grille, qui peuvent differer de quelques ulp : pres du bord de
+ * l'ensemble, quelques pixels peuvent differer d'un calcul complet.
+ */
+
+#ifndef _mandel_cache_h
+#define _mandel_cache_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "mandel_noyau.h"
+#include "mandel_iter.h"
+#include "mandel_formule.h"
+
+#ifndef CACHE_TOL
+#define CACHE_TOL 1e-3
+#endif
+
+#define CACHE_MAGIE "MCAC"
+
+/* Options du calcul, qui doivent etre les memes pour reprendre des points */
+typedef struct {
+  char magie[4];
+  int precision, cardioide, periode;
+  double eps;
+  formule_id formule;
+} cache_section;
+
+typedef struct {
+  iter_entete e;          /* vue precedente */
+  int *iter;              /* ses nombres d'iterations */
+  int *ligne, *colonne;   /* ligne/colonne de l'ancienne vue, -1 sinon */
+  long long repris;       /* points repris */
+} cache;
+
+/*
+ * Indices dans l'ancienne grille (min0, inc0, n0) des n points min + k.inc.
+ * Decalage et rapport des pas sont calcules a part : min + k.inc perdrait
+ * les pas plus petits qu'un ulp (double-double).
+ */
+static inline int cache_aligner(int *indice, int n, double min, double inc,
+                                int n0, double min0, double inc0) {
+  int k, communs = 0;
+  long q;
+  double u, decalage = (min - min0) / inc0, rapport = inc / inc0;
+  for (k = 0; k < n; k++) {
+    u = decalage + k*rapport;
+    q = lround(u);
+    indice[k] = fabs(u - q) < CACHE_TOL && q >= 0 && q < n0 ? (int)q : -1;
+    communs += indice[k] >= 0;
+  }
+  return communs;
+}
+
+/* Options du calcul en cours */
+static inline cache_section cache_options(void) {
+  cache_section s;
+  memset(&s, 0, sizeof(s));
+  memcpy(s.magie, CACHE_MAGIE, 4);
+  s.precision = noyau_precision;
+  s.cardioide = noyau_cardioide;
+  s.periode = noyau_periode;
+  s.eps = noyau_periode ? noyau_periode_eps : 0.;
+  s.formule = formule_identite();
+  return s;
+}
+
+/* Sauve la vue calculee (e, iter) et les options du calcul dans le fichier nom */
+static inline void cache_sauver(const char *nom, const iter_entete *e, const int *iter) {
+  cache_section s = cache_options();
+  FILE *fd = fopen(nom, "w");
+  if (fd == NULL || iter_ecrire(fd, e, e->octets, iter, (long)e->w*e->h) != 0
+      || fwrite(&s, sizeof(s), 1, fd) != 1) {
+    fprintf(stderr, "erreur dans l'ecriture du fichier %s\n", nom);
+    exit(1);
+  }
+  fclose(fd);
+}
+
+/**
+ * Charge la vue precedente du fichier nom pour la grille g (w x h, prof).
+ * @return 0 si des points peuvent etre repris, -1 sinon (raison affichee)
+ */
+static inline int cache_charger(const char *nom, cache *c, const grille *g,
+                                int w, int h, int prof) {
+  FILE *fd = fopen(nom, "r");
+  cache_section s, ici = cache_options();
+  double xinc0, yinc0;
+  int lu;
+
+  memset(c, 0, sizeof(*c));
+  if (fd == NULL) return -1;
+  c->iter = iter_lire(fd, nom, &c->e);
+  lu = c->iter != NULL && fread(&s, sizeof(s), 1, fd) == 1;
+  fclose(fd);
+  if (c->iter == NULL) return -1;
+  if (!lu || memcmp(s.magie, CACHE_MAGIE, 4) != 0) {
+    fprintf(stderr, "Cache: %s ne donne pas les options du calcul, rien n'est repris\n", nom);
+    free(c->iter);
+    return -1;
+  }
+  if (c->e.prof != prof) {
+    fprintf(stderr, "Cache: prof %d different, rien n'est repris\n", c->e.prof);
+    free(c->iter);
+    return -1;
+  }
+  if (s.precision != ici.precision) {
+    fprintf(stderr, "Cache: vue precedente en %s (ici %s), rien n'est repris\n",
+            s.precision >= PRECISION_FLOAT && s.precision <= PRECISION_DD
+            ? precision_noms[s.precision] : "?", precision_noms[ici.precision]);
+    free(c->iter);
+    return -1;
+  }
+  if (s.cardioide != ici.cardioide) {
+    fprintf(stderr, "Cache: vue precedente %s le test de la cardioide, rien n'est repris\n",
+            s.cardioide ? "avec" : "sans");
+    free(c->iter);
+    return -1;
+  }
+  if (s.periode != ici.periode || s.eps != ici.eps) {
+    fprintf(stderr, "Cache: detection de periodicite differente, rien n'est repris\n");
+    free(c->iter);
+    return -1;
+  }
+  if (!formule_meme(&s.formule)) {
+    fprintf(stderr, "Cache: vue precedente d'une autre formule, rien n'est repris\n");
+    free(c->iter);
+    return -1;
+  }
+
+  xinc0 = (c->e.xmax - c->e.xmin) / (c->e.w - 1);
+  yinc0 = (c->e.ymax - c->e.ymin) / (c->e.h - 1);
+  c->ligne = (int *)malloc(h*sizeof(int));
+  c->colonne = (int *)malloc(w*sizeof(int));
+  if (c->ligne == NULL || c->colonne == NULL
+      || cache_aligner(c->colonne, w, g->xmin, g->xinc, c->e.w, c->e.xmin, xinc0) == 0
+      || cache_aligner(c->ligne, h, g->ymin, g->yinc, c->e.h, c->e.ymin, yinc0) == 0) {
+    fprintf(stderr, "Cache: grille non alignee sur la vue precedente\n");
+    free(c->iter);
+    free(c->ligne);
+    free(c->colonne);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Nombres d'iterations de la ligne i (ordonnee y, comme xy2iter_grille) :
+ * les points de l'ancienne vue sont recopies, les autres calcules.
+ */
+static inline void cache_ligne(cache *c, const grille *g, int i, double y, int w,
+                               int prof, int *iter) {
+  double pa[NOYAU_BLOC], pb[NOYAU_BLOC];
+  int pj[NOYAU_BLOC], it[NOYAU_BLOC];
+  const int *ancienne;
+  int j, j0, k, m = 0, repris = 0;
+
+  if (c->ligne[i] < 0) {
+    xy2iter_grille(g, i, y, 0, w, prof, iter);
+    return;
+  }
+
+  ancienne = c->iter + (long)c->ligne[i]*c->e.w;
+  for (j = 0; j < w; j++)
+    if (c->colonne[j] >= 0) {
+      iter[j] = ancienne[c->colonne[j]];
+      repris++;
+    }
+
+  if (noyau_precision == PRECISION_DD) {
+    /* par morceaux de points consecutifs (coordonnees en double-double) */
+    for (j = 0; j < w; j++) {
+      if (c->colonne[j] >= 0) continue;
+      for (j0 = j; j < w && c->colonne[j] < 0; j++);
+      xy2iter_grille(g, i, y, j0, j - j0, prof, iter + j0);
+    }
+  } else {
+    /* points quelconques, par paquets de NOYAU_BLOC */
+    for (j = 0; j <= w; j++) {
+      if (j < w && c->colonne[j] < 0) {
+        pa[m] = g->xmin + j*g->xinc;
+        pb[m] = y;
+        pj[m++] = j;
+      }
+      if (m == NOYAU_BLOC || (j == w && m > 0)) {
+        xy2iter_points(pa, pb, m, prof, it);
+        for (k = 0; k < m; k++) iter[pj[k]] = it[k];
+        m = 0;
+      }
+    }
+  }
+#pragma omp atomic
+  c->repris += repris;
+}
+
+/* Affiche la part des npix points de l'image repris de la vue precedente */
+static inline void cache_afficher(const cache *c, long long npix) {
+  fprintf(stderr, "Cache: %lld points repris sur %lld (%.1f%%)\n",
+          c->repris, npix, npix ? 100. * c->repris / npix : 0.);
+}
+
+#endif /*!_mandel_cache_h*/
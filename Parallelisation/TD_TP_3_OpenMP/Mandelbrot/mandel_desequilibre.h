@@ -0,0 +1,40 @@
+/*
+ * Bilan d'une repartition des lignes entre P processus ou threads : temps
+ * prevu (s'il y en a un) et mesure de chaque partie, et desequilibre, le
+ * temps de la plus longue sur la moyenne. Commun a la partition statique
+ * (mandel_partition.h) et a la distribution dynamique (mandel_dynamique).
+ */
+
+#ifndef _mandel_desequilibre_h
+#define _mandel_desequilibre_h
+
+#include <stdio.h>
+
+/*
+ * Temps prevu (NULL si pas d'estimation) et mesure de chacune des P
+ * parties [bornes[r], bornes[r+1]), et desequilibre.
+ */
+static inline void desequilibre_afficher(const char *nom, int P, const int *bornes,
+                                         const double *prevu, const double *mesure) {
+  double pmax = 0., psom = 0., mmax = 0., msom = 0.;
+  int r;
+  for (r = 0; r < P; r++) {
+    if (prevu)
+      fprintf(stderr, "%s %d: %d lignes, prevu %.3f sec, mesure %.3f sec\n",
+              nom, r, bornes[r+1] - bornes[r], prevu[r], mesure[r]);
+    else
+      fprintf(stderr, "%s %d: %d lignes, mesure %.3f sec\n",
+              nom, r, bornes[r+1] - bornes[r], mesure[r]);
+    if (prevu && prevu[r] > pmax) pmax = prevu[r];
+    if (prevu) psom += prevu[r];
+    if (mesure[r] > mmax) mmax = mesure[r];
+    msom += mesure[r];
+  }
+  if (prevu && psom > 0.)
+    fprintf(stderr, "Desequilibre (max/moyenne): prevu %.2f, mesure %.2f\n",
+            pmax * P / psom, msom > 0. ? mmax * P / msom : 0.);
+  else if (msom > 0.)
+    fprintf(stderr, "Desequilibre (max/moyenne): mesure %.2f\n", mmax * P / msom);
+}
+
+#endif /*!_mandel_desequilibre_h*/
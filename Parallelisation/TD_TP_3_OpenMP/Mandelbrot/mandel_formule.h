@@ -0,0 +1,160 @@
+/*
+ * Autres formules que z^2 + c (options -degre d et -julia a,b) :
+ *
+ *  - Multibrot : z_{n+1} = z_n^d + c, z_0 = 0, pour 2 <= d <= FORMULE_DEGRE_MAX
+ *  - Julia     : z_{n+1} = z_n^d + k, z_0 = c, k = a + i.b fixe
+ *
+ * Un noyau est instancie par degre et par mode (NOYAU_POINTS_FORMULE,
+ * double sur 8 voies) : d est une constante, la puissance se deroule en
+ * d - 1 produits complexes, sans appel a pow ni boucle sur d. Le noyau
+ * choisi est range dans noyau_formule, que xy2iter_points() et
+ * xy2iter_orbites() appellent a la place des noyaux habituels : tous les
+ * programmes (et Mariani-Silver, le rendu progressif, le lissage) s'en
+ * servent sans autre changement.
+ *
+ * Toujours en double (precision_choisir). Le test de la cardioide ne vaut
+ * que pour z^2 + c ; la symetrie par rapport a l'axe reel vaut pour tout
+ * degre, et pour Julia si k est reel (formule_symetrique). Les fichiers
+ * -reprise et -cache gardent la formule (formule_identite) et ne servent
+ * qu'a un calcul de la meme.
+ *
+ * -formule "expression" donne une iteration quelconque, compilee a
+ * l'execution (mandel_expression.h) ; -julia s'y applique de meme (c
+ * vaut alors k), -degre est ignore.
+ */
+
+#ifndef _mandel_formule_h
+#define _mandel_formule_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mandel_noyau.h"
+#include "mandel_options.h"
+#include "mandel_expression.h"
+
+/* Un noyau par degre, de 2 a FORMULE_DEGRE_MAX */
+#define FORMULE_DEGRE_MAX 8
+
+#define FORMULE(d)                                                          \
+  NOYAU_POINTS_FORMULE(multibrot##d, double, long long, 8, 0., NOYAU_CLONES, d, 0) \
+  NOYAU_POINTS_FORMULE(julia##d, double, long long, 8, 0., NOYAU_CLONES, d, 1)
+
+/* z^2 + c : points_double */
+NOYAU_POINTS_FORMULE(julia2, double, long long, 8, 0., NOYAU_CLONES, 2, 1)
+FORMULE(3)
+FORMULE(4)
+FORMULE(5)
+FORMULE(6)
+FORMULE(7)
+FORMULE(8)
+
+/* formule_noyaux[julia][d] */
+static const orbites_fn formule_noyaux[2][FORMULE_DEGRE_MAX + 1] = {
+  { NULL, NULL, NULL, multibrot3_orbites, multibrot4_orbites,
+    multibrot5_orbites, multibrot6_orbites, multibrot7_orbites,
+    multibrot8_orbites },
+  { NULL, NULL, julia2_orbites, julia3_orbites, julia4_orbites,
+    julia5_orbites, julia6_orbites, julia7_orbites, julia8_orbites }
+};
+
+/* Formule choisie */
+static int formule_degre = 2, formule_julia = 0;
+static const char *formule_expression = NULL;
+
+/**
+ * Choisit z^d + c, ou z^d + (a + i.b) si julia : fixe noyau_formule
+ * (NULL pour z^2 + c) et la constante de Julia. A appeler avant
+ * precision_choisir() et toute region parallele.
+ * @return 0, -1 si le degre n'est pas disponible (formule inchangee)
+ */
+static inline int formule_choisir(int d, int julia, double a, double b) {
+  if (d < 2 || d > FORMULE_DEGRE_MAX) {
+    fprintf(stderr, "Degre %d non disponible (2 a %d)\n", d, FORMULE_DEGRE_MAX);
+    return -1;
+  }
+  formule_degre = d;
+  formule_julia = julia != 0;
+  noyau_julia_a = julia ? a : 0.;
+  noyau_julia_b = julia ? b : 0.;
+  noyau_formule = formule_noyaux[formule_julia][d];
+  return 0;
+}
+
+/**
+ * Options -degre d, -julia a,b et -formule expression (retirees de argv).
+ * @return 0, -1 si l'une est invalide (formule z^2 + c)
+ */
+static inline int formule_options(int *argc, char *argv[]) {
+  char *opt, *expr;
+  int d = 2, julia = 0;
+  double a = 0., b = 0.;
+
+  expr = option_valeur(argc, argv, "-formule");
+  if ((opt = option_valeur(argc, argv, "-degre"))) d = atoi(opt);
+  if ((opt = option_valeur(argc, argv, "-julia"))) {
+    if (sscanf(opt, "%lf,%lf", &a, &b) != 2) {
+      fprintf(stderr, "-julia %s : attendu a,b\n", opt);
+      return -1;
+    }
+    julia = 1;
+  }
+  if (expr != NULL) {
+    if (expression_charger(expr, julia) != 0) return -1;
+    formule_choisir(2, julia, a, b);
+    formule_expression = expr;
+    noyau_formule = expression_orbites;
+    return 0;
+  }
+  return formule_choisir(d, julia, a, b);
+}
+
+/* Identite de la formule, gardee dans les fichiers -reprise et -cache */
+typedef struct {
+  int degre, julia;               /* degre 0 : expression */
+  double julia_a, julia_b;
+  unsigned long long expression;  /* hachage du texte de -formule, 0 sans */
+} formule_id;
+
+static inline formule_id formule_identite(void) {
+  formule_id f;
+  memset(&f, 0, sizeof(f));
+  f.degre = formule_expression != NULL ? 0 : formule_degre;
+  f.julia = formule_julia;
+  f.julia_a = noyau_julia_a;
+  f.julia_b = noyau_julia_b;
+  if (formule_expression != NULL)
+    f.expression = expression_hachage(formule_expression, 0xcbf29ce484222325ULL);
+  return f;
+}
+
+/* La formule f est-elle celle du calcul en cours ? */
+static inline int formule_meme(const formule_id *f) {
+  formule_id ici = formule_identite();
+  return f->degre == ici.degre && f->julia == ici.julia
+    && f->julia_a == ici.julia_a && f->julia_b == ici.julia_b
+    && f->expression == ici.expression;
+}
+
+/* Les lignes symetriques par rapport a l'axe reel sont-elles identiques ? */
+static inline int formule_symetrique(void) {
+  if (formule_expression != NULL && expression_complexe) return 0;
+  return !formule_julia || noyau_julia_b == 0.;
+}
+
+static inline void formule_afficher(void) {
+  if (formule_expression != NULL) {
+    fprintf(stderr, "Formule: z -> %s (%s)\n", formule_expression,
+            expression_chemin);
+    if (formule_julia)
+      fprintf(stderr, "Julia: z_0 = pixel, c = %lg%+lgi\n",
+              noyau_julia_a, noyau_julia_b);
+  } else if (formule_julia)
+    fprintf(stderr, "Formule: Julia z^%d + (%lg%+lgi)\n",
+            formule_degre, noyau_julia_a, noyau_julia_b);
+  else if (formule_degre != 2)
+    fprintf(stderr, "Formule: z^%d + c\n", formule_degre);
+}
+
+#endif /*!_mandel_formule_h*/
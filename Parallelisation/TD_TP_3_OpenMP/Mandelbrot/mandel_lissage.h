@@ -0,0 +1,155 @@
+/*
+ * Anticrenelage adaptatif (option -lissage n) : apres le calcul normal,
+ * les pixels de bord, dont le nombre d'iterations s'ecarte de plus de
+ * seuil de celui d'un des 8 voisins, sont reechantillonnes : n x n points,
+ * un par case d'une grille n x n du pixel, a une position tiree au hasard
+ * dans la case (jitter). La couleur du pixel est la moyenne des couleurs
+ * RGB de ses echantillons, l'image produite est donc en 24 bits.
+ *
+ * Le tirage ne depend que du pixel : l'image ne depend ni du nombre de
+ * threads ni du nombre de processus.
+ *
+ * En float et en double seulement : en double-double, un decalage d'une
+ * fraction de pixel n'est pas representable dans les coordonnees double.
+ */
+
+#ifndef _mandel_lissage_h
+#define _mandel_lissage_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mandel_noyau.h"
+
+/* Ecart d'iterations a partir duquel un pixel est un pixel de bord */
+#ifndef LISSAGE_SEUIL
+#define LISSAGE_SEUIL 4
+#endif
+
+/* Au plus LISSAGE_MAX x LISSAGE_MAX echantillons par pixel */
+#define LISSAGE_MAX 16
+
+/* Pixels de bord par message (version MPI) */
+#define LISSAGE_PAQUET 4096
+
+/* Couleur k de l'image -> rouge, vert, bleu (fournie par le programme) */
+typedef unsigned char lissage_palette[256][3];
+
+/**
+ * Range dans liste les indices des pixels de bord de l'image iter (w x h).
+ * @return leur nombre, -1 en cas d'erreur d'allocation
+ */
+static inline long lissage_bords(const int *iter, int w, int h, int seuil, int *liste) {
+  int *nb = (int *)malloc(h*sizeof(int));
+  long n = 0;
+  int i;
+
+  if (nb == NULL) return -1;
+
+  /* chaque ligne range ses pixels de bord a sa place dans liste... */
+#pragma omp parallel for
+  for (i = 0; i < h; i++) {
+    int *l = liste + (long)i*w, i0 = i > 0 ? i - 1 : i, i1 = i < h - 1 ? i + 1 : i;
+    int j, j0, j1, di, dj, v, bord, m = 0;
+    for (j = 0; j < w; j++) {
+      j0 = j > 0 ? j - 1 : j;
+      j1 = j < w - 1 ? j + 1 : j;
+      v = iter[(long)i*w + j];
+      bord = 0;
+      for (di = i0; di <= i1; di++)
+        for (dj = j0; dj <= j1; dj++)
+          bord |= abs(iter[(long)di*w + dj] - v) > seuil;
+      if (bord) l[m++] = i*w + j;
+    }
+    nb[i] = m;
+  }
+  /* ... puis on les regroupe au debut */
+  for (i = 0; i < h; i++) {
+    memmove(liste + n, liste + (long)i*w, nb[i]*sizeof(int));
+    n += nb[i];
+  }
+  free(nb);
+  return n;
+}
+
+/* Tirage dans [0,1) ne dependant que du pixel p et de l'echantillon k */
+static inline double lissage_alea(unsigned int p, unsigned int k) {
+  unsigned int x = p * 0x9e3779b1u ^ (k + 0x7f4a7c15u) * 0x85ebca6bu;
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return (x >> 8) * (1. / 16777216.);
+}
+
+/**
+ * Couleurs RGB des m pixels de bord liste[] d'une image de largeur w sur
+ * la grille g : moyenne de n x n echantillons (n <= LISSAGE_MAX).
+ */
+static inline void lissage_pixels(const grille *g, const int *liste, long m, int w,
+                                  int n, int prof, const lissage_palette pal,
+                                  unsigned char *rgb) {
+  /* autant de pixels que possible par appel au noyau */
+  long q0, np = n*n < NOYAU_BLOC ? NOYAU_BLOC / (n*n) : 1;
+#pragma omp parallel for schedule(dynamic, 4)
+  for (q0 = 0; q0 < m; q0 += np) {
+    double pa[LISSAGE_MAX*LISSAGE_MAX], pb[LISSAGE_MAX*LISSAGE_MAX];
+    int it[LISSAGE_MAX*LISSAGE_MAX], i, j, a, b, k, c, e;
+    long q, q1 = q0 + np < m ? q0 + np : m;
+    double x, y;
+
+    for (e = 0, q = q0; q < q1; q++) {
+      i = liste[q] / w;
+      j = liste[q] % w;
+      x = g->xmin + j*g->xinc;
+      y = g->ymin + i*g->yinc;
+      for (b = 0; b < n; b++)
+        for (a = 0; a < n; a++, e++) {
+          k = b*n + a;
+          pa[e] = x + ((a + lissage_alea(liste[q], 2*k)) / n - 0.5) * g->xinc;
+          pb[e] = y + ((b + lissage_alea(liste[q], 2*k + 1)) / n - 0.5) * g->yinc;
+        }
+    }
+    xy2iter_points(pa, pb, e, prof, it);
+    for (e = 0, q = q0; q < q1; q++) {
+      int somme[3] = {0, 0, 0};
+      for (k = 0; k < n*n; k++, e++)
+        for (c = 0; c < 3; c++) somme[c] += pal[ITER2COLOR(it[e], prof)][c];
+      for (c = 0; c < 3; c++)
+        rgb[3*q + c] = (somme[c] + n*n/2) / (n*n);
+    }
+  }
+}
+
+/* Image RGB (3 octets par pixel) des npix couleurs ima */
+static inline void lissage_rgb(const unsigned char *ima, long npix,
+                               const lissage_palette pal, unsigned char *rgb) {
+  long k;
+#pragma omp parallel for
+  for (k = 0; k < npix; k++) {
+    rgb[3*k] = pal[ima[k]][0];
+    rgb[3*k + 1] = pal[ima[k]][1];
+    rgb[3*k + 2] = pal[ima[k]][2];
+  }
+}
+
+/* Remplace dans l'image rgb les couleurs des m pixels liste[] */
+static inline void lissage_placer(const int *liste, long m, const unsigned char *bords,
+                                  unsigned char *rgb) {
+  long q;
+  for (q = 0; q < m; q++) {
+    rgb[3L*liste[q]] = bords[3*q];
+    rgb[3L*liste[q] + 1] = bords[3*q + 1];
+    rgb[3L*liste[q] + 2] = bords[3*q + 2];
+  }
+}
+
+/* Affiche la part des npix pixels reechantillonnes */
+static inline void lissage_afficher(long m, long npix, int n) {
+  fprintf(stderr, "Lissage: %ld pixels de bord sur %ld (%.1f%%), %d echantillons\n",
+          m, npix, npix ? 100. * m / npix : 0., n*n);
+}
+
+#endif /*!_mandel_lissage_h*/
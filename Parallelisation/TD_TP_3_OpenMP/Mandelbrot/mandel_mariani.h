@@ -0,0 +1,181 @@
+/*
+ * Rendu par subdivision recursive de Mariani-Silver.
+ *
+ * On ne calcule que le bord d'un rectangle : si tous les points du bord
+ * ont la meme couleur, l'interieur est rempli avec cette couleur sans
+ * calcul, sinon le rectangle est coupe en quatre par une ligne et une
+ * colonne mediane (calculees) et chaque quart est traite de la meme
+ * facon. En dessous de taille_min pixels de cote, l'interieur est
+ * calcule entierement.
+ *
+ * Les zones d'un meme nombre d'iterations entourent l'ensemble : un bord
+ * uniforme different de 255 peut encercler l'ensemble entier, et donc
+ * le point 0. Un rectangle contenant 0 n'est donc rempli que si son bord
+ * vaut 255 (l'ensemble est plein, sans trou), sinon il est subdivise.
+ *
+ * Compile avec OpenMP, les quarts de plus de taille_tache pixels sont
+ * des taches (omp task) : appeler mariani_silver() depuis un bloc
+ * "omp single" d'une region parallele. Les quarts ne partagent que
+ * leurs bords, deja calcules, donc les taches ecrivent dans des zones
+ * disjointes de l'image.
+ *
+ * Si iter n'est pas NULL, les nombres d'iterations y sont aussi ranges
+ * (meme disposition que ima) ; un bord n'est alors uniforme que si les
+ * iterations le sont aussi.
+ *
+ * Active par l'option -mariani ; -taille_min n fixe la taille minimale.
+ */
+
+#ifndef _mandel_mariani_h
+#define _mandel_mariani_h
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mandel_noyau.h"
+
+#ifndef MARIANI_TAILLE_MIN
+#define MARIANI_TAILLE_MIN 8
+#endif
+
+typedef struct {
+  unsigned char *ima;     /* image (ou bloc) a remplir, lignes de w pixels */
+  int w;
+  grille g;               /* grille de l'image complete */
+  int i0;                 /* ligne de la grille ou commence ima */
+  int prof;
+  int taille_min;         /* cote en dessous duquel on calcule tout */
+  int taille_tache;       /* surface au dessus de laquelle on cree une tache */
+  long long calcules;     /* nombre de points calcules par xy2color */
+  int *iter;              /* nombres d'iterations (facultatif) */
+} mariani;
+
+/* Calcule les pixels j0..j1 de la ligne i */
+static inline void mariani_ligne(mariani *m, int i, int j0, int j1) {
+  long p = (long)i*m->w + j0;
+  double y = m->g.ymin + (m->i0 + i)*m->g.yinc;
+  if (j1 < j0) return;
+  if (m->iter) {
+    xy2iter_grille(&m->g, m->i0 + i, y, j0, j1 - j0 + 1, m->prof, m->iter + p);
+    iter2color(m->iter + p, j1 - j0 + 1, m->prof, m->ima + p);
+  } else {
+    xy2color_grille(&m->g, m->i0 + i, y, j0, j1 - j0 + 1, m->prof, m->ima + p);
+  }
+#pragma omp atomic
+  m->calcules += j1 - j0 + 1;
+}
+
+/* Calcule les pixels i0..i1 de la colonne j (par paquets de NOYAU_BLOC) */
+static inline void mariani_colonne(mariani *m, int j, int i0, int i1) {
+  double pa[NOYAU_BLOC], pb[NOYAU_BLOC];
+  int iter[NOYAU_BLOC], i, k, n;
+  long p;
+  if (i1 < i0) return;
+  for (i = i0; i <= i1; i += n) {
+    n = i1 - i + 1 < NOYAU_BLOC ? i1 - i + 1 : NOYAU_BLOC;
+    if (noyau_precision == PRECISION_DD) {
+      /* un pixel a la fois, coordonnees recalculees en double-double */
+      for (k = 0; k < n; k++)
+        xy2iter_grille(&m->g, m->i0 + i + k, 0., j, 1, m->prof, iter + k);
+    } else {
+      for (k = 0; k < n; k++) {
+        pa[k] = m->g.xmin + j*m->g.xinc;
+        pb[k] = m->g.ymin + (m->i0 + i + k)*m->g.yinc;
+      }
+      xy2iter_points(pa, pb, n, m->prof, iter);
+    }
+    for (k = 0; k < n; k++) {
+      p = (long)(i + k)*m->w + j;
+      m->ima[p] = ITER2COLOR(iter[k], m->prof);
+      if (m->iter) m->iter[p] = iter[k];
+    }
+  }
+#pragma omp atomic
+  m->calcules += i1 - i0 + 1;
+}
+
+/* Les pixels p et q ont-ils le meme resultat ? */
+static inline int mariani_pareil(const mariani *m, long p, long q) {
+  return m->ima[p] == m->ima[q] && (m->iter == NULL || m->iter[p] == m->iter[q]);
+}
+
+/*
+ * Traite l'interieur du rectangle de coins (i0,j0) et (i1,j1) inclus,
+ * dont le bord est deja calcule.
+ */
+static inline void mariani_rect(mariani *m, int i0, int j0, int i1, int j1) {
+  unsigned char *ima = m->ima, v;
+  int w = m->w, i, j, k, im, jm, uniforme = 1;
+  long c = (long)i0*w + j0;
+  double x0, x1, y0, y1;
+
+  if (i1 - i0 < 2 || j1 - j0 < 2) return;
+
+  /* Bord uniforme ? */
+  v = ima[c];
+  for (j = j0; j <= j1 && uniforme; j++)
+    uniforme = mariani_pareil(m, (long)i0*w + j, c) && mariani_pareil(m, (long)i1*w + j, c);
+  for (i = i0 + 1; i < i1 && uniforme; i++)
+    uniforme = mariani_pareil(m, (long)i*w + j0, c) && mariani_pareil(m, (long)i*w + j1, c);
+
+  /* Le rectangle contient-il le point 0 ? */
+  x0 = m->g.xmin + j0*m->g.xinc; x1 = m->g.xmin + j1*m->g.xinc;
+  y0 = m->g.ymin + (m->i0 + i0)*m->g.yinc; y1 = m->g.ymin + (m->i0 + i1)*m->g.yinc;
+  if (uniforme && v != 255 && x0*x1 <= 0 && y0*y1 <= 0) uniforme = 0;
+
+  if (uniforme) {
+    for (i = i0 + 1; i < i1; i++) {
+      memset(ima + (long)i*w + j0 + 1, v, j1 - j0 - 1);
+      if (m->iter)
+        for (k = j0 + 1; k < j1; k++) m->iter[(long)i*w + k] = m->iter[c];
+    }
+    return;
+  }
+
+  /* Petit rectangle : calcul complet de l'interieur */
+  if (i1 - i0 - 1 <= m->taille_min || j1 - j0 - 1 <= m->taille_min) {
+    for (i = i0 + 1; i < i1; i++) mariani_ligne(m, i, j0 + 1, j1 - 1);
+    return;
+  }
+
+  /* Decoupage en quatre par la ligne im et la colonne jm */
+  im = (i0 + i1) / 2;
+  jm = (j0 + j1) / 2;
+  mariani_ligne(m, im, j0 + 1, j1 - 1);
+  mariani_colonne(m, jm, i0 + 1, im - 1);
+  mariani_colonne(m, jm, im + 1, i1 - 1);
+#ifdef _OPENMP
+  int grand = (long)(i1 - i0) * (j1 - j0) > m->taille_tache;
+#endif
+
+#pragma omp task if (grand)
+  mariani_rect(m, i0, j0, im, jm);
+#pragma omp task if (grand)
+  mariani_rect(m, i0, jm, im, j1);
+#pragma omp task if (grand)
+  mariani_rect(m, im, j0, i1, jm);
+#pragma omp task if (grand)
+  mariani_rect(m, im, jm, i1, j1);
+}
+
+/**
+ * Calcule les h lignes de m->ima par subdivision de Mariani-Silver.
+ * Le pixel (i,j) de ima est le pixel (i0 + i, j) de la grille.
+ */
+static inline void mariani_silver(mariani *m, int h) {
+  mariani_ligne(m, 0, 0, m->w - 1);
+  if (h > 1) mariani_ligne(m, h - 1, 0, m->w - 1);
+  if (m->w > 1) {
+    mariani_colonne(m, 0, 1, h - 2);
+    mariani_colonne(m, m->w - 1, 1, h - 2);
+  }
+  mariani_rect(m, 0, 0, h - 1, m->w - 1);
+}
+
+/* Affiche la part des npix points de l'image reellement calcules */
+static inline void mariani_afficher(long long calcules, long long npix) {
+  fprintf(stderr, "Mariani-Silver: %lld points calcules sur %lld (%.1f%%)\n",
+          calcules, npix, npix ? 100. * calcules / npix : 0.);
+}
+
+#endif /*!_mandel_mariani_h*/
@@ -13,17 +13,53 @@ Modifié par Julie Marcuzzi
 #include <omp.h>
 
 #include "rasterfile.h"
+#include "mandel_noyau.h"
+#include "mandel_options.h"
+#include "mandel_mariani.h"
+#include "mandel_iter.h"
+#include "mandel_reprise.h"
+#include "mandel_cache.h"
+#include "mandel_progressif.h"
+#include "mandel_lissage.h"
+#include "mandel_symetrie.h"
+#include "mandel_formule.h"
+#include "mandel_partition.h"
 
 
 
 char info[] = "\
 Usage:\n\
-      mandel dimx dimy xmin ymin xmax ymax prof\n\
+      mandel dimx dimy xmin ymin xmax ymax prof [options]\n\
 \n\
       dimx,dimy : dimensions de l'image a generer\n\
       xmin,ymin,xmax,ymax : domaine a calculer dans le plan complexe\n\
       prof : nombre maximale d'iteration\n\
 \n\
+Options\n\
+      -nocardio : pas de test de la cardioide et du disque de periode 2\n\
+      -periode : detection de periodicite des orbites (methode de Brent)\n\
+      -eps_periode eps : tolerance de la detection de periodicite\n\
+      -mariani : subdivision recursive de Mariani-Silver\n\
+      -taille_min n : cote en dessous duquel Mariani-Silver calcule tout\n\
+      -precision p : float, double, dd (double-double) ou auto (defaut)\n\
+      -iter fichier : sauve aussi les nombres d'iterations (voir recolorier)\n\
+      -reprise fichier : reprend le calcul sauve dans fichier jusqu'au\n\
+                         nouveau prof (le fichier est cree ou mis a jour)\n\
+      -cache fichier : reprend les points de la vue precedente qui tombent\n\
+                       sur la nouvelle grille, puis y sauve la nouvelle vue\n\
+      -progressif pas : passes de plus en plus fines (premiere : un pixel\n\
+                        sur pas), mandel.ras est sauve apres chacune\n\
+      -lissage n : anticrenelage, n x n echantillons (n <= 16) sur les\n\
+                   pixels de bord, image en 24 bits\n\
+      -seuil_lissage s : ecart d'iterations d'un pixel de bord (defaut 4)\n\
+      -degre d : formule z^d + c, 2 <= d <= 8 (defaut 2)\n\
+      -julia a,b : ensemble de Julia de z^d + k, k = a + i.b\n\
+      -formule \"expr\" : iteration z -> expr (z, c, i, + - * / ^n, conj),\n\
+                        compilee a l'execution (ex. \"z^3 + c*z + 0.2\")\n\
+      -nosymetrie : calcule aussi les lignes miroir par rapport a l'axe reel\n\
+      -equilibrage pas : partition statique des lignes selon leur cout,\n\
+                         estime sur une ligne et une colonne sur pas\n\
+\n\
 Quelques exemples d'execution\n\
       mandel 800 800 0.35 0.355 0.353 0.358 200\n\
       mandel 800 800 -0.736 -0.184 -0.735 -0.183 500\n\
@@ -174,39 +210,57 @@ void sauver_rasterfile( char *nom, int largeur, int hauteur, unsigned char *p) {
   fclose( fd);
 }
 
+/* Palette de l'image : couleur k -> rouge, vert, bleu (voir ci-dessus) */
+void palette_rgb( lissage_palette pal) {
+  int k;
+  for (k = 0; k < 256; k++) {
+    pal[k][0] = COMPOSANTE_ROUGE(255 - k);
+    pal[k][1] = COMPOSANTE_VERT(255 - k);
+    pal[k][2] = COMPOSANTE_BLEU(255 - k);
+  }
+}
+
 /**
- * Étant donnée les coordonnées d'un point \f$c=a+ib\f$ dans le plan
- * complexe, la fonction retourne la couleur correspondante estimant
- * à quelle distance de l'ensemble de mandelbrot le point est.
- * Soit la suite complexe défini par:
- * \f[
- * \left\{\begin{array}{l}
- * z_0 = 0 \\
- * z_{n+1} = z_n^2 - c
- * \end{array}\right.
- * \f]
- * le nombre d'itérations que la suite met pour diverger est le
- * nombre \f$ n \f$ pour lequel \f$ |z_n| > 2 \f$. 
- * Ce nombre est ramené à une valeur entre 0 et 255 correspond ainsi a 
- * une couleur dans la palette des couleurs.
+ *  Sauvegarde une image RGB (3 octets par pixel) au format rasterfile
+ *  24 bits : octets dans l'ordre bleu, vert, rouge, lignes completees a
+ *  un nombre pair d'octets
+ *    @param nom Nom de l'image
+ *    @param largeur largeur de l'image
+ *    @param hauteur hauteur de l'image
+ *    @param p pointeur vers tampon contenant l'image
  */
+void sauver_rasterfile_rgb( char *nom, int largeur, int hauteur, unsigned char *p) {
+  FILE *fd;
+  struct rasterfile file;
+  int i, j, ligne = (3*largeur + 1) & ~1;
+  unsigned char *tampon;
 
-unsigned char xy2color(double a, double b, int prof) {
-  double x, y, temp, x2, y2;
-  int i;
+  if ( (fd=fopen(nom, "w")) == NULL || (tampon = calloc( ligne, 1)) == NULL) {
+    printf("erreur dans la creation du fichier %s \n",nom);
+    exit(1);
+  }
 
-  x = y = 0.;
-  for( i=0; i<prof; i++) {
-    /* garder la valeur précédente de x qui va etre ecrase */
-    temp = x;
-    /* nouvelles valeurs de x et y */
-    x2 = x*x;
-    y2 = y*y;
-    x = x2 - y2 + a;
-    y = 2*temp*y + b;
-    if( x2 + y2 >= 4.0) break;
+  file.ras_magic  = swap(RAS_MAGIC);
+  file.ras_width  = swap(largeur);
+  file.ras_height = swap(hauteur);
+  file.ras_depth  = swap(24);
+  file.ras_length = swap(ligne*hauteur);
+  file.ras_type    = swap(RT_STANDARD);
+  file.ras_maptype = swap(RMT_NONE);
+  file.ras_maplength = swap(0);
+
+  fwrite(&file, sizeof(struct rasterfile), 1, fd);
+
+  for (i = 0; i < hauteur; i++) {
+    for (j = 0; j < largeur; j++) {
+      tampon[3*j]     = p[3*((long)i*largeur + j) + 2];
+      tampon[3*j + 1] = p[3*((long)i*largeur + j) + 1];
+      tampon[3*j + 2] = p[3*((long)i*largeur + j)];
+    }
+    fwrite( tampon, ligne, sizeof(unsigned char), fd);
   }
-  return (i==prof)?255:(int)((i%255)); 
+  free( tampon);
+  fclose( fd);
 }
 
 /* 
@@ -226,15 +280,66 @@ int main(int argc, char *argv[]) {
   /* Image resultat */
   unsigned char	*ima, *pima;
   /* Variables intermediaires */
-  int  i, j;
-  double x, y;
+  int  i;
+  double y;
   /* Chronometrage */
   double debut, fin;
+  /* Valeur d'option */
+  char *opt;
+  /* Subdivision de Mariani-Silver */
+  int mode_mariani = 0, taille_min = MARIANI_TAILLE_MIN;
+  mariani ms;
+  /* Grille et precision du calcul */
+  grille g;
+  int precision = PRECISION_AUTO;
+  /* Nombres d'iterations bruts (option -iter) */
+  char *fichier_iter;
+  int *iter = NULL, *piter = NULL;
+  /* Calcul reprenable (option -reprise) */
+  char *fichier_reprise;
+  reprise rep;
+  /* Vue precedente (option -cache) */
+  char *fichier_cache;
+  cache ca;
+  int cache_ok = 0;
+  /* Rendu progressif (option -progressif) : pas de la premiere passe */
+  int pas = 1, s;
+  double *abscisses;
+  /* Anticrenelage (option -lissage) : pixels de bord et image RGB */
+  int lissage = 0, seuil_lissage = LISSAGE_SEUIL, *bords = NULL;
+  long nbords = 0;
+  unsigned char *rgb = NULL, *rgb_bords = NULL;
+  lissage_palette pal;
+  /* Symetrie par rapport a l'axe reel : la ligne axe - i est recopiee */
+  int symetrie = 1, axe, a, b;
+  /* Partition selon le cout estime (option -equilibrage) */
+  int equilibrage = 0;
 
   /* debut du chronometrage */
   debut = my_gettimeofday();
 
 
+  /* Options facultatives */
+  if( option_presente(&argc, argv, "-nocardio")) noyau_cardioide = 0;
+  if( option_presente(&argc, argv, "-cardio")) noyau_cardioide = 1;
+  if( option_presente(&argc, argv, "-periode")) noyau_periode = 1;
+  if( (opt = option_valeur(&argc, argv, "-eps_periode"))) noyau_periode_eps = atof(opt);
+  if( option_presente(&argc, argv, "-mariani")) mode_mariani = 1;
+  if( (opt = option_valeur(&argc, argv, "-taille_min"))) taille_min = atoi(opt);
+  if( (opt = option_valeur(&argc, argv, "-precision"))) precision = precision_depuis_nom(opt);
+  if( formule_options(&argc, argv) != 0) {
+    fprintf( stderr, "%s\n", info);
+    return 1;
+  }
+  fichier_iter = option_valeur(&argc, argv, "-iter");
+  fichier_reprise = option_valeur(&argc, argv, "-reprise");
+  fichier_cache = option_valeur(&argc, argv, "-cache");
+  if( (opt = option_valeur(&argc, argv, "-progressif"))) pas = progressif_pas_initial(atoi(opt));
+  if( (opt = option_valeur(&argc, argv, "-lissage"))) lissage = atoi(opt);
+  if( (opt = option_valeur(&argc, argv, "-seuil_lissage"))) seuil_lissage = atoi(opt);
+  if( option_presente(&argc, argv, "-nosymetrie")) symetrie = 0;
+  if( (opt = option_valeur(&argc, argv, "-equilibrage"))) equilibrage = atoi(opt);
+
   if( argc == 1) fprintf( stderr, "%s\n", info);
   
   /* Valeurs par defaut de la fractale */
@@ -255,12 +360,49 @@ int main(int argc, char *argv[]) {
   /* Calcul des pas d'incrementation */
   xinc = (xmax - xmin) / (w-1);
   yinc = (ymax - ymin) / (h-1);
+  g = (grille){ xmin, xinc, ymin, yinc };
+  precision_choisir( precision, xmin, ymin, xmax, ymax, xinc, yinc, prof);
   
   /* affichage parametres pour verificatrion */
   fprintf( stderr, "Domaine: {[%lg,%lg]x[%lg,%lg]}\n", xmin, ymin, xmax, ymax);
   fprintf( stderr, "Increment : %lg %lg\n", xinc, yinc);
   fprintf( stderr, "Prof: %d\n",  prof);
   fprintf( stderr, "Dim image: %dx%d\n", w, h);
+  fprintf( stderr, "Noyau: %s\n", noyau_nom());
+  precision_afficher();
+  formule_afficher();
+  fprintf( stderr, "Cardioide: %s\n", noyau_cardioide ? "oui" : "non");
+  if( noyau_periode) fprintf( stderr, "Periodicite: eps %lg\n", noyau_periode_eps);
+  if( mode_mariani) fprintf( stderr, "Mariani-Silver: taille min %d\n", taille_min);
+  if( fichier_reprise && (mode_mariani || noyau_precision == PRECISION_DD)) {
+    fprintf( stderr, "Reprise: impossible avec -mariani ou en double-double\n");
+    fichier_reprise = NULL;
+  }
+  if( fichier_cache && (mode_mariani || fichier_reprise)) {
+    fprintf( stderr, "Cache: impossible avec -mariani ou -reprise\n");
+    fichier_cache = NULL;
+  }
+  if( pas > 1 && (mode_mariani || fichier_reprise || fichier_cache)) {
+    fprintf( stderr, "Progressif: impossible avec -mariani, -reprise ou -cache\n");
+    pas = 1;
+  }
+  if( pas > 1) fprintf( stderr, "Progressif: %d passes, pas initial %d\n",
+                        progressif_passes(pas), pas);
+  if( lissage > LISSAGE_MAX) lissage = LISSAGE_MAX;
+  if( lissage > 1 && noyau_precision == PRECISION_DD) {
+    fprintf( stderr, "Lissage: impossible en double-double\n");
+    lissage = 0;
+  }
+  if( lissage < 2) lissage = 0;
+  else fprintf( stderr, "Lissage: %dx%d echantillons, seuil %d\n", lissage, lissage, seuil_lissage);
+  axe = symetrie && formule_symetrique() && !fichier_reprise && pas == 1 ? symetrie_axe( ymin, yinc, h) : -1;
+  if( axe >= 0) fprintf( stderr, "Symetrie: %d lignes recopiees\n", symetrie_recopiees( axe, h));
+  if( equilibrage > 0 && (mode_mariani || fichier_reprise || pas > 1)) {
+    fprintf( stderr, "Equilibrage: impossible avec -mariani, -reprise ou -progressif\n");
+    equilibrage = 0;
+  }
+  if( equilibrage > 0) fprintf( stderr, "Equilibrage: pre-passe sur une ligne et une colonne sur %d\n", equilibrage);
+  else equilibrage = 0;
   
   /* Allocation memoire du tableau resultat */  
   pima = ima = (unsigned char *)malloc( w*h*sizeof(unsigned char));
@@ -269,33 +411,178 @@ int main(int argc, char *argv[]) {
     fprintf( stderr, "Erreur allocation mémoire du tableau \n");
     return 0;
   }
+  if( fichier_cache)
+    cache_ok = cache_charger( fichier_cache, &ca, &g, w, h, prof) == 0;
+  if( (fichier_iter || fichier_cache || pas > 1 || lissage) && !fichier_reprise) {
+    iter = (int *)malloc( (long)w*h*sizeof(int));
+    if( iter == NULL) {
+      fprintf( stderr, "Erreur allocation memoire des iterations \n");
+      return 0;
+    }
+  }
  
 
+	if( fichier_reprise && reprise_charger( fichier_reprise, &rep, w, h, prof,
+	                                        xmin, ymin, xmax, ymax) == 0) {
+		/* Seuls les points encore actifs au prof precedent sont poursuivis */
+		fprintf( stderr, "Reprise: %ld points poursuivis de %d a %d iterations\n",
+		         rep.n, rep.e.prof, prof);
+		reprise_poursuivre( &rep, prof, ima);
+	} else if( fichier_reprise) {
+		/* Calcul neuf qui garde les orbites des points actifs */
+		if( reprise_creer( &rep, w, h, prof, xmin, ymin, xmax, ymax) != 0) {
+			fprintf( stderr, "Erreur allocation memoire des iterations \n");
+			return 0;
+		}
+		#pragma omp parallel for private (y) schedule (dynamic)
+		for (i = 0; i < h; i++) {
+			y = ymin + i*yinc;
+			reprise_ligne( &rep, xmin, xinc, y, i, &ima[i*w]);
+		}
+	} else if( mode_mariani) {
+		/* Subdivision recursive, les sous-rectangles sont des taches */
+		ms = (mariani){ .ima = ima, .w = w, .g = g,
+		                .prof = prof, .taille_min = taille_min, .taille_tache = 64*64, .iter = iter };
+		#pragma omp parallel
+		#pragma omp single
+		for (a = 0; a < h; a = b) {
+			/* par suites de lignes calculees */
+			b = symetrie_suite( a, axe, h);
+			if( !symetrie_calculee( a, axe)) continue;
+			ms.ima = ima + (long)a*w;
+			ms.iter = iter ? iter + (long)a*w : NULL;
+			ms.i0 = a;
+			/* toutes les taches finies avant de changer ms */
+			#pragma omp taskgroup
+			mariani_silver( &ms, b - a);
+		}
+	} else if( pas > 1) {
+		/* Passes entrelacees, apercu sauve apres chacune sauf la derniere */
+		abscisses = progressif_abscisses( xmin, xinc, w);
+		for (s = pas; s >= 1; s /= 2) {
+			#pragma omp parallel for private (y) schedule (dynamic)
+			for (i = 0; i < h; i += s) {
+				y = ymin + i*yinc;
+				progressif_ligne( &g, abscisses, i, y, w, prof, s, pas, &iter[(long)i*w]);
+			}
+			progressif_apercu( iter, w, h, prof, s, ima);
+			if( s > 1) {
+				sauver_rasterfile( "mandel.ras", w, h, ima);
+				fprintf( stderr, "Progressif: passe de pas %d a %g sec\n", s,
+				         my_gettimeofday() - debut);
+			}
+		}
+		free( abscisses);
+	} else if( equilibrage) {
+		/* Partition statique : le thread t calcule les lignes
+		   lignes[bornes[t]..bornes[t+1]-1], de cout estime egal */
+		int T = omp_get_max_threads(), t, nc;
+		int *lignes = (int *)malloc( h*sizeof(int));
+		int *bornes = (int *)malloc( (T + 1)*sizeof(int));
+		double *cout, *prevu = (double *)malloc( T*sizeof(double));
+		double *mesure = (double *)malloc( T*sizeof(double)), unites, par_unite;
+		clock_t c0;
+
+		nc = symetrie_lignes( axe, h, lignes);
+		cout = (double *)calloc( nc + 1, sizeof(double));
+		/* temps d'une iteration : temps processeur de la pre-passe, tous threads */
+		c0 = clock();
+		unites = partition_echantillonner( &g, w, prof, lignes, nc, equilibrage, 0, 1, cout);
+		par_unite = unites > 0. ? (double)(clock() - c0) / CLOCKS_PER_SEC / unites : 0.;
+		partition_interpoler( cout, nc, equilibrage);
+		partition_decouper( cout, nc, T, bornes);
+
+		#pragma omp parallel for private (i, y, pima, piter) schedule (static, 1)
+		for (t = 0; t < T; t++) {
+			double t1 = partition_temps();
+			int q;
+			for (q = bornes[t]; q < bornes[t+1]; q++) {
+				i = lignes[q];
+				y = ymin + i*yinc;
+				pima = &ima[(long)i*w];
+				if( iter) {
+					piter = &iter[(long)i*w];
+					if( cache_ok) cache_ligne( &ca, &g, i, y, w, prof, piter);
+					else xy2iter_grille( &g, i, y, 0, w, prof, piter);
+					iter2color( piter, w, prof, pima);
+				} else {
+					xy2color_grille( &g, i, y, 0, w, prof, pima);
+				}
+			}
+			mesure[t] = partition_temps() - t1;
+			prevu[t] = par_unite * partition_cout( cout, bornes[t], bornes[t+1]);
+		}
+		desequilibre_afficher( "Thread", T, bornes, prevu, mesure);
+		free( lignes);
+		free( bornes);
+		free( cout);
+		free( prevu);
+		free( mesure);
+	} else {
 	#pragma omp parallel 
 	{
-		#pragma omp for private (j,pima,x,y) schedule (dynamic) 
-		/* Traitement de la grille point par point */
+		#pragma omp for private (pima,piter,y) schedule (dynamic) 
+		/* Traitement de la grille ligne par ligne (noyau vectoriel) */
 		for (i = 0; i < h; i++) {	
+			if( !symetrie_calculee( i, axe)) continue;
 			y = ymin + i*yinc;
 			pima = &ima[i*w];
-			x = xmin;
-			for (j = 0; j < w; j++) {
-				// printf("%d\n", xy2color( x, y, prof));
-				// printf("(x,y)=(%g;%g)\t (i,j)=(%d,%d)\n", x, y, i, j);
-				*pima++ = xy2color( x, y, prof); 
-				x += xinc;
+			if( iter) {
+				piter = &iter[(long)i*w];
+				if( cache_ok) cache_ligne( &ca, &g, i, y, w, prof, piter);
+				else xy2iter_grille( &g, i, y, 0, w, prof, piter);
+				iter2color( piter, w, prof, pima);
+			} else {
+				xy2color_grille( &g, i, y, 0, w, prof, pima);
 			}
-			y += yinc; 
 		}
 	}
+	}
+  symetrie_recopier( ima, w, h, axe);
+  if( iter) symetrie_recopier( iter, w*sizeof(int), h, axe);
+
+  /* Anticrenelage : reechantillonnage des pixels de bord */
+  if( lissage) {
+    palette_rgb( pal);
+    bords = (int *)malloc( (long)w*h*sizeof(int));
+    rgb = (unsigned char *)malloc( 3L*w*h);
+    if( bords == NULL || rgb == NULL) {
+      fprintf( stderr, "Erreur allocation memoire du lissage \n");
+      return 0;
+    }
+    nbords = lissage_bords( fichier_reprise ? rep.iter : iter, w, h, seuil_lissage, bords);
+    if( nbords < 0
+        || (rgb_bords = (unsigned char *)malloc( 3*nbords + 1)) == NULL) {
+      fprintf( stderr, "Erreur allocation memoire du lissage \n");
+      return 0;
+    }
+    lissage_pixels( &g, bords, nbords, w, lissage, prof, pal, rgb_bords);
+    lissage_rgb( ima, (long)w*h, pal, rgb);
+    lissage_placer( bords, nbords, rgb_bords, rgb);
+  }
+
   /* fin du chronometrage */
   fin = my_gettimeofday();
   fprintf( stderr, "Temps total de calcul : %g sec\n", 
 	   fin - debut);
   fprintf( stdout, "%g\n", fin - debut);
+  if( noyau_periode) periode_afficher( &noyau_stats, (long long)w*h);
+  if( mode_mariani) mariani_afficher( ms.calcules, (long long)w*h);
+  if( cache_ok) cache_afficher( &ca, (long long)w*h);
+  if( lissage) lissage_afficher( nbords, (long)w*h, lissage);
 
   /* Sauvegarde de la grille dans le fichier resultat "mandel.ras" */
-  sauver_rasterfile( "mandel.ras", w, h, ima);
+  if( lissage) sauver_rasterfile_rgb( "mandel.ras", w, h, rgb);
+  else sauver_rasterfile( "mandel.ras", w, h, ima);
+  if( fichier_reprise) {
+    reprise_sauver( fichier_reprise, &rep);
+    if( fichier_iter) iter_sauver( fichier_iter, &rep.e, rep.iter);
+  }
+  if( iter) {
+    iter_entete e = iter_entete_creer( w, h, prof, xmin, ymin, xmax, ymax);
+    if( fichier_iter) iter_sauver( fichier_iter, &e, iter);
+    if( fichier_cache) cache_sauver( fichier_cache, &e, iter);
+  }
   
   return 0;
 }
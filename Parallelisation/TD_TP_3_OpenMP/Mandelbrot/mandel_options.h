@@ -0,0 +1,52 @@
+/*
+ * Options facultatives de la ligne de commande, de la forme "-nom" ou
+ * "-nom valeur". Elles sont retirees de argv avant la lecture des
+ * parametres positionnels (dimx dimy xmin ymin xmax ymax prof ...),
+ * qui gardent donc leur place habituelle.
+ */
+
+#ifndef _mandel_options_h
+#define _mandel_options_h
+
+#include <string.h>
+
+/* Retire les n arguments a partir de l'indice k */
+static inline void option_retirer(int *argc, char *argv[], int k, int n) {
+  int i;
+  for (i = k; i + n <= *argc; i++) argv[i] = argv[i + n];
+  *argc -= n;
+}
+
+/**
+ * Cherche l'option "nom" sans valeur.
+ * @return 1 si elle etait presente (elle est alors retiree), 0 sinon
+ */
+static inline int option_presente(int *argc, char *argv[], const char *nom) {
+  int k;
+  for (k = 1; k < *argc; k++) {
+    if (strcmp(argv[k], nom) == 0) {
+      option_retirer(argc, argv, k, 1);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Cherche l'option "nom valeur".
+ * @return la valeur (l'option est alors retiree), NULL si absente
+ */
+static inline char *option_valeur(int *argc, char *argv[], const char *nom) {
+  int k;
+  char *val;
+  for (k = 1; k + 1 < *argc; k++) {
+    if (strcmp(argv[k], nom) == 0) {
+      val = argv[k + 1];
+      option_retirer(argc, argv, k, 2);
+      return val;
+    }
+  }
+  return NULL;
+}
+
+#endif /*!_mandel_options_h*/
@@ -0,0 +1,130 @@
+/*
+ * Partition statique equilibree (option -equilibrage pas) : une
+ * pre-passe basse resolution (une ligne sur pas, un groupe de
+ * PARTITION_GROUPE pixels voisins sur pas) estime le cout de chaque
+ * ligne, en iterations, et les lignes sont decoupees en P suites
+ * consecutives de cout estime egal (somme prefixe), une par processus
+ * ou par thread.
+ *
+ * Les voies d'un registre vectoriel iterent jusqu'a ce que la plus lente
+ * ait fini : un groupe de pixels voisins coute, par pixel, le plus grand
+ * nombre d'iterations du groupe, plus PARTITION_COUT_POINT (mise en place
+ * du calcul). Les points reconnus par le test de la cardioide ne coutent
+ * que ce dernier. Les lignes non echantillonnees sont interpolees. La
+ * periodicite (-periode) et Mariani-Silver ne sont pas modelises :
+ * l'estimation surestime alors les lignes de l'interieur.
+ *
+ * Le temps d'une iteration est mesure sur la pre-passe : le temps prevu
+ * de chaque partie est affiche a cote du temps mesure
+ * (desequilibre_afficher). Les deux sont des temps processeur, egaux au
+ * temps ecoule quand chaque processus ou thread a son coeur, et qui
+ * restent comparables sinon.
+ */
+
+#ifndef _mandel_partition_h
+#define _mandel_partition_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "mandel_noyau.h"
+#include "mandel_desequilibre.h"
+
+/* Cout fixe d'un point, en iterations */
+#ifndef PARTITION_COUT_POINT
+#define PARTITION_COUT_POINT 4
+#endif
+
+/* Pixels voisins echantillonnes ensemble (voies d'un registre AVX-512) */
+#define PARTITION_GROUPE 8
+
+/* Temps processeur du thread appelant, en secondes */
+static inline double partition_temps(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+  return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+/* La ligne d'indice k (parmi n) est-elle echantillonnee ? */
+static inline int partition_echantillon(int k, int n, int pas) {
+  return k % pas == 0 || k == n - 1;
+}
+
+/**
+ * Pre-passe : cout[k] des lignes lignes[k] echantillonnees, ramene a la
+ * largeur w. Seul l'echantillon numero e avec e % nproc == rang est
+ * calcule (les autres couts restent a 0, a sommer entre processus).
+ * @return cout des points calcules, en iterations (pour l'etalonnage)
+ */
+static inline double partition_echantillonner(const grille *g, int w, int prof,
+                                              const int *lignes, int n, int pas,
+                                              int rang, int nproc, double *cout) {
+  int ne = (n - 1) / pas + 1 + ((n - 1) % pas != 0), e;
+  int d = PARTITION_GROUPE*pas, ng = (w - 1) / d + 1;
+  double total = 0.;
+
+  if (n <= 0) return 0.;
+#pragma omp parallel for schedule(dynamic) reduction(+:total)
+  for (e = rang; e < ne; e += nproc) {
+    double pa[PARTITION_GROUPE], pb[PARTITION_GROUPE], c = 0.;
+    int it[PARTITION_GROUPE], j, q, r, m = 0, imax;
+    int k = e*pas < n - 1 ? e*pas : n - 1;
+    for (j = 0; j < ng; j++) {
+      for (r = 0; r < PARTITION_GROUPE && j*d + r < w; r++) {
+        pa[r] = g->xmin + (long)(j*d + r)*g->xinc;
+        pb[r] = g->ymin + lignes[k]*g->yinc;
+      }
+      xy2iter_points(pa, pb, r, prof, it);
+      for (imax = 0, q = 0; q < r; q++)
+        if (!(noyau_formule == NULL && interieur(pa[q], pb[q])) && it[q] > imax)
+          imax = it[q];
+      c += r * (double)(PARTITION_COUT_POINT + imax);
+      m += r;
+    }
+    cout[k] = c * w / m;
+    total += c;
+  }
+  return total;
+}
+
+/* Cout des lignes non echantillonnees, interpole entre leurs voisines */
+static inline void partition_interpoler(double *cout, int n, int pas) {
+  int k, k0, k1;
+  for (k = 0; k < n; k++) {
+    if (partition_echantillon(k, n, pas)) continue;
+    k0 = k - k % pas;
+    k1 = k0 + pas < n - 1 ? k0 + pas : n - 1;
+    cout[k] = cout[k0] + (cout[k1] - cout[k0]) * (k - k0) / (k1 - k0);
+  }
+}
+
+/**
+ * Decoupe les n lignes en P suites consecutives : la partie r est
+ * [bornes[r], bornes[r+1]), chaque borne etant placee la ou le cout
+ * cumule est le plus proche de r/P du total.
+ */
+static inline void partition_decouper(const double *cout, int n, int P, int *bornes) {
+  double total = 0., s = 0., cible;
+  int k = 0, r;
+
+  for (k = 0; k < n; k++) total += cout[k];
+  bornes[0] = 0;
+  bornes[P] = n;
+  for (k = 0, r = 1; r < P; r++) {
+    cible = total * r / P;
+    while (k < n && s + cout[k] <= cible) s += cout[k++];
+    /* la ligne k est a cheval : a la partie dont elle rapproche le plus */
+    if (k < n && s + cout[k] - cible < cible - s) s += cout[k++];
+    bornes[r] = k;
+  }
+}
+
+/* Cout estime des lignes [a, b) */
+static inline double partition_cout(const double *cout, int a, int b) {
+  double s = 0.;
+  for (; a < b; a++) s += cout[a];
+  return s;
+}
+
+#endif /*!_mandel_partition_h*/